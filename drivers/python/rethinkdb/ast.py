@@ -413,6 +413,12 @@ class RqlQuery(object):
     def avg(self, *args):
         return Avg(self, *[func_wrap(arg) for arg in args])
 
+    def count_distinct(self, *args):
+        return CountDistinct(self, *[func_wrap(arg) for arg in args])
+
+    def percentile(self, *args):
+        return Percentile(self, *[func_wrap(arg) for arg in args])
+
     def min(self, *args, **kwargs):
         return Min(self, *[func_wrap(arg) for arg in args], **kwargs)
 
@@ -1262,6 +1268,16 @@ class Avg(RqlMethodQuery):
     st = 'avg'
 
 
+class CountDistinct(RqlMethodQuery):
+    tt = pTerm.COUNT_DISTINCT
+    st = 'count_distinct'
+
+
+class Percentile(RqlMethodQuery):
+    tt = pTerm.PERCENTILE
+    st = 'percentile'
+
+
 class Min(RqlMethodQuery):
     tt = pTerm.MIN
     st = 'min'
@@ -7,6 +7,7 @@ __all__ = [
     'db', 'db_create', 'db_drop', 'db_list',
     'table', 'table_create', 'table_drop', 'table_list', 'grant',
     'group', 'reduce', 'count', 'sum', 'avg', 'min', 'max', 'distinct',
+    'count_distinct', 'percentile',
     'contains', 'eq', 'ne', 'le', 'ge', 'lt', 'gt', 'and_', 'or_', 'not_',
     'add', 'sub', 'mul', 'div', 'mod', 'floor', 'ceil', 'round',
     'time', 'iso8601', 'epoch_time', 'now', 'make_timezone',
@@ -131,6 +132,14 @@ def avg(*args):
     return ast.Avg(*[ast.func_wrap(arg) for arg in args])
 
 
+def count_distinct(*args):
+    return ast.CountDistinct(*[ast.func_wrap(arg) for arg in args])
+
+
+def percentile(*args):
+    return ast.Percentile(*[ast.func_wrap(arg) for arg in args])
+
+
 def min(*args):
     return ast.Min(*[ast.func_wrap(arg) for arg in args])
 
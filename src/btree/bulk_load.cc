@@ -0,0 +1,344 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "btree/bulk_load.hpp"
+
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/operations.hpp"
+#include "btree/types.hpp"
+
+btree_bulk_loader_t::level_t::level_t(block_size_t block_size)
+    : node(block_size.value()), has_last_child(false), last_child(NULL_BLOCK_ID) {
+    internal_node::init(block_size, node.get());
+}
+
+btree_bulk_loader_t::btree_bulk_loader_t(value_sizer_t *sizer, superblock_t *superblock)
+    : sizer_(sizer),
+      superblock_(superblock),
+      original_root_(superblock->get_root_block_id()),
+      recency_(repli_timestamp_t::distant_past),
+      can_append_(true),
+      has_last_key_(false),
+      num_appended_(0),
+      finished_(false) {
+    if (original_root_ == NULL_BLOCK_ID) {
+        return;
+    }
+
+    /* Walk down the spine, remembering every internal node on it without its rightmost
+    child. The rightmost child gets added back when we close the node below it. */
+    std::vector<scoped_ptr_t<level_t> > top_down_levels;
+    buf_lock_t buf(superblock_->expose_buf(), original_root_, access_t::write);
+    for (;;) {
+        recency_ = superceding_recency(recency_, buf.get_recency());
+        bool is_leaf;
+        {
+            buf_read_t read(&buf);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            is_leaf = node::is_leaf(node);
+            if (!is_leaf && internal_node::is_full(
+                    reinterpret_cast<const internal_node_t *>(node))) {
+                /* The regular insertion path would split this node before descending
+                into it. We leave that to the regular path, so that every node we
+                reopen has room for the child that we take out of it. */
+                can_append_ = false;
+            }
+        }
+        if (!can_append_) {
+            /* The caller still wants to know where the B-tree ends, so that it doesn't
+            try again for keys that can't be appended anyway. */
+            top_down_levels.clear();
+            find_last_key(&buf);
+            return;
+        }
+        if (is_leaf) {
+            break;
+        }
+        scoped_ptr_t<level_t> level = make_scoped<level_t>(sizer_->block_size());
+        block_id_t rightmost_child;
+        reopen_internal_node(level.get(), &buf, &rightmost_child);
+        buf = buf_lock_t(buf_parent_t(&level->buf), rightmost_child, access_t::write);
+        top_down_levels.push_back(std::move(level));
+    }
+
+    for (auto it = top_down_levels.rbegin(); it != top_down_levels.rend(); ++it) {
+        levels_.push_back(std::move(*it));
+    }
+    leaf_buf_ = std::move(buf);
+    reopen_leaf();
+}
+
+btree_bulk_loader_t::~btree_bulk_loader_t() {
+    guarantee(finished_ || num_appended_ == 0,
+              "btree_bulk_loader_t destroyed without calling finish()");
+}
+
+bool btree_bulk_loader_t::key_is_appendable(const btree_key_t *key) const {
+    return can_append_
+        && (!has_last_key_ || btree_key_cmp(key, last_key_.btree_key()) > 0);
+}
+
+bool btree_bulk_loader_t::get_last_key(store_key_t *key_out) const {
+    if (!has_last_key_) {
+        return false;
+    }
+    *key_out = last_key_;
+    return true;
+}
+
+buf_parent_t btree_bulk_loader_t::leaf_parent() {
+    guarantee(!finished_);
+    if (leaf_buf_.empty()) {
+        /* Like the root created by `get_root()` and the nodes created when splitting
+        the root, the new nodes start out as children of the superblock. */
+        leaf_buf_ = buf_lock_t(superblock_->expose_buf(), alt_create_t::create);
+        buf_write_t write(&leaf_buf_);
+        leaf::init(sizer_, static_cast<leaf_node_t *>(write.get_data_write()));
+    }
+    return buf_parent_t(&leaf_buf_);
+}
+
+void btree_bulk_loader_t::append(const btree_key_t *key,
+                                 const void *value,
+                                 repli_timestamp_t timestamp,
+                                 const value_deleter_t *detacher) {
+    guarantee(key_is_appendable(key), "keys must be appended in ascending order");
+
+    bool leaf_is_full;
+    {
+        buf_read_t read(&leaf_buf_);
+        leaf_is_full = leaf::is_full(sizer_,
+            static_cast<const leaf_node_t *>(read.get_data_read()), key, value);
+    }
+    if (leaf_is_full) {
+        /* The value was created with the current leaf as its parent; it now becomes
+        a child of the next leaf instead. */
+        detacher->delete_value(buf_parent_t(&leaf_buf_), value);
+        close_leaf();
+        leaf_parent();
+    }
+
+    recency_ = superceding_recency(recency_, timestamp);
+
+    /* Same as in `apply_keyvalue_change()`: the leaf's recency must be greater than or
+    equal to that of any entry in it. */
+    const repli_timestamp_t previous_leaf_recency = leaf_buf_.get_recency();
+    leaf_buf_.set_recency(superceding_recency(timestamp, previous_leaf_recency));
+    {
+        buf_write_t write(&leaf_buf_);
+        auto leaf_node = static_cast<leaf_node_t *>(write.get_data_write());
+        rassert(!leaf::is_full(sizer_, leaf_node, key, value));
+        leaf::insert(sizer_,
+                     leaf_node,
+                     key,
+                     value,
+                     timestamp,
+                     previous_leaf_recency,
+                     key_modification_proof_t::real_proof());
+    }
+
+    last_key_.assign(key);
+    has_last_key_ = true;
+    ++num_appended_;
+}
+
+void btree_bulk_loader_t::finish() {
+    guarantee(!finished_);
+    finished_ = true;
+
+    if (num_appended_ == 0) {
+        /* We didn't change anything, so there's nothing to write back. */
+        levels_.clear();
+        leaf_buf_.reset_buf_lock();
+        return;
+    }
+
+    /* Close the open node on every level, bottom-up. Closing a node adds it to the
+    level above, so we stop when the topmost level has a single child, which becomes the
+    new root. */
+    close_leaf();
+    block_id_t new_root = NULL_BLOCK_ID;
+    for (size_t i = 0; i < levels_.size(); ++i) {
+        level_t *level = levels_[i].get();
+        guarantee(level->has_last_child);
+        if (i + 1 == levels_.size() && level->node->npairs == 0) {
+            /* A reopened node always has at least two children by now. */
+            guarantee(level->buf.empty());
+            new_root = level->last_child;
+            break;
+        }
+        close_internal_node(i);
+    }
+    guarantee(new_root != NULL_BLOCK_ID);
+    levels_.clear();
+
+    if (new_root != original_root_) {
+        /* Just like when splitting the root in `check_and_handle_split()`, the old root
+        is now somewhere below the new root. */
+        if (original_root_ != NULL_BLOCK_ID) {
+            superblock_->expose_buf().detach_child(original_root_);
+        }
+        insert_root(new_root, superblock_);
+    }
+
+    const block_id_t stat_block_id = superblock_->get_stat_block_id();
+    if (stat_block_id != NULL_BLOCK_ID) {
+        buf_lock_t stat_block(buf_parent_t(superblock_->expose_buf().txn()),
+                              stat_block_id, access_t::write);
+        buf_write_t stat_block_write(&stat_block);
+        auto stat_block_buf = static_cast<btree_statblock_t *>(
+                stat_block_write.get_data_write(BTREE_STATBLOCK_SIZE));
+        stat_block_buf->population += num_appended_;
+    }
+}
+
+void btree_bulk_loader_t::reopen_internal_node(
+        level_t *level, buf_lock_t *buf, block_id_t *rightmost_child_out) {
+    {
+        buf_read_t read(buf);
+        const internal_node_t *node =
+            static_cast<const internal_node_t *>(read.get_data_read());
+        guarantee(node->npairs >= 2);
+        for (int i = 0; i < node->npairs - 1; ++i) {
+            const btree_internal_pair *pair = internal_node::get_pair_by_index(node, i);
+            DEBUG_VAR bool success =
+                try_add_child(level, pair->lnode, store_key_t(&pair->key));
+            rassert(success);
+        }
+        *rightmost_child_out =
+            internal_node::get_pair_by_index(node, node->npairs - 1)->lnode;
+    }
+
+    /* Every key below the rightmost child is greater than the key that separates it
+    from its left sibling. */
+    last_key_ = level->last_child_right_key;
+    has_last_key_ = true;
+
+    level->buf = std::move(*buf);
+}
+
+void btree_bulk_loader_t::reopen_leaf() {
+    read_last_key(&leaf_buf_);
+}
+
+void btree_bulk_loader_t::find_last_key(buf_lock_t *buf) {
+    for (;;) {
+        block_id_t rightmost_child;
+        {
+            buf_read_t read(buf);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (node::is_leaf(node)) {
+                break;
+            }
+            const internal_node_t *internal =
+                reinterpret_cast<const internal_node_t *>(node);
+            rightmost_child =
+                internal_node::get_pair_by_index(internal, internal->npairs - 1)->lnode;
+        }
+        buf_lock_t tmp(buf, rightmost_child, access_t::read);
+        buf->reset_buf_lock();
+        *buf = std::move(tmp);
+    }
+    read_last_key(buf);
+}
+
+void btree_bulk_loader_t::read_last_key(buf_lock_t *leaf_buf) {
+    /* Appended keys must be greater than the keys of the deletion entries too, so we
+    have to look at all of the entries instead of just the last live one. */
+    buf_read_t read(leaf_buf);
+    leaf::visit_entries(
+        sizer_,
+        static_cast<const leaf_node_t *>(read.get_data_read()),
+        leaf_buf->get_recency(),
+        [&](const btree_key_t *key, repli_timestamp_t, const void *) {
+            if (!has_last_key_ || btree_key_cmp(key, last_key_.btree_key()) > 0) {
+                last_key_.assign(key);
+                has_last_key_ = true;
+            }
+            return continue_bool_t::CONTINUE;
+        });
+}
+
+bool btree_bulk_loader_t::try_add_child(
+        level_t *level, block_id_t child, const store_key_t &right_key) {
+    if (level->has_last_child) {
+        if (!internal_node::insert(level->node.get(),
+                                   level->last_child_right_key.btree_key(),
+                                   level->last_child,
+                                   child)) {
+            return false;
+        }
+    }
+    level->has_last_child = true;
+    level->last_child = child;
+    level->last_child_right_key = right_key;
+    return true;
+}
+
+void btree_bulk_loader_t::add_child(
+        size_t level_index, block_id_t child, const store_key_t &right_key) {
+    if (level_index == levels_.size()) {
+        levels_.push_back(make_scoped<level_t>(sizer_->block_size()));
+    }
+    level_t *level = levels_[level_index].get();
+    if (try_add_child(level, child, right_key)) {
+        return;
+    }
+
+    /* The open node is full. We take its last child out of it before closing it, so
+    that the next node starts out with two children; otherwise we might end up with an
+    internal node that has only one child. */
+    internal_node_t *node = level->node.get();
+    guarantee(node->npairs >= 3);
+    const block_id_t moved_child = level->last_child;
+    const store_key_t moved_child_right_key = level->last_child_right_key;
+    level->last_child_right_key.assign(
+        &internal_node::get_pair_by_index(node, node->npairs - 2)->key);
+    level->last_child = internal_node::get_pair_by_index(node, node->npairs - 2)->lnode;
+    internal_node::remove(sizer_->block_size(), node, moved_child_right_key.btree_key());
+    close_internal_node(level_index);
+
+    /* `close_internal_node()` may have added a level, invalidating `level`. */
+    level = levels_[level_index].get();
+    DEBUG_VAR bool success = try_add_child(level, moved_child, moved_child_right_key);
+    rassert(success);
+    success = try_add_child(level, child, right_key);
+    guarantee(success);
+}
+
+void btree_bulk_loader_t::close_internal_node(size_t level_index) {
+    level_t *level = levels_[level_index].get();
+    guarantee(level->node->npairs >= 2);
+
+    buf_lock_t buf = level->buf.empty()
+        ? buf_lock_t(superblock_->expose_buf(), alt_create_t::create)
+        : std::move(level->buf);
+    /* This is more conservative than it needs to be, but `recency_` is at least the
+    recency of every node below this one. */
+    buf.set_recency(superceding_recency(recency_, buf.get_recency()));
+    internal_node::validate(sizer_->block_size(), level->node.get());
+    {
+        buf_write_t write(&buf);
+        memcpy(write.get_data_write(), level->node.get(),
+               sizer_->block_size().value());
+    }
+
+    const block_id_t node_id = buf.block_id();
+    const store_key_t right_key = level->last_child_right_key;
+    buf.reset_buf_lock();
+
+    internal_node::init(sizer_->block_size(), level->node.get());
+    level->has_last_child = false;
+    level->last_child = NULL_BLOCK_ID;
+
+    add_child(level_index + 1, node_id, right_key);
+}
+
+void btree_bulk_loader_t::close_leaf() {
+    if (leaf_buf_.empty()) {
+        return;
+    }
+    guarantee(has_last_key_);
+    const block_id_t leaf_id = leaf_buf_.block_id();
+    leaf_buf_.reset_buf_lock();
+    add_child(0, leaf_id, last_key_);
+}
@@ -0,0 +1,127 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef BTREE_BULK_LOAD_HPP_
+#define BTREE_BULK_LOAD_HPP_
+
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "btree/node.hpp"
+#include "buffer_cache/alt.hpp"
+#include "containers/scoped.hpp"
+#include "repli_timestamp.hpp"
+
+class superblock_t;
+class value_deleter_t;
+
+/* `btree_bulk_loader_t` appends a run of strictly ascending keys to the right-hand end
+of a B-tree. Instead of descending from the root once per key and splitting nodes in
+half as they fill up, it fills each leaf completely before starting the next one and
+builds the internal nodes above the leaves bottom-up as leaves are closed. This is much
+cheaper than a series of regular inserts, and it leaves the nodes full instead of half
+full.
+
+The constructor acquires the rightmost path of the B-tree (the "spine") for writing, and
+the loader keeps appending to the nodes on it, so the B-tree doesn't need to be empty.
+The only restriction is that every appended key must be greater than any key that is
+already in the B-tree; use `key_is_appendable()` to check this. Callers that can't
+guarantee it should fall back to the regular `find_keyvalue_location_for_write()` path.
+
+Usage:
+  - Construct the loader with a superblock that is held for writing.
+  - For each key, create the value's blob (if any) with `leaf_parent()` as its parent,
+    then call `append()`.
+  - Call `finish()`, which writes out the partially filled nodes and updates the root
+    block and the stat block. The superblock can be released after that. */
+class btree_bulk_loader_t {
+public:
+    btree_bulk_loader_t(value_sizer_t *sizer, superblock_t *superblock);
+    ~btree_bulk_loader_t();
+
+    /* Returns `true` if `key` is greater than every key in the B-tree, including the
+    keys of deletion entries, and than every key appended so far. */
+    bool key_is_appendable(const btree_key_t *key) const;
+
+    /* The parent that the blob of the next value to be appended must be created under.
+    */
+    buf_parent_t leaf_parent();
+
+    /* Appends `key` with `value`, which must have been created under `leaf_parent()`. If
+    the current leaf doesn't have room for it, `detacher` is called to detach `value`
+    from the current leaf before it is moved to a new one. */
+    void append(const btree_key_t *key,
+                const void *value,
+                repli_timestamp_t timestamp,
+                const value_deleter_t *detacher);
+
+    /* Must be called once after the last `append()`. */
+    void finish();
+
+    int64_t num_appended() const { return num_appended_; }
+
+    /* Sets `*key_out` to the largest key in the B-tree, including the keys appended so
+    far, and returns `true`. This works even if the B-tree couldn't be appended to.
+    Returns `false` if the B-tree is empty. */
+    bool get_last_key(store_key_t *key_out) const;
+
+private:
+    /* One level of internal nodes, from the one right above the leaves upwards. Every
+    level has exactly one "open" node that new children are added to. Its contents are
+    kept in `node` until it's closed; `buf` holds the block that it will be written to
+    if the node was reopened from the spine. */
+    struct level_t {
+        explicit level_t(block_size_t block_size);
+
+        scoped_malloc_t<internal_node_t> node;
+        buf_lock_t buf;
+        /* `last_child` is the rightmost child of the open node and
+        `last_child_right_key` is the largest key below it, which becomes a separator
+        once the next child is added. While the open node has only one child, `node`
+        has no pairs at all. */
+        bool has_last_child;
+        block_id_t last_child;
+        store_key_t last_child_right_key;
+
+        DISABLE_COPYING(level_t);
+    };
+
+    void reopen_internal_node(level_t *level, buf_lock_t *buf,
+                              block_id_t *rightmost_child_out);
+    void reopen_leaf();
+    /* Walks down the rightmost path from `buf` without reopening anything, and sets
+    `last_key_` from the leaf at the bottom. Used when we can't append. */
+    void find_last_key(buf_lock_t *buf);
+    void read_last_key(buf_lock_t *leaf_buf);
+
+    bool try_add_child(level_t *level, block_id_t child, const store_key_t &right_key);
+    void add_child(size_t level_index, block_id_t child, const store_key_t &right_key);
+    void close_internal_node(size_t level_index);
+    void close_leaf();
+
+    value_sizer_t *sizer_;
+    superblock_t *superblock_;
+
+    block_id_t original_root_;
+
+    /* All nodes that we write get this recency. It's at least the recency of the old
+    root, and at least the timestamp of every appended value. */
+    repli_timestamp_t recency_;
+
+    /* `false` if the spine was too full to be reopened. */
+    bool can_append_;
+
+    std::vector<scoped_ptr_t<level_t> > levels_;
+
+    /* The open leaf. It's empty until we need it. */
+    buf_lock_t leaf_buf_;
+
+    /* The largest key in the B-tree so far, if there is one. */
+    bool has_last_key_;
+    store_key_t last_key_;
+
+    int64_t num_appended_;
+    bool finished_;
+
+    DISABLE_COPYING(btree_bulk_loader_t);
+};
+
+#endif  // BTREE_BULK_LOAD_HPP_
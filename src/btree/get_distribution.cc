@@ -15,7 +15,11 @@ public:
     { }
 
     void read_stat_block(buf_lock_t *stat_block) {
-        guarantee (stat_block != nullptr);
+        if (stat_block == nullptr) {
+            /* Secondary index B-trees don't have a stat block, so we don't know
+            their population. The split keys are still meaningful. */
+            return;
+        }
         buf_read_t read(stat_block);
         uint32_t sb_size;
         const btree_statblock_t *sb_data =
@@ -90,11 +94,12 @@ public:
 
 void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
                                 int64_t *key_count_out,
-                                std::vector<store_key_t> *keys_out) {
+                                std::vector<store_key_t> *keys_out,
+                                release_superblock_t release_superblock) {
     get_distribution_traversal_helper_t helper(depth_limit, keys_out);
     rassert(keys_out->empty(), "Why is this output parameter not an empty vector\n");
 
     cond_t non_interruptor;
-    btree_parallel_traversal(superblock, &helper, &non_interruptor);
+    btree_parallel_traversal(superblock, &helper, &non_interruptor, release_superblock);
     *key_count_out = helper.key_count;
 }
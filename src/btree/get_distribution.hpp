@@ -5,12 +5,15 @@
 #include <vector>
 
 #include "btree/keys.hpp"
+#include "btree/types.hpp"
 #include "buffer_cache/types.hpp"
 
 class superblock_t;
 
-void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
-                                int64_t *key_count_out,
-                                std::vector<store_key_t> *keys_out);
+void get_btree_key_distribution(
+        superblock_t *superblock, int depth_limit,
+        int64_t *key_count_out,
+        std::vector<store_key_t> *keys_out,
+        release_superblock_t release_superblock = release_superblock_t::RELEASE);
 
 #endif /* BTREE_GET_DISTRIBUTION_HPP_ */
@@ -549,6 +549,15 @@ bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *k
     return size > free_space(sizer);
 }
 
+int free_space_for_entries(value_sizer_t *sizer, const leaf_node_t *node) {
+    return free_space(sizer) - mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS);
+}
+
+int max_entry_cost(value_sizer_t *sizer, const btree_key_t *key) {
+    return sizeof(uint16_t) + sizeof(repli_timestamp_t) + key->full_size()
+        + sizer->max_possible_size();
+}
+
 bool is_underfull(value_sizer_t *sizer, const leaf_node_t *node) {
 
     // An underfull node is one whose mandatory fields' cost
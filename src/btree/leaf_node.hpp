@@ -129,6 +129,13 @@ bool is_empty(const leaf_node_t *node);
 
 bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value);
 
+// The room for new entries in `node`, counted the way `is_full()` counts it.  The node
+// is full for an entry that costs more than this.
+int free_space_for_entries(value_sizer_t *sizer, const leaf_node_t *node);
+
+// The most that `is_full()` can count for an entry with `key`, whatever its value.
+int max_entry_cost(value_sizer_t *sizer, const btree_key_t *key);
+
 bool is_underfull(value_sizer_t *sizer, const leaf_node_t *node);
 
 void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *sibling,
@@ -23,6 +23,25 @@ block_id_t create_stat_block(buf_parent_t parent) {
     return stats_block.block_id();
 }
 
+bool get_btree_population(superblock_t *superblock, int64_t *population_out) {
+    const block_id_t stat_block_id = superblock->get_stat_block_id();
+    if (stat_block_id == NULL_BLOCK_ID) {
+        return false;
+    }
+    // Like `apply_keyvalue_change()`, we pass the txn as the stat block's parent. The
+    // stat block is detached from the rest of the btree, so the result might not
+    // reflect the writes that are still in flight.
+    buf_lock_t stat_block(buf_parent_t(superblock->expose_buf().txn()),
+                          stat_block_id, access_t::read);
+    buf_read_t read(&stat_block);
+    uint32_t stat_block_size;
+    const btree_statblock_t *stat_block_buf =
+        static_cast<const btree_statblock_t *>(read.get_data_read(&stat_block_size));
+    guarantee(stat_block_size == BTREE_STATBLOCK_SIZE);
+    *population_out = stat_block_buf->population;
+    return true;
+}
+
 buf_lock_t get_root(value_sizer_t *sizer, superblock_t *sb) {
     const block_id_t node_id = sb->get_root_block_id();
 
@@ -572,6 +591,11 @@ void apply_keyvalue_change(
         // Split the node if necessary, to make sure that we have room
         // for the value.  Not necessary when deleting, because the
         // node won't grow.
+        if (kv_loc->defer_underfull_check) {
+            buf_read_t read(&kv_loc->buf);
+            auto leaf_node = static_cast<const leaf_node_t *>(read.get_data_read());
+            guarantee(!leaf::is_full(sizer, leaf_node, key, kv_loc->value.get()));
+        }
 
         check_and_handle_split(sizer, &kv_loc->buf, &kv_loc->last_buf,
                                kv_loc->superblock, key, kv_loc->value.get(),
@@ -654,8 +678,10 @@ void apply_keyvalue_change(
 
     // Check to see if the leaf is underfull (following a change in
     // size or a deletion, and merge/level if it is.
-    check_and_handle_underfull(sizer, &kv_loc->buf, &kv_loc->last_buf,
-                               kv_loc->superblock, key, balancing_detacher);
+    if (!kv_loc->defer_underfull_check) {
+        check_and_handle_underfull(sizer, &kv_loc->buf, &kv_loc->last_buf,
+                                   kv_loc->superblock, key, balancing_detacher);
+    }
 
     // Modify the stats block.  The stats block is detached from the rest of the
     // btree, we don't keep a consistent view of it, so we pass the txn as its
@@ -669,3 +695,135 @@ void apply_keyvalue_change(
         stat_block_buf->population += population_change;
     }
 }
+
+/* Returns true if `key` goes into the leaf that `kv_loc` points to, given that a key
+that isn't greater than `key` does. */
+bool leaf_contains_key(keyvalue_location_t *kv_loc,
+                       const leaf_node_t *leaf_node,
+                       const btree_key_t *key) {
+    if (kv_loc->last_buf.empty()) {
+        // The leaf is the root.
+        return true;
+    }
+    {
+        buf_read_t read(&kv_loc->last_buf);
+        auto parent = static_cast<const internal_node_t *>(read.get_data_read());
+        int index = internal_node::get_offset_index(parent, key);
+        if (internal_node::get_pair_by_index(parent, index)->lnode
+                != kv_loc->buf.block_id()) {
+            return false;
+        }
+        if (index + 1 < parent->npairs) {
+            // The parent's key for the leaf is an upper bound on the keys in it.
+            return true;
+        }
+    }
+    // The leaf is its parent's last child, whose keys are bounded by a node further
+    // up that we don't hold anymore. But the leaf certainly contains the keys up to
+    // its last one.
+    auto it = leaf::rbegin(*leaf_node);
+    return it != leaf::rend(*leaf_node) && btree_key_cmp(key, (*it).first) <= 0;
+}
+
+size_t count_keys_for_leaf(
+        value_sizer_t *sizer,
+        keyvalue_location_t *kv_loc,
+        const std::vector<const btree_key_t *> &keys,
+        size_t first) {
+    guarantee(first < keys.size());
+    buf_read_t read(&kv_loc->buf);
+    auto leaf_node = static_cast<const leaf_node_t *>(read.get_data_read());
+    // All the changes but the last one have to fit into the leaf without splitting
+    // it. We don't know their values yet, so we assume the largest ones.
+    int room = leaf::free_space_for_entries(sizer, leaf_node);
+    size_t end = first + 1;
+    while (end < keys.size()) {
+        room -= leaf::max_entry_cost(sizer, keys[end - 1]);
+        if (room < 0 || !leaf_contains_key(kv_loc, leaf_node, keys[end])) {
+            break;
+        }
+        ++end;
+    }
+    return end - first;
+}
+
+void move_keyvalue_location_in_leaf(
+        value_sizer_t *sizer,
+        keyvalue_location_t *kv_loc,
+        const btree_key_t *key) {
+    kv_loc->there_originally_was_value = false;
+    kv_loc->value.reset();
+
+    scoped_malloc_t<void> tmp(sizer->max_possible_size());
+    buf_read_t read(&kv_loc->buf);
+    auto leaf_node = static_cast<const leaf_node_t *>(read.get_data_read());
+    if (leaf::lookup(sizer, leaf_node, key, tmp.get())) {
+        kv_loc->there_originally_was_value = true;
+        kv_loc->value = std::move(tmp);
+    }
+}
+
+void erase_keyvalues_from_leaf(
+        value_sizer_t *sizer,
+        keyvalue_location_t *kv_loc,
+        const std::vector<store_key_t> &keys,
+        const value_deleter_t *balancing_detacher) {
+    guarantee(!keys.empty());
+
+    const int64_t population_change = -static_cast<int64_t>(keys.size());
+    txn_t *txn = kv_loc->buf.txn();
+
+    /* If `keys` are the only entries in the leaf, and it isn't the root, then we drop
+    the whole leaf from its parent instead of emptying it and merging it into a sibling.
+    The leaf's key range goes to its neighbor, which is fine because nothing is left in
+    it, not even tombstones. We don't do this if the parent would be left with a single
+    child; the parent may be underfull afterwards, but the next descent through it will
+    take care of that, just like after a merge. */
+    bool release_leaf = false;
+    if (!kv_loc->last_buf.empty()) {
+        buf_read_t read(&kv_loc->buf);
+        auto leaf_node = static_cast<const leaf_node_t *>(read.get_data_read());
+        buf_read_t last_read(&kv_loc->last_buf);
+        auto parent_node =
+            static_cast<const internal_node_t *>(last_read.get_data_read());
+        release_leaf = leaf_node->num_pairs == keys.size() && parent_node->npairs > 2;
+    }
+
+    if (release_leaf) {
+        {
+            buf_write_t last_write(&kv_loc->last_buf);
+            internal_node::remove(
+                sizer->block_size(),
+                static_cast<internal_node_t *>(last_write.get_data_write()),
+                keys.back().btree_key());
+        }
+        kv_loc->buf.mark_deleted();
+        kv_loc->buf.reset_buf_lock();
+    } else {
+        {
+            buf_write_t write(&kv_loc->buf);
+            auto leaf_node = static_cast<leaf_node_t *>(write.get_data_write());
+            for (const store_key_t &key : keys) {
+                leaf::erase_presence(sizer,
+                                     leaf_node,
+                                     key.btree_key(),
+                                     key_modification_proof_t::real_proof());
+            }
+        }
+
+        /* All of the keys were in the same leaf, so any one of them will do for finding
+        a sibling to merge or level with. */
+        check_and_handle_underfull(sizer, &kv_loc->buf, &kv_loc->last_buf,
+                                   kv_loc->superblock, keys.back().btree_key(),
+                                   balancing_detacher);
+    }
+
+    if (kv_loc->stat_block != NULL_BLOCK_ID) {
+        buf_lock_t stat_block(buf_parent_t(txn),
+                              kv_loc->stat_block, access_t::write);
+        buf_write_t stat_block_write(&stat_block);
+        auto stat_block_buf = static_cast<btree_statblock_t *>(
+                stat_block_write.get_data_write(BTREE_STATBLOCK_SIZE));
+        stat_block_buf->population += population_change;
+    }
+}
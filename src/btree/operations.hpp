@@ -101,7 +101,8 @@ class keyvalue_location_t {
 public:
     keyvalue_location_t()
         : superblock(nullptr), pass_back_superblock(nullptr),
-          there_originally_was_value(false), stat_block(NULL_BLOCK_ID) { }
+          there_originally_was_value(false), stat_block(NULL_BLOCK_ID),
+          defer_underfull_check(false) { }
 
     ~keyvalue_location_t() {
         if (superblock != nullptr) {
@@ -134,6 +135,11 @@ public:
     // Stat block when modifications are made using this class the statblock is
     // update.
     block_id_t stat_block;
+
+    // If set, `apply_keyvalue_change()` leaves the leaf alone when it becomes
+    // underfull, and the change must not need the leaf to be split.  This lets the
+    // caller make more changes to the same leaf, see `count_keys_for_leaf()`.
+    bool defer_underfull_check;
 private:
 
     DISABLE_COPYING(keyvalue_location_t);
@@ -192,6 +198,10 @@ void insert_root(block_id_t root_id, superblock_t *sb);
 `get_stat_block_id()`. */
 block_id_t create_stat_block(buf_parent_t parent);
 
+/* Reads the number of key/value pairs in the B-tree from its stat block. Returns `false`
+if the superblock doesn't have a stat block. */
+bool get_btree_population(superblock_t *superblock, int64_t *population_out);
+
 /* Note that there's no guarantee that `pass_back_superblock` will have been
  * pulsed by the time `find_keyvalue_location_for_write` returns. In some cases,
  * the superblock is returned only when `*keyvalue_location_out` gets destructed. */
@@ -238,4 +248,36 @@ void apply_keyvalue_change(
         key_modification_callback_t *km_callback,
         delete_mode_t delete_mode);
 
+/* `find_keyvalue_location_for_write()` descends the B-tree for every key. When a caller
+changes several keys in ascending order, it can instead find the location of the first
+one, and then point the `keyvalue_location_t` at the next ones in the same leaf with
+`move_keyvalue_location_in_leaf()`.
+
+`count_keys_for_leaf()` returns how many keys, starting with `keys[first]` for which
+`kv_loc` was found, can be changed that way. They must be in ascending order. The caller
+must set `defer_underfull_check` for all the changes but the last one, so that the leaf
+isn't merged or leveled until then. Only the last change can make the leaf split. */
+size_t count_keys_for_leaf(
+        value_sizer_t *sizer,
+        keyvalue_location_t *kv_loc,
+        const std::vector<const btree_key_t *> &keys,
+        size_t first);
+
+void move_keyvalue_location_in_leaf(
+        value_sizer_t *sizer,
+        keyvalue_location_t *kv_loc,
+        const btree_key_t *key);
+
+/* Erases the values for all of `keys` from the leaf that `kv_loc` points to, as if
+`apply_keyvalue_change()` had been called with `delete_mode_t::ERASE` for each of them,
+but only checks the leaf for underfullness and updates the stat block once. If `keys`
+are the only entries in the leaf, it removes the whole leaf from its parent instead.
+Every key in `keys` must have a value in that leaf, and the caller must already have
+detached the values. */
+void erase_keyvalues_from_leaf(
+        value_sizer_t *sizer,
+        keyvalue_location_t *kv_loc,
+        const std::vector<store_key_t> &keys,
+        const value_deleter_t *balancing_detacher);
+
 #endif  // BTREE_OPERATIONS_HPP_
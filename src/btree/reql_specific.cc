@@ -136,6 +136,24 @@ block_id_t sindex_superblock_t::get_sindex_block_id() {
     return sb_data->sindex_block;
 }
 
+repli_timestamp_t sindex_superblock_t::get_change_log_start() {
+    buf_read_t read(&sb_buf_);
+    uint32_t sb_size;
+    const reql_btree_superblock_t *sb_data =
+        static_cast<const reql_btree_superblock_t *>(read.get_data_read(&sb_size));
+    guarantee(sb_size == REQL_BTREE_SUPERBLOCK_SIZE);
+    repli_timestamp_t start;
+    memcpy(&start, sb_data->metainfo_blob, sizeof(start));
+    return start;
+}
+
+void sindex_superblock_t::set_change_log_start(repli_timestamp_t start) {
+    buf_write_t write(&sb_buf_);
+    reql_btree_superblock_t *sb_data = static_cast<reql_btree_superblock_t *>(
+        write.get_data_write(REQL_BTREE_SUPERBLOCK_SIZE));
+    memcpy(sb_data->metainfo_blob, &start, sizeof(start));
+}
+
 // Run backfilling at a reduced priority
 #define BACKFILL_CACHE_PRIORITY 10
 
@@ -182,6 +200,7 @@ btree_slice_t::btree_slice_t(cache_t *c, perfmon_collection_t *parent,
     : stats(parent,
             (index_type == index_type_t::SECONDARY ? "index-" : "") + identifier),
       cache_(c),
+      has_rightmost_key_hint_(false),
       backfill_account_(cache()->create_cache_account(BACKFILL_CACHE_PRIORITY)) { }
 
 btree_slice_t::~btree_slice_t() { }
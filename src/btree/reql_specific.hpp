@@ -63,6 +63,12 @@ public:
     we can delete such a sindex block when deleting the sindex superblock. */
     block_id_t get_sindex_block_id();
 
+    /* Change log indexes keep the timestamp since which they have logged every change
+    in the metainfo blob, which sindex superblocks don't use otherwise. It's
+    `repli_timestamp_t::distant_past` until the first change is logged. */
+    repli_timestamp_t get_change_log_start();
+    void set_change_log_start(repli_timestamp_t start);
+
     buf_parent_t expose_buf() { return buf_parent_t(&sb_buf_); }
 
 private:
@@ -98,11 +104,35 @@ public:
     cache_t *cache() { return cache_; }
     cache_account_t *get_backfill_account() { return &backfill_account_; }
 
+    /* Tables whose keys are timestamps or similar tend to receive their inserts in
+    ascending key order, at the right-hand end of the B-tree. Such inserts are much
+    cheaper through a `btree_bulk_loader_t`, but setting one up costs a descent along the
+    right-hand edge of the B-tree, so we remember the largest key that we've seen there
+    to avoid trying it for inserts that obviously aren't appends. This is only a hint;
+    it can be out of date in either direction, which just makes us guess wrong. */
+    bool might_be_append(const store_key_t &first_key) const {
+        return !has_rightmost_key_hint_ || rightmost_key_hint_ < first_key;
+    }
+    void note_rightmost_key(const store_key_t &key) {
+        rightmost_key_hint_ = key;
+        has_rightmost_key_hint_ = true;
+    }
+    /* Called by the regular insertion path, so that the hint keeps up with appends
+    that didn't go through a `btree_bulk_loader_t`. */
+    void note_key_written(const store_key_t &key) {
+        if (has_rightmost_key_hint_ && rightmost_key_hint_ < key) {
+            rightmost_key_hint_ = key;
+        }
+    }
+
     btree_stats_t stats;
 
 private:
     cache_t *cache_;
 
+    bool has_rightmost_key_hint_;
+    store_key_t rightmost_key_hint_;
+
     // Cache account to be used when backfilling.
     cache_account_t backfill_account_;
 
@@ -41,5 +41,35 @@ private:
     DISABLE_COPYING(refcount_superblock_t);
 };
 
+/* Lets operations that release their superblock when they're done run on a superblock
+that must stay acquired. The owner of `sub_superblock` is responsible for releasing it.
+*/
+class borrowed_superblock_t : public superblock_t {
+public:
+    explicit borrowed_superblock_t(superblock_t *sb) : sub_superblock(sb) { }
+
+    void release() { }
+
+    block_id_t get_root_block_id() {
+        return sub_superblock->get_root_block_id();
+    }
+
+    void set_root_block_id(block_id_t new_root_block) {
+        sub_superblock->set_root_block_id(new_root_block);
+    }
+
+    block_id_t get_stat_block_id() {
+        return sub_superblock->get_stat_block_id();
+    }
+
+    buf_parent_t expose_buf() {
+        return sub_superblock->expose_buf();
+    }
+
+private:
+    superblock_t *sub_superblock;
+
+    DISABLE_COPYING(borrowed_superblock_t);
+};
 
 #endif  // BTREE_SUPERBLOCK_HPP_
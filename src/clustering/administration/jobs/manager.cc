@@ -140,7 +140,8 @@ void jobs_manager_t::on_get_job_reports(
                     status.first,
                     status.second.second.ready,
                     status.second.second.progress_numerator,
-                    status.second.second.progress_denominator);
+                    status.second.second.progress_denominator,
+                    status.second.second.ranges_progress);
             }
 
             std::map<region_t, backfill_progress_tracker_t::progress_tracker_t> backfills =
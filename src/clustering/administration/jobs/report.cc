@@ -155,20 +155,25 @@ index_construction_job_report_t::index_construction_job_report_t(
         std::string const &_index,
         bool _is_ready,
         double _progress_numerator,
-        double _progress_denominator)
+        double _progress_denominator,
+        std::vector<double> const &_ranges_progress)
     : job_report_base_t<index_construction_job_report_t>(
         "index_construction", _id, _duration, _server_id),
       table(_table),
       index(_index),
       is_ready(_is_ready),
       progress_numerator(_progress_numerator),
-      progress_denominator(_progress_denominator) { }
+      progress_denominator(_progress_denominator),
+      ranges_progress(_ranges_progress) { }
 
 void index_construction_job_report_t::merge_derived(
        index_construction_job_report_t const &job_report) {
     is_ready &= job_report.is_ready;
     progress_numerator += job_report.progress_numerator;
     progress_denominator += job_report.progress_denominator;
+    ranges_progress.insert(ranges_progress.end(),
+                           job_report.ranges_progress.begin(),
+                           job_report.ranges_progress.end());
 }
 
 bool index_construction_job_report_t::info_derived(
@@ -203,10 +208,16 @@ bool index_construction_job_report_t::info_derived(
             ? 0
             : progress_numerator / progress_denominator));
 
+    ql::datum_array_builder_t ranges_builder(ql::configured_limits_t::unlimited);
+    for (double range_progress : ranges_progress) {
+        ranges_builder.add(ql::datum_t(range_progress));
+    }
+    info_builder_out->overwrite("ranges", std::move(ranges_builder).to_datum());
+
     return true;
 }
 
-RDB_IMPL_SERIALIZABLE_9_FOR_CLUSTER(
+RDB_IMPL_SERIALIZABLE_10_FOR_CLUSTER(
     index_construction_job_report_t,
     type,
     id,
@@ -216,7 +227,8 @@ RDB_IMPL_SERIALIZABLE_9_FOR_CLUSTER(
     index,
     is_ready,
     progress_numerator,
-    progress_denominator);
+    progress_denominator,
+    ranges_progress);
 
 query_job_report_t::query_job_report_t()
     : job_report_base_t<query_job_report_t>() { }
@@ -112,7 +112,8 @@ public:
             std::string const &index,
             bool is_ready,
             double progress_numerator,
-            double progress_denominator);
+            double progress_denominator,
+            std::vector<double> const &ranges_progress);
 
     void merge_derived(index_construction_job_report_t const &job_report);
 
@@ -128,6 +129,7 @@ public:
     bool is_ready;
     double progress_numerator;
     double progress_denominator;
+    std::vector<double> ranges_progress;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(index_construction_job_report_t);
 
@@ -66,6 +66,11 @@
 // 0 = minimal priority
 #define SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY   5
 
+// The maximal number of sub-ranges of the primary key range that secondary index post
+// construction traverses concurrently on a single store. The actual number adapts to the
+// amount of foreground writes to the table.
+#define SINDEX_POST_CONSTRUCTION_MAX_PARALLELISM  8
+
 // Size of the buffer used to perform IO operations (in bytes).
 #define IO_BUFFER_SIZE                            (4 * KILOBYTE)
 
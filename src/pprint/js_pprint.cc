@@ -786,6 +786,8 @@ static void pprint_update_reminder() {
     case Term::AVG:
     case Term::MIN:
     case Term::MAX:
+    case Term::COUNT_DISTINCT:
+    case Term::PERCENTILE:
     case Term::UNION:
     case Term::NTH:
     case Term::BRACKET:
@@ -161,6 +161,20 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(ignore_write_hook_t,
                                       ignore_write_hook_t::NO,
                                       ignore_write_hook_t::YES);
 
+// Specifies whether the client promises that the documents of an insert are sorted by
+// primary key and come after every document in the table.
+//  - presorted_t::YES: The shards may bulk load the documents. If the promise turns
+//    out to be false, they fall back to regular inserts.
+//  - presorted_t::NO: Insert the documents one at a time as usual.
+enum class presorted_t {
+    NO = 0,
+    YES = 1
+};
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(presorted_t,
+                                      int8_t,
+                                      presorted_t::NO,
+                                      presorted_t::YES);
+
 // Specifies the durability requirements of a write operation.
 //  - DURABILITY_REQUIREMENT_DEFAULT: Use the table's durability settings.
 //  - DURABILITY_REQUIREMENT_HARD: Override the table's durability settings with
@@ -277,7 +277,8 @@ ql::datum_t artificial_table_t::write_batched_insert(
         boost::optional<counted_t<const ql::func_t> > conflict_func,
         return_changes_t return_changes,
         UNUSED durability_requirement_t durability,
-        UNUSED ignore_write_hook_t ignore_write_hook) {
+        UNUSED ignore_write_hook_t ignore_write_hook,
+        UNUSED presorted_t presorted) {
     try {
         env->get_user_context().require_read_permission(
             m_rdb_context, m_database_id, m_backend->get_table_id());
@@ -78,7 +78,8 @@ public:
         boost::optional<counted_t<const ql::func_t> > conflict_func,
         return_changes_t return_changes,
         durability_requirement_t durability,
-        ignore_write_hook_t ignore_write_hook);
+        ignore_write_hook_t ignore_write_hook,
+        presorted_t presorted);
     bool write_sync_depending_on_durability(
         ql::env_t *env,
         durability_requirement_t durability);
@@ -11,6 +11,7 @@
 #include "errors.hpp"
 #include <boost/optional.hpp>
 
+#include "btree/bulk_load.hpp"
 #include "btree/concurrent_traversal.hpp"
 #include "btree/get_distribution.hpp"
 #include "btree/operations.hpp"
@@ -19,6 +20,7 @@
 #include "buffer_cache/serialize_onto_blob.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/new_mutex.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/queue/unlimited_fifo.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
@@ -34,6 +36,7 @@
 #include "rdb_protocol/serialize_datum_onto_blob.hpp"
 #include "rdb_protocol/shards.hpp"
 #include "rdb_protocol/table_common.hpp"
+#include "thread_local.hpp"
 
 #include "debug.hpp"
 
@@ -212,111 +215,93 @@ kv_location_set(keyvalue_location_t *kv_location,
     return ql::serialization_result_t::SUCCESS;
 }
 
-batched_replace_response_t rdb_replace_and_return_superblock(
-    const btree_loc_info_t &info,
+/* Replaces the row that `kv_location` points to, which has the key `key`, and returns
+the stats for the change. */
+ql::datum_t rdb_replace_at_location(
+    const btree_info_t &btree,
+    keyvalue_location_t *kv_location,
+    const store_key_t &key,
     const btree_point_replacer_t *replacer,
     const deletion_context_t *deletion_context,
-    promise_t<superblock_t *> *superblock_promise,
-    rdb_modification_info_t *mod_info_out,
-    profile::trace_t *trace) {
+    rdb_modification_info_t *mod_info_out) {
     const return_changes_t return_changes = replacer->should_return_changes();
-    const datum_string_t &primary_key = info.btree->primary_key;
-    const store_key_t &key = *info.key;
+    const datum_string_t &primary_key = btree.primary_key;
 
-    try {
-        keyvalue_location_t kv_location;
-        rdb_value_sizer_t sizer(info.superblock->cache()->max_block_size());
-        find_keyvalue_location_for_write(&sizer, info.superblock,
-                                         info.key->btree_key(),
-                                         info.btree->timestamp,
-                                         deletion_context->balancing_detacher(),
-                                         &kv_location,
-                                         trace,
-                                         superblock_promise);
-        info.btree->slice->stats.pm_keys_set.record();
-        info.btree->slice->stats.pm_total_keys_set += 1;
+    btree.slice->stats.pm_keys_set.record();
+    btree.slice->stats.pm_total_keys_set += 1;
 
-        ql::datum_t old_val;
-        if (!kv_location.value.has()) {
-            // If there's no entry with this key, pass NULL to the function.
-            old_val = ql::datum_t::null();
-        } else {
-            // Otherwise pass the entry with this key to the function.
-            old_val = get_data(kv_location.value_as<rdb_value_t>(),
-                               buf_parent_t(&kv_location.buf));
-            guarantee(old_val.get_field(primary_key, ql::NOTHROW).has());
-        }
-        guarantee(old_val.has());
+    ql::datum_t old_val;
+    if (!kv_location->value.has()) {
+        // If there's no entry with this key, pass NULL to the function.
+        old_val = ql::datum_t::null();
+    } else {
+        // Otherwise pass the entry with this key to the function.
+        old_val = get_data(kv_location->value_as<rdb_value_t>(),
+                           buf_parent_t(&kv_location->buf));
+        guarantee(old_val.get_field(primary_key, ql::NOTHROW).has());
+    }
+    guarantee(old_val.has());
 
-        ql::datum_t new_val;
-        try {
-            /* Compute the replacement value for the row */
-            new_val = replacer->replace(old_val);
-
-            /* Validate the replacement value and generate a stats object to return to
-            the user, but don't return it yet if we need to make changes. The reason for
-            this odd order is that we need to validate the change before we write the
-            change. */
-            rcheck_row_replacement(primary_key, key, old_val, new_val);
-            bool was_changed;
-            ql::datum_t resp = make_row_replacement_stats(
-                primary_key, key, old_val, new_val, return_changes, &was_changed);
-            if (!was_changed) {
-                return resp;
-            }
+    ql::datum_t new_val;
+    try {
+        /* Compute the replacement value for the row */
+        new_val = replacer->replace(old_val);
+
+        /* Validate the replacement value and generate a stats object to return to
+        the user, but don't return it yet if we need to make changes. The reason for
+        this odd order is that we need to validate the change before we write the
+        change. */
+        rcheck_row_replacement(primary_key, key, old_val, new_val);
+        bool was_changed;
+        ql::datum_t resp = make_row_replacement_stats(
+            primary_key, key, old_val, new_val, return_changes, &was_changed);
+        if (!was_changed) {
+            return resp;
+        }
 
-            /* Now that the change has passed validation, write it to disk */
-            if (new_val.get_type() == ql::datum_t::R_NULL) {
-                kv_location_delete(&kv_location, *info.key, info.btree->timestamp,
-                                   deletion_context, delete_mode_t::REGULAR_QUERY,
-                                   mod_info_out);
-            } else {
-                r_sanity_check(new_val.get_field(primary_key, ql::NOTHROW).has());
-                ql::serialization_result_t res =
-                    kv_location_set(&kv_location, *info.key, new_val,
-                                    info.btree->timestamp, deletion_context,
-                                    mod_info_out);
-                if (res & ql::serialization_result_t::ARRAY_TOO_BIG) {
-                    rfail_typed_target(&new_val, "Array too large for disk writes "
-                                       "(limit 100,000 elements).");
-                } else if (res & ql::serialization_result_t::EXTREMA_PRESENT) {
-                    rfail_typed_target(&new_val, "`r.minval` and `r.maxval` cannot be "
-                                       "written to disk.");
-                }
-                r_sanity_check(!ql::bad(res));
+        /* Now that the change has passed validation, write it to disk */
+        if (new_val.get_type() == ql::datum_t::R_NULL) {
+            kv_location_delete(kv_location, key, btree.timestamp,
+                               deletion_context, delete_mode_t::REGULAR_QUERY,
+                               mod_info_out);
+        } else {
+            r_sanity_check(new_val.get_field(primary_key, ql::NOTHROW).has());
+            ql::serialization_result_t res =
+                kv_location_set(kv_location, key, new_val,
+                                btree.timestamp, deletion_context,
+                                mod_info_out);
+            if (res & ql::serialization_result_t::ARRAY_TOO_BIG) {
+                rfail_typed_target(&new_val, "Array too large for disk writes "
+                                   "(limit 100,000 elements).");
+            } else if (res & ql::serialization_result_t::EXTREMA_PRESENT) {
+                rfail_typed_target(&new_val, "`r.minval` and `r.maxval` cannot be "
+                                   "written to disk.");
             }
+            r_sanity_check(!ql::bad(res));
+            btree.slice->note_key_written(key);
+        }
 
-            /* Report the changes for sindex and change-feed purposes */
-            if (old_val.get_type() != ql::datum_t::R_NULL) {
-                guarantee(!mod_info_out->deleted.second.empty());
-                mod_info_out->deleted.first = old_val;
-            } else {
-                guarantee(mod_info_out->deleted.second.empty());
-            }
-            if (new_val.get_type() != ql::datum_t::R_NULL) {
-                guarantee(!mod_info_out->added.second.empty());
-                mod_info_out->added.first = new_val;
-            } else {
-                guarantee(mod_info_out->added.second.empty());
-            }
+        /* Report the changes for sindex and change-feed purposes */
+        if (old_val.get_type() != ql::datum_t::R_NULL) {
+            guarantee(!mod_info_out->deleted.second.empty());
+            mod_info_out->deleted.first = old_val;
+        } else {
+            guarantee(mod_info_out->deleted.second.empty());
+        }
+        if (new_val.get_type() != ql::datum_t::R_NULL) {
+            guarantee(!mod_info_out->added.second.empty());
+            mod_info_out->added.first = new_val;
+        } else {
+            guarantee(mod_info_out->added.second.empty());
+        }
 
-            return resp;
+        return resp;
 
-        } catch (const ql::base_exc_t &e) {
-            return make_row_replacement_error_stats(old_val,
-                                                    new_val,
-                                                    return_changes,
-                                                    e.what());
-        }
-    } catch (const interrupted_exc_t &e) {
-        ql::datum_object_builder_t object_builder;
-        std::string msg = strprintf("interrupted (%s:%d)", __FILE__, __LINE__);
-        object_builder.add_error(msg.c_str());
-        // We don't rethrow because we're in a coroutine.  Theoretically the
-        // above message should never make it back to a user because the calling
-        // function will also be interrupted, but we document where it comes
-        // from to aid in future debugging if that invariant becomes violated.
-        return std::move(object_builder).to_datum();
+    } catch (const ql::base_exc_t &e) {
+        return make_row_replacement_error_stats(old_val,
+                                                new_val,
+                                                return_changes,
+                                                e.what());
     }
 }
 
@@ -383,41 +368,129 @@ private:
     const size_t index;
 };
 
-void do_a_replace_from_batched_replace(
+/* Replaces the rows for `(*keys)[(*order)[first]]` and as many of the keys after it in
+`*order` as can be changed in the same leaf, so that they only descend the B-tree and
+acquire the leaf once. Pulses `count_promise` with the number of keys it took once it
+has gotten in line for their changefeed stamps, which it does while the batch still
+holds the superblock. */
+void do_replaces_in_leaf_from_batched_replace(
     auto_drainer_t::lock_t,
     fifo_enforcer_sink_t *batched_replaces_fifo_sink,
     const fifo_enforcer_write_token_t &batched_replaces_fifo_token,
-    const btree_loc_info_t &info,
-    const one_replace_t one_replace,
-    const ql::configured_limits_t &limits,
+    const btree_info_t *info,
+    real_superblock_t *superblock,
+    const std::vector<store_key_t> *keys,
+    const std::vector<size_t> *order,
+    const std::vector<const btree_key_t *> *sorted_keys,
+    size_t first,
+    const btree_batched_replacer_t *replacer,
+    promise_t<size_t> *count_promise,
     promise_t<superblock_t *> *superblock_promise,
     rdb_modification_report_cb_t *mod_cb,
     bool update_pkey_cfeeds,
-    batched_replace_response_t *stats_out,
-    profile::trace_t *trace,
-    std::set<std::string> *conditions) {
+    std::vector<ql::datum_t> *row_stats,
+    profile::trace_t *trace) {
 
     fifo_enforcer_sink_t::exit_write_t exiter(
         batched_replaces_fifo_sink, batched_replaces_fifo_token);
     // We need to get in line for this while still holding the superblock so
     // that stamp read operations can't queue-skip.
-    info.superblock->get()->write_acq_signal()->wait_lazily_unordered();
-    rwlock_in_line_t stamp_spot = mod_cb->get_in_line_for_cfeed_stamp();
+    superblock->get()->write_acq_signal()->wait_lazily_unordered();
+    std::vector<rwlock_in_line_t> stamp_spots;
+    stamp_spots.push_back(mod_cb->get_in_line_for_cfeed_stamp());
 
     rdb_live_deletion_context_t deletion_context;
-    rdb_modification_report_t mod_report(*info.key);
-    ql::datum_t res = rdb_replace_and_return_superblock(
-        info, &one_replace, &deletion_context, superblock_promise, &mod_report.info,
-        trace);
-    *stats_out = (*stats_out).merge(res, ql::stats_merge, limits, conditions);
+    std::vector<rdb_modification_report_t> mod_reports;
+    {
+        keyvalue_location_t kv_location;
+        rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+        find_keyvalue_location_for_write(&sizer, superblock,
+                                         (*sorted_keys)[first],
+                                         info->timestamp,
+                                         deletion_context.balancing_detacher(),
+                                         &kv_location,
+                                         trace,
+                                         superblock_promise);
+        const size_t count =
+            count_keys_for_leaf(&sizer, &kv_location, *sorted_keys, first);
+        // The batch doesn't hand the superblock on to the next replace until we've
+        // pulsed `count_promise`, so we're still in line before any other write.
+        for (size_t j = 1; j < count; ++j) {
+            stamp_spots.push_back(mod_cb->get_in_line_for_cfeed_stamp());
+        }
+        count_promise->pulse(count);
+
+        mod_reports.reserve(count);
+        for (size_t j = 0; j < count; ++j) {
+            const size_t i = (*order)[first + j];
+            const store_key_t &key = (*keys)[i];
+            if (j > 0) {
+                move_keyvalue_location_in_leaf(&sizer, &kv_location, key.btree_key());
+            }
+            kv_location.defer_underfull_check = j + 1 < count;
+            mod_reports.push_back(rdb_modification_report_t(key));
+            one_replace_t one_replace(replacer, i);
+            try {
+                (*row_stats)[i] = rdb_replace_at_location(
+                    *info, &kv_location, key, &one_replace, &deletion_context,
+                    &mod_reports.back().info);
+            } catch (const interrupted_exc_t &e) {
+                ql::datum_object_builder_t object_builder;
+                std::string msg = strprintf("interrupted (%s:%d)", __FILE__, __LINE__);
+                object_builder.add_error(msg.c_str());
+                // We don't rethrow because we're in a coroutine.  Theoretically the
+                // above message should never make it back to a user because the
+                // calling function will also be interrupted, but we document where
+                // it comes from to aid in future debugging if that invariant
+                // becomes violated.
+                (*row_stats)[i] = std::move(object_builder).to_datum();
+            }
+        }
+        // The last replace merges or levels the leaf if it's underfull, unless it
+        // didn't change anything.
+        if (count > 1) {
+            check_and_handle_underfull(&sizer, &kv_location.buf, &kv_location.last_buf,
+                                       kv_location.superblock,
+                                       (*sorted_keys)[first + count - 1],
+                                       deletion_context.balancing_detacher());
+        }
+    }
 
     // We wait to make sure we acquire `acq` in the same order we were
     // originally called.
     exiter.wait();
-    new_mutex_in_line_t sindex_spot = mod_cb->get_in_line_for_sindex();
+    for (size_t j = 0; j < mod_reports.size(); ++j) {
+        new_mutex_in_line_t sindex_spot = mod_cb->get_in_line_for_sindex();
+        mod_cb->on_mod_report(
+            mod_reports[j], update_pkey_cfeeds, &sindex_spot, &stamp_spots[j]);
+    }
+}
+
+/* Returns the indexes into `keys` in ascending key order.  Writing the rows in this
+order means that consecutive replaces walk down the same path to the same leaf, which
+is then still in the cache, instead of jumping around the B-tree.  The sort is stable
+so that replaces of the same key still happen in the order the user gave them.  The
+results are still merged in the order of `keys`, see `merge_replace_stats()`. */
+std::vector<size_t> sorted_key_order(const std::vector<store_key_t> &keys) {
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+    return order;
+}
 
-    mod_cb->on_mod_report(
-        mod_report, update_pkey_cfeeds, &sindex_spot, &stamp_spot);
+/* Merges the results of the replaces in the order of the rows they belong to, so that
+`changes` and `first_error` don't depend on the order the rows were written in. */
+ql::datum_t merge_replace_stats(const std::vector<ql::datum_t> &row_stats,
+                                const ql::configured_limits_t &limits,
+                                std::set<std::string> *conditions) {
+    ql::datum_t stats = ql::datum_t::empty_object();
+    for (const ql::datum_t &row : row_stats) {
+        stats = stats.merge(row, ql::stats_merge, limits, conditions);
+    }
+    return stats;
 }
 
 batched_replace_response_t rdb_batched_replace(
@@ -433,9 +506,13 @@ batched_replace_response_t rdb_batched_replace(
     fifo_enforcer_source_t source;
     fifo_enforcer_sink_t sink;
 
-    ql::datum_t stats = ql::datum_t::empty_object();
-
-    std::set<std::string> conditions;
+    std::vector<ql::datum_t> row_stats(keys.size());
+    const std::vector<size_t> order = sorted_key_order(keys);
+    std::vector<const btree_key_t *> sorted_keys;
+    sorted_keys.reserve(order.size());
+    for (size_t i : order) {
+        sorted_keys.push_back(keys[i].btree_key());
+    }
 
     // We have to drain write operations before destructing everything above us,
     // because the coroutines being drained use them.
@@ -465,23 +542,29 @@ batched_replace_response_t rdb_batched_replace(
         bool update_pkey_cfeeds = sindex_cb->has_pkey_cfeeds(keys);
         {
             auto_drainer_t drainer;
-            for (size_t i = 0; i < keys.size(); ++i) {
+            for (size_t first = 0; first < order.size();) {
+                promise_t<size_t> count_promise;
                 promise_t<superblock_t *> superblock_promise;
                 coro_queue.push(
                     std::bind(
-                        &do_a_replace_from_batched_replace,
+                        &do_replaces_in_leaf_from_batched_replace,
                         auto_drainer_t::lock_t(&drainer),
                         &sink,
                         source.enter_write(),
-                        btree_loc_info_t(&info, current_superblock.release(), &keys[i]),
-                        one_replace_t(replacer, i),
-                        limits,
+                        &info,
+                        current_superblock.release(),
+                        &keys,
+                        &order,
+                        &sorted_keys,
+                        first,
+                        replacer,
+                        &count_promise,
                         &superblock_promise,
                         sindex_cb,
                         update_pkey_cfeeds,
-                        &stats,
-                        trace,
-                        &conditions));
+                        &row_stats,
+                        trace));
+                first += count_promise.wait();
                 current_superblock.init(
                     static_cast<real_superblock_t *>(superblock_promise.wait()));
             }
@@ -497,11 +580,165 @@ batched_replace_response_t rdb_batched_replace(
         }
     }
 
-    ql::datum_object_builder_t out(stats);
+    std::set<std::string> conditions;
+    ql::datum_object_builder_t out(merge_replace_stats(row_stats, limits, &conditions));
     out.add_warnings(conditions, limits);
     return std::move(out).to_datum();
 }
 
+void rdb_bulk_append(btree_bulk_loader_t *loader,
+                     const store_key_t &key,
+                     const ql::datum_t &data,
+                     const write_message_t &wm,
+                     repli_timestamp_t timestamp,
+                     rdb_modification_info_t *mod_info_out) {
+    scoped_malloc_t<rdb_value_t> new_value(blob::btree_maxreflen);
+    memset(new_value.get(), 0, blob::btree_maxreflen);
+
+    buf_parent_t leaf = loader->leaf_parent();
+    const max_block_size_t block_size = leaf.cache()->max_block_size();
+    {
+        blob_t blob(block_size, new_value->value_ref(), blob::btree_maxreflen);
+        write_onto_blob(leaf, &blob, wm);
+    }
+
+    rdb_value_detacher_t detacher;
+    loader->append(key.btree_key(), new_value.get(), timestamp, &detacher);
+
+    if (mod_info_out != nullptr) {
+        guarantee(mod_info_out->added.second.empty());
+        mod_info_out->added.first = data;
+        mod_info_out->added.second.assign(new_value->value_ref(),
+            new_value->value_ref() + new_value->inline_size(block_size));
+    }
+}
+
+/* Helper for `rdb_bulk_insert()` once we know that every key can be appended. */
+ql::datum_t bulk_insert_with_loader(
+    const btree_info_t &info,
+    scoped_ptr_t<real_superblock_t> *superblock,
+    btree_bulk_loader_t *loader,
+    const std::vector<store_key_t> &keys,
+    const std::vector<size_t> &order,
+    const btree_batched_replacer_t *replacer,
+    rdb_modification_report_cb_t *sindex_cb,
+    const ql::configured_limits_t &limits,
+    std::set<std::string> *conditions) {
+    const datum_string_t &primary_key = info.primary_key;
+    const return_changes_t return_changes = replacer->should_return_changes();
+    const ql::datum_t old_val = ql::datum_t::null();
+
+    std::vector<ql::datum_t> row_stats(keys.size());
+    std::vector<rdb_modification_report_t> mod_reports;
+    std::vector<rwlock_in_line_t> stamp_spots;
+    mod_reports.reserve(keys.size());
+    stamp_spots.reserve(keys.size());
+    for (size_t i : order) {
+        // Like `do_a_replace_from_batched_replace()`, we get in line for the
+        // changefeed stamps while we still hold the superblock.
+        stamp_spots.push_back(sindex_cb->get_in_line_for_cfeed_stamp());
+        mod_reports.push_back(rdb_modification_report_t(keys[i]));
+        info.slice->stats.pm_keys_set.record();
+        info.slice->stats.pm_total_keys_set += 1;
+
+        ql::datum_t resp;
+        ql::datum_t new_val;
+        try {
+            new_val = replacer->replace(old_val, i);
+            rcheck_row_replacement(primary_key, keys[i], old_val, new_val);
+            bool was_changed;
+            resp = make_row_replacement_stats(
+                primary_key, keys[i], old_val, new_val, return_changes, &was_changed);
+            if (was_changed) {
+                r_sanity_check(new_val.get_field(primary_key, ql::NOTHROW).has());
+                write_message_t wm;
+                ql::serialization_result_t res = datum_serialize(
+                    &wm, new_val, ql::check_datum_serialization_errors_t::YES);
+                if (res & ql::serialization_result_t::ARRAY_TOO_BIG) {
+                    rfail_typed_target(&new_val, "Array too large for disk writes "
+                                       "(limit 100,000 elements).");
+                } else if (res & ql::serialization_result_t::EXTREMA_PRESENT) {
+                    rfail_typed_target(&new_val, "`r.minval` and `r.maxval` cannot be "
+                                       "written to disk.");
+                }
+                r_sanity_check(!ql::bad(res));
+                rdb_bulk_append(loader, keys[i], new_val, wm, info.timestamp,
+                                &mod_reports.back().info);
+            }
+        } catch (const ql::base_exc_t &e) {
+            resp = make_row_replacement_error_stats(old_val,
+                                                    new_val,
+                                                    return_changes,
+                                                    e.what());
+        } catch (const interrupted_exc_t &e) {
+            ql::datum_object_builder_t object_builder;
+            std::string msg = strprintf("interrupted (%s:%d)", __FILE__, __LINE__);
+            object_builder.add_error(msg.c_str());
+            resp = std::move(object_builder).to_datum();
+        }
+        row_stats[i] = std::move(resp);
+    }
+
+    loader->finish();
+    superblock->reset();
+
+    for (size_t j = 0; j < mod_reports.size(); ++j) {
+        new_mutex_in_line_t sindex_spot = sindex_cb->get_in_line_for_sindex();
+        sindex_cb->on_mod_report(mod_reports[j], false, &sindex_spot, &stamp_spots[j]);
+        stamp_spots[j].reset();
+    }
+    return merge_replace_stats(row_stats, limits, conditions);
+}
+
+batched_replace_response_t rdb_bulk_insert(
+    const btree_info_t &info,
+    scoped_ptr_t<real_superblock_t> *superblock,
+    const std::vector<store_key_t> &keys,
+    const btree_batched_replacer_t *replacer,
+    rdb_modification_report_cb_t *sindex_cb,
+    ql::configured_limits_t limits,
+    profile::sampler_t *sampler,
+    profile::trace_t *trace) {
+    // The batch doesn't have to arrive in order, as long as there are no duplicate keys.
+    std::vector<size_t> order = sorted_key_order(keys);
+    bool keys_ascending = !keys.empty();
+    for (size_t i = 1; i < order.size() && keys_ascending; ++i) {
+        keys_ascending = keys[order[i - 1]] < keys[order[i]];
+    }
+    // `order_by.limit` changefeeds need to see every row in the B-tree before they are
+    // finished, which `rdb_batched_replace()` takes care of.
+    if (keys_ascending && !sindex_cb->has_pkey_cfeeds(keys)) {
+        rdb_value_sizer_t sizer((*superblock)->cache()->max_block_size());
+        btree_bulk_loader_t loader(&sizer, superblock->get());
+        if (loader.key_is_appendable(keys[order.front()].btree_key())) {
+            sampler->new_sample();
+            PROFILE_STARTER_IF_ENABLED(
+                trace != nullptr,
+                "Perform bulk insert.",
+                trace);
+            std::set<std::string> conditions;
+            ql::datum_t stats = bulk_insert_with_loader(
+                info, superblock, &loader, keys, order, replacer, sindex_cb, limits,
+                &conditions);
+            store_key_t last_key;
+            if (loader.get_last_key(&last_key)) {
+                info.slice->note_rightmost_key(last_key);
+            }
+            ql::datum_object_builder_t out(stats);
+            out.add_warnings(conditions, limits);
+            return std::move(out).to_datum();
+        }
+        store_key_t last_key;
+        if (loader.get_last_key(&last_key)) {
+            info.slice->note_rightmost_key(last_key);
+        }
+        // Releases the locks that `loader` holds on the B-tree.
+        loader.finish();
+    }
+    return rdb_batched_replace(
+        info, superblock, keys, replacer, sindex_cb, limits, sampler, trace);
+}
+
 void rdb_set(const store_key_t &key,
              ql::datum_t data,
              bool overwrite,
@@ -544,6 +781,7 @@ void rdb_set(const store_key_t &key,
         r_sanity_check(!ql::bad(res));
         guarantee(mod_info->deleted.second.empty() == !had_value &&
                   !mod_info->added.second.empty());
+        slice->note_key_written(key);
     }
     response_out->result =
         (had_value ? point_write_result_t::DUPLICATE : point_write_result_t::STORED);
@@ -593,6 +831,23 @@ void rdb_value_detacher_t::delete_value(buf_parent_t parent, const void *value)
 typedef ql::transform_variant_t transform_variant_t;
 typedef ql::terminal_variant_t terminal_variant_t;
 
+/* Looks up the row that an entry of a reference index points to. Returns an empty
+`datum_t` if there's no such row. */
+ql::datum_t get_referenced_row(btree_slice_t *primary_slice,
+                               superblock_t *primary_superblock,
+                               const store_key_t &primary_key) {
+    borrowed_superblock_t superblock(primary_superblock);
+    keyvalue_location_t kv_location;
+    rdb_value_sizer_t sizer(superblock.cache()->max_block_size());
+    find_keyvalue_location_for_read(&sizer, &superblock, primary_key.btree_key(),
+                                    &kv_location, &primary_slice->stats, nullptr);
+    if (!kv_location.value.has()) {
+        return ql::datum_t();
+    }
+    return get_data(kv_location.value_as<rdb_value_t>(),
+                    buf_parent_t(&kv_location.buf));
+}
+
 class rget_sindex_data_t {
 public:
     rget_sindex_data_t(key_range_t _pkey_range,
@@ -600,13 +855,19 @@ public:
                        key_range_t *_active_region_range_inout,
                        reql_version_t wire_func_reql_version,
                        ql::map_wire_func_t wire_func,
-                       sindex_multi_bool_t _multi)
+                       sindex_multi_bool_t _multi,
+                       bool _change_log,
+                       btree_slice_t *_primary_slice,
+                       superblock_t *_primary_superblock)
         : pkey_range(std::move(_pkey_range)),
           datumspec(std::move(_datumspec)),
           active_region_range_inout(_active_region_range_inout),
           func_reql_version(wire_func_reql_version),
           func(wire_func.compile_wire_func()),
-          multi(_multi) {
+          multi(_multi),
+          change_log(_change_log),
+          primary_slice(_primary_slice),
+          primary_superblock(_primary_superblock) {
         datumspec.visit<void>(
             [&](const ql::datum_range_t &r) {
                 lbound_trunc_key = r.get_left_bound_trunc_key(func_reql_version);
@@ -622,6 +883,12 @@ private:
     const reql_version_t func_reql_version;
     const counted_t<const ql::func_t> func;
     const sindex_multi_bool_t multi;
+    // The entries of a change log index are sorted by their timestamp rather than by
+    // the value of `func`.
+    const bool change_log;
+    // Only set for reference indexes, whose rows we have to look up.
+    btree_slice_t *const primary_slice;
+    superblock_t *const primary_superblock;
     // The (truncated) boundary keys for the datum range stored in `datumspec`.
     std::string lbound_trunc_key;
     std::string rbound_trunc_key;
@@ -778,20 +1045,33 @@ continue_bool_t rget_cb_t::handle_pair(
     if (sindex && !sindex->pkey_range.contains_key(ql::datum_t::extract_primary(key))) {
         return continue_bool_t::CONTINUE;
     }
-    lazy_btree_val_t row(static_cast<const rdb_value_t *>(keyvalue.value()),
-                         keyvalue.expose_buf());
     ql::datum_t val;
     // Count stats whether or not we deserialize the value
     io.slice->stats.pm_keys_read.record();
     io.slice->stats.pm_total_keys_read += 1;
-    // We only load the value if we actually use it (`count` does not).
-    if (job.accumulator->uses_val() || job.transformers.size() != 0 || sindex) {
-        val = row.get();
+    if (sindex && sindex->primary_superblock != nullptr) {
+        // The entries of a reference index don't hold the row. We look it up before
+        // waiting for our turn, so that the lookups for all of the pairs that the
+        // traversal hands us concurrently overlap.
+        keyvalue.reset();
+        val = get_referenced_row(sindex->primary_slice,
+                                 sindex->primary_superblock,
+                                 ql::datum_t::extract_primary(key));
+        if (!val.has()) {
+            return continue_bool_t::CONTINUE;
+        }
     } else {
-        row.reset();
+        lazy_btree_val_t row(static_cast<const rdb_value_t *>(keyvalue.value()),
+                             keyvalue.expose_buf());
+        // We only load the value if we actually use it (`count` does not).
+        if (job.accumulator->uses_val() || job.transformers.size() != 0 || sindex) {
+            val = row.get();
+        } else {
+            row.reset();
+        }
+        guarantee(!row.references_parent());
+        keyvalue.reset();
     }
-    guarantee(!row.references_parent());
-    keyvalue.reset();
     waiter.wait_interruptible(); // This enforces ordering.
 
     ///////////////////////////////////////////////////////
@@ -849,7 +1129,9 @@ continue_bool_t rget_cb_t::handle_pair(
         // lazily the first time it's called.
         ql::datum_t sindex_val_cache; // an empty `datum_t` until initialized
         auto lazy_sindex_val = [&]() -> ql::datum_t {
-            if (sindex && !sindex_val_cache.has()) {
+            if (sindex && sindex->change_log && !sindex_val_cache.has()) {
+                sindex_val_cache = val.get_field("timestamp");
+            } else if (sindex && !sindex_val_cache.has()) {
                 sindex_val_cache =
                     sindex->func->call(sindex_env.get(), val)->as_datum();
                 if (sindex->multi == sindex_multi_bool_t::MULTI
@@ -1001,6 +1283,167 @@ continue_bool_t rget_cb_t::handle_pair(
     }
 }
 
+// Splitting a range read only pays off if every sub-range has enough rows to keep its
+// traversal busy.
+int64_t rget_subrange_min_rows = 10000;
+const size_t MAX_RGET_SUBRANGES = 8;
+// The number of sub-range traversals that may run on one thread at the same time,
+// summed over all range reads. Reads that start while the thread is this busy aren't
+// split, so a loaded server keeps serving its reads one traversal each.
+const size_t MAX_RGET_SUBRANGES_PER_THREAD = 16;
+TLS_with_init(size_t, rget_subranges_in_use, 0);
+
+/* Counts `count` traversals against `rget_subranges_in_use` for as long as it exists,
+so that the count is given back however the read ends. */
+class rget_subranges_in_use_t {
+public:
+    explicit rget_subranges_in_use_t(size_t _count) : count(_count) {
+        TLS_set_rget_subranges_in_use(TLS_get_rget_subranges_in_use() + count);
+    }
+    ~rget_subranges_in_use_t() {
+        TLS_set_rget_subranges_in_use(TLS_get_rget_subranges_in_use() - count);
+    }
+private:
+    size_t count;
+    DISABLE_COPYING(rget_subranges_in_use_t);
+};
+
+/* Splits `range` into at most `max_subranges` consecutive sub-ranges of about the same
+population, using the keys in the root node of the B-tree as split points. (Going any
+deeper would cost more block reads than small range reads are worth.) Returns just
+`range` if it isn't worth splitting. Doesn't release `superblock`. */
+std::vector<key_range_t> split_rget_range(superblock_t *superblock,
+                                          const key_range_t &range,
+                                          size_t max_subranges) {
+    std::vector<key_range_t> subranges;
+    if (superblock->get_stat_block_id() == NULL_BLOCK_ID) {
+        // We can't estimate the population.
+        subranges.push_back(range);
+        return subranges;
+    }
+    int64_t key_count;
+    std::vector<store_key_t> keys;
+    get_btree_key_distribution(superblock, 1, &key_count, &keys,
+                               release_superblock_t::KEEP);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    std::vector<store_key_t> split_keys;
+    for (const store_key_t &key : keys) {
+        if (range.left < key && range.contains_key(key)) {
+            split_keys.push_back(key);
+        }
+    }
+
+    int64_t estimated_rows =
+        key_count * (split_keys.size() + 1) / static_cast<int64_t>(keys.size() + 1);
+    size_t num_subranges = std::min<size_t>(
+        {max_subranges,
+         split_keys.size() + 1,
+         static_cast<size_t>(estimated_rows / rget_subrange_min_rows)});
+    if (num_subranges < 2) {
+        subranges.push_back(range);
+        return subranges;
+    }
+    store_key_t left = range.left;
+    for (size_t i = 1; i < num_subranges; ++i) {
+        const store_key_t &split_key = split_keys[i * split_keys.size() / num_subranges];
+        key_range_t subrange = range;
+        subrange.left = left;
+        subrange.right = key_range_t::right_bound_t(split_key);
+        subranges.push_back(subrange);
+        left = split_key;
+    }
+    key_range_t last_subrange = range;
+    last_subrange.left = left;
+    subranges.push_back(last_subrange);
+    return subranges;
+}
+
+/* Evaluates a terminal over `subranges` concurrently, one traversal with its own
+environment, transforms and accumulator per sub-range, and then merges the results like
+the results of different shards. The merge goes in traversal order, so the result is the
+same as that of a single traversal. */
+void rdb_rget_subranges(
+        btree_slice_t *slice,
+        const region_t &shard,
+        const std::vector<key_range_t> &subranges,
+        superblock_t *superblock,
+        ql::env_t *ql_env,
+        const ql::batchspec_t &batchspec,
+        const std::vector<transform_variant_t> &transforms,
+        const terminal_variant_t &terminal,
+        sorting_t sorting,
+        rget_read_response_t *response,
+        release_superblock_t release_superblock) {
+    // Every traversal releases its reference once it has acquired the root.
+    refcount_superblock_t shared_superblock(superblock, subranges.size());
+    std::vector<rget_read_response_t> responses(subranges.size());
+    bool interrupted = false;
+    rget_subranges_in_use_t in_use(subranges.size());
+    pmap(subranges.size(), [&](int64_t i) {
+        // Stores without a `rdb_context_t` (in unit tests) read with a bare
+        // environment, like the one they were given.
+        scoped_ptr_t<ql::env_t> env(
+            ql_env->get_rdb_ctx() != nullptr
+                ? new ql::env_t(ql_env->get_rdb_ctx(),
+                                ql_env->return_empty_normal_batches,
+                                ql_env->interruptor,
+                                ql_env->get_serializable_env(),
+                                nullptr)
+                : new ql::env_t(ql_env->interruptor,
+                                ql_env->return_empty_normal_batches,
+                                ql_env->reql_version()));
+        rget_cb_t callback(
+            rget_io_data_t(&responses[i], slice),
+            job_data_t(env.get(),
+                       batchspec,
+                       transforms,
+                       terminal,
+                       shard,
+                       !reversed(sorting)
+                           ? subranges[i].left
+                           : subranges[i].right.key_or_max(),
+                       sorting,
+                       require_sindexes_t::NO),
+            boost::none);
+        rget_cb_wrapper_t wrapper(&callback, 1, boost::none);
+        try {
+            continue_bool_t cont = btree_concurrent_traversal(
+                release_superblock == release_superblock_t::RELEASE
+                    ? &shared_superblock
+                    : superblock,
+                subranges[i],
+                &wrapper,
+                reversed(sorting) ? BACKWARD : FORWARD,
+                release_superblock);
+            callback.finish(cont);
+        } catch (const interrupted_exc_t &) {
+            interrupted = true;
+        }
+    });
+    if (interrupted) {
+        throw interrupted_exc_t();
+    }
+
+    std::vector<ql::result_t *> results;
+    for (size_t i = 0; i < responses.size(); ++i) {
+        ql::result_t *result = &responses[
+            !reversed(sorting) ? i : responses.size() - 1 - i].result;
+        if (boost::get<ql::exc_t>(result) != nullptr) {
+            response->result = *result;
+            return;
+        }
+        results.push_back(result);
+    }
+    try {
+        scoped_ptr_t<ql::accumulator_t> acc = ql::make_terminal(terminal);
+        acc->unshard(ql_env, results);
+        acc->finish(continue_bool_t::CONTINUE, &response->result);
+    } catch (const ql::exc_t &e) {
+        response->result = e;
+    }
+}
+
 // TODO: Having two functions which are 99% the same sucks.
 void rdb_rget_slice(
         btree_slice_t *slice,
@@ -1021,6 +1464,29 @@ void rdb_rget_slice(
         "Do range scan on primary index.",
         ql_env->trace);
 
+    // Terminals other than `limit_read_t` don't depend on the order of the rows, so
+    // we can split their range into sub-ranges and traverse those concurrently. (We
+    // don't do this when profiling, because the traversals would interleave their
+    // events.)
+    if (!primary_keys
+        && terminal
+        && boost::get<ql::limit_read_t>(&*terminal) == nullptr
+        && ql_env->profile() == profile_bool_t::DONT_PROFILE) {
+        size_t in_use = TLS_get_rget_subranges_in_use();
+        if (in_use + 2 <= MAX_RGET_SUBRANGES_PER_THREAD) {
+            std::vector<key_range_t> subranges = split_rget_range(
+                superblock,
+                range,
+                std::min(MAX_RGET_SUBRANGES, MAX_RGET_SUBRANGES_PER_THREAD - in_use));
+            if (subranges.size() > 1) {
+                rdb_rget_subranges(slice, shard, subranges, superblock, ql_env,
+                                   batchspec, transforms, *terminal, sorting,
+                                   response, release_superblock);
+                return;
+            }
+        }
+    }
+
     rget_cb_t callback(
         rget_io_data_t(response, slice),
         job_data_t(ql_env,
@@ -1088,10 +1554,14 @@ void rdb_rget_secondary_slice(
         sorting_t sorting,
         require_sindexes_t require_sindex_val,
         const sindex_disk_info_t &sindex_info,
+        btree_slice_t *primary_slice,
+        superblock_t *primary_superblock,
         rget_read_response_t *response,
         release_superblock_t release_superblock) {
     r_sanity_check(boost::get<ql::exc_t>(&response->result) == nullptr);
     guarantee(sindex_info.geo == sindex_geo_bool_t::REGULAR);
+    guarantee((sindex_info.reference == sindex_reference_bool_t::REFERENCE)
+              == (primary_superblock != nullptr));
     PROFILE_STARTER_IF_ENABLED(
         ql_env->profile() == profile_bool_t::PROFILE,
         "Do range scan on secondary index.",
@@ -1119,7 +1589,10 @@ void rdb_rget_secondary_slice(
             &active_region_range,
             sindex_func_reql_version,
             sindex_info.mapping,
-            sindex_info.multi));
+            sindex_info.multi,
+            sindex_info.change_log_size != 0,
+            primary_slice,
+            primary_superblock));
 
     direction_t direction = reversed(sorting) ? BACKWARD : FORWARD;
     auto cb = [&](const std::pair<ql::datum_range_t, uint64_t> &pair, bool is_last) {
@@ -1250,7 +1723,7 @@ void rdb_get_nearest_slice(
 
 void rdb_distribution_get(int max_depth,
                           const store_key_t &left_key,
-                          real_superblock_t *superblock,
+                          superblock_t *superblock,
                           distribution_read_response_t *response) {
     int64_t key_count_out;
     std::vector<store_key_t> key_splits;
@@ -1323,9 +1796,10 @@ RDB_IMPL_SERIALIZABLE_2_SINCE_v1_13(rdb_modification_report_t, primary_key, info
 rdb_modification_report_cb_t::rdb_modification_report_cb_t(
         store_t *store,
         buf_lock_t *sindex_block,
+        repli_timestamp_t timestamp,
         auto_drainer_t::lock_t lock)
     : lock_(lock), store_(store),
-      sindex_block_(sindex_block) {
+      sindex_block_(sindex_block), timestamp_(timestamp) {
     store_->acquire_all_sindex_superblocks_for_write(sindex_block_, &sindexes_);
 }
 
@@ -1459,6 +1933,7 @@ void rdb_modification_report_cb_t::on_mod_report_sub(
     rdb_update_sindexes(store_,
                         sindexes_,
                         &mod_report,
+                        timestamp_,
                         sindex_block_->txn(),
                         &deletion_context,
                         keys_available_cond,
@@ -1510,6 +1985,59 @@ std::vector<std::string> expand_geo_key(
     }
 }
 
+/* Secondary index functions are deterministic (so no need for an rdb_context_t) and
+evaluated in a pristine environment (without global optargs). Most index functions
+don't need the environment at all (see `compute_index_value()`), so it's only set up
+the first time it's used. */
+class sindex_env_t {
+public:
+    explicit sindex_env_t(reql_version_t _reql_version)
+        : reql_version(_reql_version) { }
+
+    ql::env_t *get() {
+        if (!env.has()) {
+            env.init(new ql::env_t(&non_interruptor,
+                                   ql::return_empty_normal_batches_t::NO,
+                                   reql_version));
+        }
+        return env.get();
+    }
+
+private:
+    const reql_version_t reql_version;
+    cond_t non_interruptor;
+    scoped_ptr_t<ql::env_t> env;
+
+    DISABLE_COPYING(sindex_env_t);
+};
+
+/* Returns whether a partial index has entries for `doc`. Like the index function, the
+filter can throw `ql::base_exc_t`, in which case the row isn't indexed either. */
+bool passes_sindex_filter(sindex_env_t *sindex_env,
+                          const ql::datum_t &doc,
+                          const sindex_disk_info_t &index_info) {
+    if (!static_cast<bool>(index_info.filter)) {
+        return true;
+    }
+    return index_info.filter->compile_wire_func()->filter_call(
+        sindex_env->get(), doc, counted_t<const ql::func_t>());
+}
+
+/* Evaluates the index function on `doc`. Functions that only select fields, like
+`r.row('a')` or `[r.row('a'), r.row('b')('c')]`, read the fields straight from `doc`
+instead of going through the term interpreter. */
+ql::datum_t compute_index_value(sindex_env_t *sindex_env,
+                                const ql::datum_t &doc,
+                                const sindex_disk_info_t &index_info) {
+    counted_t<const ql::func_t> func = index_info.mapping.compile_wire_func();
+    ql::field_paths_t paths;
+    ql::datum_t value;
+    if (func->get_field_paths(&paths) && paths.extract(doc, &value)) {
+        return value;
+    }
+    return func->call(sindex_env->get(), doc)->as_datum();
+}
+
 void compute_keys(const store_key_t &primary_key,
                   ql::datum_t doc,
                   const sindex_disk_info_t &index_info,
@@ -1521,15 +2049,12 @@ void compute_keys(const store_key_t &primary_key,
     const reql_version_t reql_version =
         index_info.mapping_version_info.latest_compatible_reql_version;
 
-    // Secondary index functions are deterministic (so no need for an rdb_context_t)
-    // and evaluated in a pristine environment (without global optargs).
-    cond_t non_interruptor;
-    ql::env_t sindex_env(&non_interruptor,
-                         ql::return_empty_normal_batches_t::NO,
-                         reql_version);
+    sindex_env_t sindex_env(reql_version);
+    if (!passes_sindex_filter(&sindex_env, doc, index_info)) {
+        return;
+    }
 
-    ql::datum_t index =
-        index_info.mapping.compile_wire_func()->call(&sindex_env, doc)->as_datum();
+    ql::datum_t index = compute_index_value(&sindex_env, doc, index_info);
 
     if (index_info.multi == sindex_multi_bool_t::MULTI
         && index.get_type() == ql::datum_t::R_ARRAY) {
@@ -1604,6 +2129,423 @@ void compute_keys(const store_key_t &primary_key,
     }
 }
 
+/* Aggregate indexes have one entry per value of the index function (the group), which
+is stored under the group's secondary key with an empty primary key. Its value is the
+array `[group, count]`.
+
+Groups that are too large for a small inline value, or whose secondary key would be
+truncated, aren't counted, just like rows for which the index function fails don't
+appear in a regular index. That way the entries never need blob blocks of their own, and
+two groups never share an entry. */
+const size_t MAX_AGGREGATE_GROUP_SIZE = 200;
+
+// Returns an empty `datum_t` if the row doesn't pass the index's filter, and throws
+// `ql::base_exc_t` if it isn't counted for another reason.
+ql::datum_t compute_aggregate_group(const ql::datum_t &doc,
+                                    const sindex_disk_info_t &index_info,
+                                    store_key_t *key_out) {
+    const reql_version_t reql_version =
+        index_info.mapping_version_info.latest_compatible_reql_version;
+
+    sindex_env_t sindex_env(reql_version);
+    if (!passes_sindex_filter(&sindex_env, doc, index_info)) {
+        return ql::datum_t();
+    }
+
+    ql::datum_t group = compute_index_value(&sindex_env, doc, index_info);
+    *key_out = store_key_t(
+        group.print_secondary(reql_version, store_key_t(), boost::none));
+    rcheck_toplevel(!ql::datum_t::key_is_truncated(*key_out)
+                    && ql::datum_serialized_size(
+                           group, ql::check_datum_serialization_errors_t::NO)
+                       <= MAX_AGGREGATE_GROUP_SIZE,
+                    ql::base_exc_t::LOGIC,
+                    "Value too large for an aggregate index.");
+    return group;
+}
+
+// Adds `delta` to the count of `group`, and removes the entry once it drops to zero.
+sindex_superblock_t *update_aggregate_entry(sindex_superblock_t *superblock,
+                                            const store_key_t &key,
+                                            const ql::datum_t &group,
+                                            int64_t delta,
+                                            const deletion_context_t *deletion_context) {
+    promise_t<superblock_t *> return_superblock_local;
+    {
+        keyvalue_location_t kv_location;
+        rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+        find_keyvalue_location_for_write(
+            &sizer,
+            superblock,
+            key.btree_key(),
+            repli_timestamp_t::distant_past,
+            deletion_context->balancing_detacher(),
+            &kv_location,
+            nullptr,
+            &return_superblock_local);
+
+        int64_t count = delta;
+        if (kv_location.value.has()) {
+            ql::datum_t entry = get_data(kv_location.value_as<rdb_value_t>(),
+                                         buf_parent_t(&kv_location.buf));
+            count += entry.get(1).as_int();
+        }
+        if (count > 0) {
+            std::vector<ql::datum_t> entry{
+                group, ql::datum_t(static_cast<double>(count))};
+            ql::serialization_result_t res =
+                kv_location_set(&kv_location, key,
+                                ql::datum_t(std::move(entry),
+                                            ql::configured_limits_t::unlimited),
+                                repli_timestamp_t::distant_past,
+                                deletion_context,
+                                nullptr);
+            guarantee(!bad(res));
+        } else if (kv_location.value.has()) {
+            kv_location_delete(&kv_location, key,
+                               repli_timestamp_t::distant_past,
+                               deletion_context,
+                               delete_mode_t::REGULAR_QUERY,
+                               nullptr);
+        }
+    }
+    return static_cast<sindex_superblock_t *>(return_superblock_local.wait());
+}
+
+/* Used by `rdb_update_single_sindex()` for aggregate indexes. */
+void rdb_update_aggregate_sindex(
+        const store_t::sindex_access_t *sindex,
+        const deletion_context_t *deletion_context,
+        const rdb_modification_report_t *modification,
+        const sindex_disk_info_t &sindex_info) {
+    ql::datum_t old_group, new_group;
+    store_key_t old_key, new_key;
+    if (modification->info.deleted.first.has()) {
+        try {
+            old_group = compute_aggregate_group(
+                modification->info.deleted.first, sindex_info, &old_key);
+        } catch (const ql::base_exc_t &) {
+            // The row wasn't counted.
+        }
+    }
+    // See the comment about `sindex_is_being_deleted` in `rdb_update_single_sindex()`.
+    if (!sindex->sindex.being_deleted && modification->info.added.first.has()) {
+        try {
+            new_group = compute_aggregate_group(
+                modification->info.added.first, sindex_info, &new_key);
+        } catch (const ql::base_exc_t &) {
+            // We don't count the row.
+        }
+    }
+    if (old_group.has() && new_group.has() && old_key == new_key) {
+        // The row stays in the same group.
+        return;
+    }
+
+    sindex_superblock_t *superblock = sindex->superblock.get();
+    if (old_group.has()) {
+        superblock = update_aggregate_entry(
+            superblock, old_key, old_group, -1, deletion_context);
+    }
+    if (new_group.has()) {
+        superblock = update_aggregate_entry(
+            superblock, new_key, new_group, 1, deletion_context);
+    }
+}
+
+class aggregate_sindex_cb_t : public concurrent_traversal_callback_t {
+public:
+    aggregate_sindex_cb_t(const ql::datumspec_t *datumspec,
+                          ql::grouped_t<uint64_t> *counts)
+        : datumspec_(datumspec), counts_(counts) { }
+
+    continue_bool_t handle_pair(
+            scoped_key_value_t &&keyvalue,
+            concurrent_traversal_fifo_enforcer_signal_t waiter)
+            THROWS_ONLY(interrupted_exc_t) {
+        ql::datum_t entry =
+            get_data(static_cast<const rdb_value_t *>(keyvalue.value()),
+                     buf_parent_t(keyvalue.expose_buf()));
+        keyvalue.reset();
+        waiter.wait_interruptible();
+
+        ql::datum_t group = entry.get(0);
+        const uint64_t copies = datumspec_->copies(group);
+        if (copies > 0) {
+            (*counts_)[group] += copies * entry.get(1).as_int();
+        }
+        return continue_bool_t::CONTINUE;
+    }
+
+private:
+    const ql::datumspec_t *datumspec_;
+    ql::grouped_t<uint64_t> *counts_;
+};
+
+void rdb_read_aggregate_sindex(
+        sindex_superblock_t *superblock,
+        const ql::datumspec_t &datumspec,
+        const key_range_t &sindex_range,
+        rget_read_response_t *response,
+        release_superblock_t release_superblock) {
+    ql::grouped_t<uint64_t> counts;
+    aggregate_sindex_cb_t callback(&datumspec, &counts);
+    btree_concurrent_traversal(
+        superblock, sindex_range, &callback, direction_t::FORWARD, release_superblock);
+    response->result = std::move(counts);
+}
+
+class aggregate_scan_cb_t : public concurrent_traversal_callback_t {
+public:
+    aggregate_scan_cb_t(const ql::datumspec_t *datumspec,
+                        const sindex_disk_info_t *sindex_info,
+                        ql::grouped_t<uint64_t> *counts)
+        : datumspec_(datumspec), sindex_info_(sindex_info), counts_(counts) { }
+
+    continue_bool_t handle_pair(
+            scoped_key_value_t &&keyvalue,
+            concurrent_traversal_fifo_enforcer_signal_t waiter)
+            THROWS_ONLY(interrupted_exc_t) {
+        ql::datum_t row =
+            get_data(static_cast<const rdb_value_t *>(keyvalue.value()),
+                     buf_parent_t(keyvalue.expose_buf()));
+        keyvalue.reset();
+        waiter.wait_interruptible();
+
+        ql::datum_t group;
+        store_key_t key;
+        try {
+            group = compute_aggregate_group(row, *sindex_info_, &key);
+        } catch (const ql::base_exc_t &) {
+            // The index doesn't count this row either.
+            return continue_bool_t::CONTINUE;
+        }
+        if (!group.has()) {
+            return continue_bool_t::CONTINUE;
+        }
+        const uint64_t copies = datumspec_->copies(group);
+        if (copies > 0) {
+            (*counts_)[group] += copies;
+        }
+        return continue_bool_t::CONTINUE;
+    }
+
+private:
+    const ql::datumspec_t *datumspec_;
+    const sindex_disk_info_t *sindex_info_;
+    ql::grouped_t<uint64_t> *counts_;
+};
+
+void rdb_scan_aggregate_sindex(
+        real_superblock_t *superblock,
+        const key_range_t &pk_range,
+        const ql::datumspec_t &datumspec,
+        const sindex_disk_info_t &sindex_info,
+        rget_read_response_t *response,
+        release_superblock_t release_superblock) {
+    ql::grouped_t<uint64_t> counts;
+    aggregate_scan_cb_t callback(&datumspec, &sindex_info, &counts);
+    btree_concurrent_traversal(
+        superblock, pk_range, &callback, direction_t::FORWARD, release_superblock);
+    response->result = std::move(counts);
+}
+
+/* Change log indexes have one entry per logged change, stored under the secondary key of
+the write's timestamp (as a number) followed by the row's primary key. Its value is the
+object `{timestamp, old_val, new_val}`, with the values of the index function before and
+after the write. Timestamps only grow, so the oldest entries are at the left end.
+
+The sindex superblock also stores the timestamp since which the log has every change
+(see `sindex_superblock_t::get_change_log_start()`). It moves forward as old entries
+expire, and it's cleared whenever the index is changed without logging, because the log
+has a gap then. */
+
+// Every logged change removes at most this many expired entries, which keeps up with
+// the one entry it adds while bounding the work a single write does.
+const size_t MAX_CHANGE_LOG_ENTRIES_PRUNED = 4;
+
+ql::datum_t change_log_timestamp_datum(repli_timestamp_t timestamp) {
+    return ql::datum_t(static_cast<double>(timestamp.longtime));
+}
+
+// The smallest key of the entries with timestamp `timestamp`.
+store_key_t change_log_timestamp_key(repli_timestamp_t timestamp,
+                                     const sindex_disk_info_t &sindex_info) {
+    return ql::datum_range_t(change_log_timestamp_datum(timestamp)).to_sindex_keyrange(
+        sindex_info.mapping_version_info.latest_compatible_reql_version).left;
+}
+
+/* Collects the keys of the first `max_entries` entries of a change log index in the
+direction of the traversal. */
+class change_log_cb_t : public depth_first_traversal_callback_t {
+public:
+    explicit change_log_cb_t(size_t max_entries)
+        : max_entries_(max_entries) { }
+
+    continue_bool_t handle_pair(scoped_key_value_t &&keyvalue, signal_t *) {
+        keys.push_back(store_key_t(keyvalue.key()));
+        return keys.size() < max_entries_
+            ? continue_bool_t::CONTINUE
+            : continue_bool_t::ABORT;
+    }
+
+    std::vector<store_key_t> keys;
+
+private:
+    const size_t max_entries_;
+
+    DISABLE_COPYING(change_log_cb_t);
+};
+
+/* Used by `rdb_update_single_sindex()` for change log indexes. */
+void rdb_update_change_log_sindex(
+        const store_t::sindex_access_t *sindex,
+        const deletion_context_t *deletion_context,
+        const rdb_modification_report_t *modification,
+        repli_timestamp_t timestamp,
+        const sindex_disk_info_t &sindex_info) {
+    // Nothing is logged once the index is being deleted, see the comment about
+    // `sindex_is_being_deleted` in `rdb_update_single_sindex()`.
+    if (sindex->sindex.being_deleted) {
+        return;
+    }
+    sindex_superblock_t *superblock = sindex->superblock.get();
+    if (timestamp == repli_timestamp_t::distant_past) {
+        // Changes that don't come from a single write (backfills, `reset_data()` and
+        // index construction) aren't logged. The log has a gap now, so it only covers
+        // the changes from the next logged one on.
+        if (superblock->get_change_log_start() != repli_timestamp_t::distant_past) {
+            superblock->set_change_log_start(repli_timestamp_t::distant_past);
+        }
+        return;
+    }
+
+    const reql_version_t reql_version =
+        sindex_info.mapping_version_info.latest_compatible_reql_version;
+    sindex_env_t sindex_env(reql_version);
+    ql::datum_t old_val = ql::datum_t::null();
+    ql::datum_t new_val = ql::datum_t::null();
+    try {
+        if (modification->info.deleted.first.has()) {
+            old_val = compute_index_value(
+                &sindex_env, modification->info.deleted.first, sindex_info);
+        }
+    } catch (const ql::base_exc_t &) {
+        // The row doesn't have a value, as if it didn't exist.
+    }
+    try {
+        if (modification->info.added.first.has()) {
+            new_val = compute_index_value(
+                &sindex_env, modification->info.added.first, sindex_info);
+        }
+    } catch (const ql::base_exc_t &) {
+    }
+    if (old_val == new_val) {
+        return;
+    }
+
+    // Entries older than `oldest_kept` expire. The log covers the changes since the
+    // first one it logged after a gap, but not the ones that may have expired.
+    repli_timestamp_t oldest_kept = repli_timestamp_t::distant_past;
+    if (timestamp.longtime > sindex_info.change_log_size) {
+        oldest_kept.longtime = timestamp.longtime - sindex_info.change_log_size;
+    }
+    const repli_timestamp_t old_start = superblock->get_change_log_start();
+    const repli_timestamp_t new_start = std::max(
+        old_start == repli_timestamp_t::distant_past ? timestamp : old_start,
+        oldest_kept);
+    if (new_start != old_start) {
+        superblock->set_change_log_start(new_start);
+    }
+
+    if (oldest_kept != repli_timestamp_t::distant_past) {
+        change_log_cb_t expired(MAX_CHANGE_LOG_ENTRIES_PRUNED);
+        cond_t non_interruptor;
+        btree_depth_first_traversal(
+            superblock,
+            key_range_t(key_range_t::none, store_key_t(),
+                        key_range_t::open,
+                        change_log_timestamp_key(oldest_kept, sindex_info)),
+            &expired,
+            access_t::read,
+            direction_t::FORWARD,
+            release_superblock_t::KEEP,
+            &non_interruptor);
+        for (const store_key_t &key : expired.keys) {
+            promise_t<superblock_t *> return_superblock_local;
+            {
+                keyvalue_location_t kv_location;
+                rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+                find_keyvalue_location_for_write(
+                    &sizer,
+                    superblock,
+                    key.btree_key(),
+                    repli_timestamp_t::distant_past,
+                    deletion_context->balancing_detacher(),
+                    &kv_location,
+                    nullptr,
+                    &return_superblock_local);
+                guarantee(kv_location.value.has());
+                kv_location_delete(&kv_location, key,
+                                   repli_timestamp_t::distant_past,
+                                   deletion_context,
+                                   delete_mode_t::REGULAR_QUERY,
+                                   nullptr);
+            }
+            superblock =
+                static_cast<sindex_superblock_t *>(return_superblock_local.wait());
+        }
+    }
+
+    ql::datum_object_builder_t entry;
+    entry.overwrite("timestamp", change_log_timestamp_datum(timestamp));
+    entry.overwrite("old_val", old_val);
+    entry.overwrite("new_val", new_val);
+    store_key_t key(change_log_timestamp_datum(timestamp).print_secondary(
+        reql_version, modification->primary_key, boost::none));
+    promise_t<superblock_t *> return_superblock_local;
+    {
+        keyvalue_location_t kv_location;
+        rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+        find_keyvalue_location_for_write(
+            &sizer,
+            superblock,
+            key.btree_key(),
+            repli_timestamp_t::distant_past,
+            deletion_context->balancing_detacher(),
+            &kv_location,
+            nullptr,
+            &return_superblock_local);
+        // The values came from rows that have been written already, so they can be
+        // serialized.
+        ql::serialization_result_t res =
+            kv_location_set(&kv_location, key, std::move(entry).to_datum(),
+                            repli_timestamp_t::distant_past,
+                            deletion_context,
+                            nullptr);
+        guarantee(!bad(res));
+    }
+    return_superblock_local.wait();
+}
+
+bool rdb_change_log_covers(
+        sindex_superblock_t *superblock,
+        const key_range_t &sindex_range,
+        const sindex_disk_info_t &sindex_info) {
+    guarantee(sindex_info.change_log_size != 0);
+    if (sindex_range.left == store_key_t::min()) {
+        // The read asks for everything that's left.
+        return true;
+    }
+    const repli_timestamp_t start = superblock->get_change_log_start();
+    if (start == repli_timestamp_t::distant_past) {
+        // Nothing has been logged since the index was created or the log had a gap.
+        return false;
+    }
+    // Changes older than `start` may be missing from the log.
+    return !(sindex_range.left < change_log_timestamp_key(start, sindex_info));
+}
+
 void serialize_sindex_info(write_message_t *wm,
                            const sindex_disk_info_t &info) {
     serialize_cluster_version(wm, cluster_version_t::LATEST_DISK);
@@ -1617,6 +2559,10 @@ void serialize_sindex_info(write_message_t *wm,
     serialize<cluster_version_t::LATEST_DISK>(wm, info.mapping);
     serialize<cluster_version_t::LATEST_DISK>(wm, info.multi);
     serialize<cluster_version_t::LATEST_DISK>(wm, info.geo);
+    serialize<cluster_version_t::LATEST_DISK>(wm, info.aggregate);
+    serialize<cluster_version_t::LATEST_DISK>(wm, info.reference);
+    serialize<cluster_version_t::LATEST_DISK>(wm, info.filter);
+    serialize<cluster_version_t::LATEST_DISK>(wm, info.change_log_size);
 }
 
 void deserialize_sindex_info(
@@ -1699,6 +2645,35 @@ void deserialize_sindex_info(
         break;
     default: unreachable();
     }
+    switch (cluster_version) {
+    case cluster_version_t::v1_14: // fallthru
+    case cluster_version_t::v1_15: // fallthru
+    case cluster_version_t::v1_16: // fallthru
+    case cluster_version_t::v2_0: // fallthru
+    case cluster_version_t::v2_1: // fallthru
+    case cluster_version_t::v2_2: // fallthru
+    case cluster_version_t::v2_3:
+        info_out->aggregate = sindex_aggregate_bool_t::REGULAR;
+        info_out->reference = sindex_reference_bool_t::COPY;
+        info_out->filter = boost::none;
+        info_out->change_log_size = 0;
+        break;
+    case cluster_version_t::v2_4_is_latest:
+        success = deserialize_for_version(
+            cluster_version, &read_stream, &info_out->aggregate);
+        throw_if_bad_deserialization(success, "sindex description");
+        success = deserialize_for_version(
+            cluster_version, &read_stream, &info_out->reference);
+        throw_if_bad_deserialization(success, "sindex description");
+        success = deserialize_for_version(
+            cluster_version, &read_stream, &info_out->filter);
+        throw_if_bad_deserialization(success, "sindex description");
+        success = deserialize_for_version(
+            cluster_version, &read_stream, &info_out->change_log_size);
+        throw_if_bad_deserialization(success, "sindex description");
+        break;
+    default: unreachable();
+    }
     guarantee(static_cast<size_t>(read_stream.tell()) == data.size(),
               "An sindex description was incompletely deserialized.");
 }
@@ -1727,12 +2702,40 @@ void deserialize_sindex_info_or_crash(
         });
 }
 
+/* Returns the keys that a reference index has both before and after `modification`.
+Their entries only hold the primary key, so they don't have to be rewritten. */
+std::set<store_key_t> unchanged_reference_keys(
+        const rdb_modification_report_t *modification,
+        const sindex_disk_info_t &sindex_info) {
+    std::set<store_key_t> unchanged;
+    try {
+        std::vector<std::pair<store_key_t, ql::datum_t> > old_keys, new_keys;
+        compute_keys(modification->primary_key, modification->info.deleted.first,
+                     sindex_info, &old_keys, nullptr);
+        compute_keys(modification->primary_key, modification->info.added.first,
+                     sindex_info, &new_keys, nullptr);
+        std::set<store_key_t> old_key_set;
+        for (const auto &pair : old_keys) {
+            old_key_set.insert(pair.first);
+        }
+        for (const auto &pair : new_keys) {
+            if (old_key_set.count(pair.first) != 0) {
+                unchanged.insert(pair.first);
+            }
+        }
+    } catch (const ql::base_exc_t &) {
+        // One of the two versions of the row isn't in the index at all.
+    }
+    return unchanged;
+}
+
 /* Used below by rdb_update_sindexes. */
 void rdb_update_single_sindex(
         store_t *store,
         const store_t::sindex_access_t *sindex,
         const deletion_context_t *deletion_context,
         const rdb_modification_report_t *modification,
+        repli_timestamp_t timestamp,
         size_t *updates_left,
         auto_drainer_t::lock_t,
         cond_t *keys_available_cond,
@@ -1754,6 +2757,29 @@ void rdb_update_single_sindex(
     } catch (const archive_exc_t &e) {
         crash("%s", e.what());
     }
+    if (sindex_info.aggregate == sindex_aggregate_bool_t::AGGREGATE) {
+        // Aggregate indexes don't have any keys for changefeeds.
+        if (keys_available_cond != nullptr) {
+            guarantee(*updates_left > 0);
+            if (--*updates_left == 0) {
+                keys_available_cond->pulse();
+            }
+        }
+        rdb_update_aggregate_sindex(sindex, deletion_context, modification, sindex_info);
+        return;
+    }
+    if (sindex_info.change_log_size != 0) {
+        // Neither do change log indexes.
+        if (keys_available_cond != nullptr) {
+            guarantee(*updates_left > 0);
+            if (--*updates_left == 0) {
+                keys_available_cond->pulse();
+            }
+        }
+        rdb_update_change_log_sindex(
+            sindex, deletion_context, modification, timestamp, sindex_info);
+        return;
+    }
     // TODO(2015-01): Actually get real profiling information for
     // secondary index updates.
     profile::trace_t *const trace = nullptr;
@@ -1762,6 +2788,20 @@ void rdb_update_single_sindex(
 
     auto cserver = store->changefeed_server(modification->primary_key);
 
+    // If the secondary index is being deleted, we don't add any new values to
+    // the sindex tree.
+    // This is so we don't race against any sindex erase about who is faster
+    // (we with inserting new entries, or the erase with removing them).
+    const bool sindex_is_being_deleted = sindex->sindex.being_deleted;
+
+    std::set<store_key_t> unchanged_keys;
+    if (sindex_info.reference == sindex_reference_bool_t::REFERENCE
+        && !sindex_is_being_deleted
+        && modification->info.deleted.first.has()
+        && modification->info.added.first.has()) {
+        unchanged_keys = unchanged_reference_keys(modification, sindex_info);
+    }
+
     if (modification->info.deleted.first.has()) {
         guarantee(!modification->info.deleted.second.empty());
         try {
@@ -1788,6 +2828,9 @@ void rdb_update_single_sindex(
                     }, cserver.second);
             }
             for (auto it = keys.begin(); it != keys.end(); ++it) {
+                if (unchanged_keys.count(it->first) != 0) {
+                    continue;
+                }
                 promise_t<superblock_t *> return_superblock_local;
                 {
                     keyvalue_location_t kv_location;
@@ -1825,11 +2868,6 @@ void rdb_update_single_sindex(
         }
     }
 
-    // If the secondary index is being deleted, we don't add any new values to
-    // the sindex tree.
-    // This is so we don't race against any sindex erase about who is faster
-    // (we with inserting new entries, or the erase with removing them).
-    const bool sindex_is_being_deleted = sindex->sindex.being_deleted;
     if (!sindex_is_being_deleted && modification->info.added.first.has()) {
         bool decremented_updates_left = false;
         try {
@@ -1865,6 +2903,9 @@ void rdb_update_single_sindex(
                     }, cserver.second);
             }
             for (auto it = keys.begin(); it != keys.end(); ++it) {
+                if (unchanged_keys.count(it->first) != 0) {
+                    continue;
+                }
                 promise_t<superblock_t *> return_superblock_local;
                 {
                     keyvalue_location_t kv_location;
@@ -1880,11 +2921,19 @@ void rdb_update_single_sindex(
                         trace,
                         &return_superblock_local);
 
+                    // The primary key is already part of the entry's key, so the
+                    // entries of a reference index just hold `null`.
                     ql::serialization_result_t res =
-                        kv_location_set(&kv_location, it->first,
-                                        modification->info.added.second,
-                                        repli_timestamp_t::distant_past,
-                                        deletion_context);
+                        sindex_info.reference == sindex_reference_bool_t::REFERENCE
+                        ? kv_location_set(&kv_location, it->first,
+                                          ql::datum_t::null(),
+                                          repli_timestamp_t::distant_past,
+                                          deletion_context,
+                                          nullptr)
+                        : kv_location_set(&kv_location, it->first,
+                                          modification->info.added.second,
+                                          repli_timestamp_t::distant_past,
+                                          deletion_context);
                     // this particular context cannot fail AT THE MOMENT.
                     guarantee(!bad(res));
                     // The keyvalue location gets destroyed here.
@@ -1940,6 +2989,7 @@ void rdb_update_sindexes(
     store_t *store,
     const store_t::sindex_access_vector_t &sindexes,
     const rdb_modification_report_t *modification,
+    repli_timestamp_t timestamp,
     txn_t *txn,
     const deletion_context_t *deletion_context,
     cond_t *keys_available_cond,
@@ -1979,6 +3029,7 @@ void rdb_update_sindexes(
                         sindex.get(),
                         actual_deletion_context,
                         modification,
+                        timestamp,
                         &counter,
                         auto_drainer_t::lock_t(&drainer),
                         keys_available_cond,
@@ -2010,27 +3061,16 @@ public:
             const std::set<uuid_u> &sindexes_to_post_construct,
             cond_t *on_indexes_deleted,
             const std::function<bool(int64_t)> &check_should_abort,
+            std::map<store_key_t, ql::datum_t> *counted_rows_out,
             signal_t *interruptor)
         : store_(store),
           sindexes_to_post_construct_(sindexes_to_post_construct),
           on_indexes_deleted_(on_indexes_deleted),
           interruptor_(interruptor),
           check_should_abort_(check_should_abort),
+          counted_rows_out_(counted_rows_out),
           pairs_constructed_(0),
-          stopped_before_completion_(false),
-          current_chunk_size_(0) {
-        // Start an initial write transaction for the first chunk.
-        // (this acquisition should never block)
-        new_mutex_acq_t wtxn_acq(&wtxn_lock_);
-        start_write_transaction(&wtxn_acq);
-    }
-
-    ~post_construct_traversal_helper_t() {
-        sindexes_.clear();
-        if (wtxn_.has()) {
-            wtxn_->commit();
-        }
-    }
+          stopped_before_completion_(false) { }
 
     continue_bool_t handle_pair(
             scoped_key_value_t &&keyvalue,
@@ -2059,48 +3099,16 @@ public:
                 std::vector<char>(rdb_value->value_ref(),
                     rdb_value->value_ref() + rdb_value->inline_size(block_size)));
 
-        // Store the value into the secondary indexes
-        {
-            // We need this mutex because we don't want `wtxn` to be destructed,
-            // but also because only one coroutine can be traversing the indexes
-            // through `rdb_update_sindexes` at a time (or else the btree will get
-            // corrupted!).
-            new_mutex_acq_t wtxn_acq(&wtxn_lock_, interruptor_);
-            guarantee(wtxn_.has());
-            const rdb_post_construction_deletion_context_t deletion_context;
-            rdb_update_sindexes(store_,
-                                sindexes_,
-                                &mod_report,
-                                wtxn_.get(),
-                                &deletion_context,
-                                nullptr,
-                                nullptr,
-                                nullptr);
-        }
-
-        // Account for the sindex writes in the stats
-        store_->btree->stats.pm_keys_set.record(sindexes_.size());
-        store_->btree->stats.pm_total_keys_set += sindexes_.size();
-
-        // Update the traversed range boundary (everything below here will happen in
-        // key order).
-        // This can't be interrupted, because we have already called rdb_update_sindexes,
-        // so now we /must/ update traversed_right_bound.
-        waiter.wait();
-        traversed_right_bound_ = primary_key;
-
-        // Release the write transaction and secondary index locks once we've reached the
-        // designated chunk size. Then acquire a new transaction once the previous one
-        // has been flushed.
+        // Queue up the value for the secondary indexes. Everything below here happens
+        // in key order, so `pending_` always holds the pairs right before
+        // `traversed_right_bound_`.
+        waiter.wait_interruptible();
         {
-            new_mutex_acq_t wtxn_acq(&wtxn_lock_, interruptor_);
-            ++current_chunk_size_;
-            if (current_chunk_size_ >= MAX_CHUNK_SIZE) {
-                current_chunk_size_ = 0;
-                sindexes_.clear();
-                wtxn_->commit();
-                wtxn_.reset();
-                start_write_transaction(&wtxn_acq);
+            new_mutex_acq_t pending_acq(&pending_lock_, interruptor_);
+            pending_.push_back(std::move(mod_report));
+            traversed_right_bound_ = primary_key;
+            if (pending_.size() >= MAX_CHUNK_SIZE) {
+                flush_pending(&pending_acq);
             }
         }
 
@@ -2113,6 +3121,13 @@ public:
         }
     }
 
+    // Stores the pairs that are still pending into the secondary indexes. Must be
+    // called once the traversal is done, before `get_traversed_right_bound()`.
+    void flush() THROWS_ONLY(interrupted_exc_t) {
+        new_mutex_acq_t pending_acq(&pending_lock_, interruptor_);
+        flush_pending(&pending_acq);
+    }
+
     store_key_t get_traversed_right_bound() const {
         return traversed_right_bound_;
     }
@@ -2122,16 +3137,23 @@ public:
     }
 
 private:
-    // Number of key/value pairs we process before releasing the write transaction
-    // and waiting for the secondary index data to be flushed to disk.
-    // Also see the comment above `scoped_ptr_t<txn_t> wtxn;` below.
-    static const int MAX_CHUNK_SIZE = 32;
-
-    void start_write_transaction(new_mutex_acq_t *wtxn_acq) {
-        wtxn_acq->guarantee_is_holding(&wtxn_lock_);
-        guarantee(!wtxn_.has());
+    // Number of key/value pairs that we collect before we write them to the secondary
+    // indexes in a single write transaction and wait for the secondary index data to
+    // be flushed to disk.
+    static const size_t MAX_CHUNK_SIZE = 32;
+
+    void flush_pending(new_mutex_acq_t *pending_acq) THROWS_ONLY(interrupted_exc_t) {
+        pending_acq->guarantee_is_holding(&pending_lock_);
+        if (pending_.empty()) {
+            return;
+        }
 
-        // Start a write transaction and acquire the secondary indexes
+        // Start a write transaction and acquire the secondary indexes.
+        // We only do this once we have a whole chunk of pairs, rather than holding on
+        // to the secondary index superblocks while we traverse the primary btree. This
+        // lets other post constructions of the same indexes (on other parts of the key
+        // range) and writes to the parts of the indexes that are already live proceed
+        // in the meantime.
         write_token_t token;
         store_->new_write_token(&token);
 
@@ -2141,12 +3163,13 @@ private:
         // dirty page limit and bring down the whole table.
         // Other than that, the hard durability guarantee is not actually
         // needed here.
+        scoped_ptr_t<txn_t> wtxn;
         scoped_ptr_t<real_superblock_t> superblock;
         store_->acquire_superblock_for_write(
-                2 + MAX_CHUNK_SIZE,
+                2 + pending_.size(),
                 write_durability_t::HARD,
                 &token,
-                &wtxn_,
+                &wtxn,
                 &superblock,
                 interruptor_);
 
@@ -2160,26 +3183,62 @@ private:
             sindexes_to_post_construct_,
             &sindex_block,
             &all_sindexes);
+        sindex_block.reset_buf_lock();
 
         // Filter out indexes that are being deleted. No need to keep post-constructing
         // those.
-        guarantee(sindexes_.empty());
+        store_t::sindex_access_vector_t sindexes;
         for (auto &&access : all_sindexes) {
             if (!access->sindex.being_deleted) {
-                sindexes_.emplace_back(std::move(access));
+                sindexes.emplace_back(std::move(access));
             }
         }
-        if (sindexes_.empty()) {
+        all_sindexes.clear();
+        if (sindexes.empty()) {
             // All indexes have been deleted. Interrupt the traversal.
             on_indexes_deleted_->pulse_if_not_already_pulsed();
+            pending_.clear();
+            wtxn->commit();
+            throw interrupted_exc_t();
         }
 
         // We pretend that the indexes have been fully constructed, so that when we call
-        // `rdb_update_sindexes` above, it actually updates the range we're currently
+        // `rdb_update_sindexes` below, it actually updates the range we're currently
         // constructing. This is a bit hacky, but works.
-        for (auto &&access : sindexes_) {
+        for (auto &&access : sindexes) {
             access->sindex.needs_post_construction_range = key_range_t::empty();
         }
+
+        // The counts of an aggregate index aren't idempotent. The caller needs to know
+        // which rows we counted to reconcile them with the writes in its queue.
+        if (counted_rows_out_ != nullptr && has_aggregate_sindex(sindexes)) {
+            for (const auto &mod_report : pending_) {
+                (*counted_rows_out_)[mod_report.primary_key] =
+                    mod_report.info.added.first;
+            }
+        }
+
+        // Store the values into the secondary indexes
+        const rdb_post_construction_deletion_context_t deletion_context;
+        for (const auto &mod_report : pending_) {
+            rdb_update_sindexes(store_,
+                                sindexes,
+                                &mod_report,
+                                repli_timestamp_t::distant_past,
+                                wtxn.get(),
+                                &deletion_context,
+                                nullptr,
+                                nullptr,
+                                nullptr);
+        }
+
+        // Account for the sindex writes in the stats
+        store_->btree->stats.pm_keys_set.record(pending_.size() * sindexes.size());
+        store_->btree->stats.pm_total_keys_set += pending_.size() * sindexes.size();
+
+        pending_.clear();
+        sindexes.clear();
+        wtxn->commit();
     }
 
     store_t *store_;
@@ -2188,25 +3247,23 @@ private:
     signal_t *interruptor_;
 
     std::function<bool(int64_t)> check_should_abort_;
+    std::map<store_key_t, ql::datum_t> *counted_rows_out_;
 
     // How far we've come in the traversal
     int64_t pairs_constructed_;
     store_key_t traversed_right_bound_;
     bool stopped_before_completion_;
 
-    // We re-use a single write transaction and secondary index acquisition for a chunk
-    // of writes to get better efficiency when flushing the index writes to disk.
-    // We reset the transaction  after each chunk because large write transactions can
+    // The pairs that we've traversed, but haven't written to the secondary indexes
+    // yet. We write them in chunks of `MAX_CHUNK_SIZE` to get better efficiency when
+    // flushing the index writes to disk.
+    // We don't make the chunks any larger because large write transactions can
     // cause the cache to go into throttling, and that would interfere with other
     // transactions on this table.
-    // Another aspect to keep in mind is that if we hold the write lock on the sindexes
-    // for too long, other concurrent writes to parts of the secondary index that
-    // are already live will also be delayed.
-    scoped_ptr_t<txn_t> wtxn_;
-    store_t::sindex_access_vector_t sindexes_;
-    int current_chunk_size_;
-    // Controls access to `sindexes_` and `wtxn_`.
-    new_mutex_t wtxn_lock_;
+    std::vector<rdb_modification_report_t> pending_;
+    // Controls access to `pending_`. Only one coroutine can be traversing the indexes
+    // through `rdb_update_sindexes` at a time (or else the btree will get corrupted!).
+    new_mutex_t pending_lock_;
 };
 
 void post_construct_secondary_index_range(
@@ -2214,6 +3271,7 @@ void post_construct_secondary_index_range(
         const std::set<uuid_u> &sindex_ids_to_post_construct,
         key_range_t *construction_range_inout,
         const std::function<bool(int64_t)> &check_should_abort,
+        std::map<store_key_t, ql::datum_t> *counted_rows_out,
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t) {
 
@@ -2239,15 +3297,16 @@ void post_construct_secondary_index_range(
         interruptor,
         true /* USE_SNAPSHOT */);
 
-    // Note: This starts a write transaction, which might get throttled.
-    // It is important that we construct the `traversal_cb` *after* we've started
-    // the snapshotted read transaction, or otherwise we might deadlock in the presence
-    // of additional (unrelated) write transactions..
+    // Note: The `traversal_cb` starts write transactions, which might get throttled.
+    // It is important that we only do that *after* we've started the snapshotted read
+    // transaction, or otherwise we might deadlock in the presence of additional
+    // (unrelated) write transactions.
     post_construct_traversal_helper_t traversal_cb(
         store,
         sindex_ids_to_post_construct,
         &on_index_deleted_interruptor,
         check_should_abort,
+        counted_rows_out,
         interruptor);
 
     cache_account
@@ -2265,18 +3324,38 @@ void post_construct_secondary_index_range(
         throw interrupted_exc_t();
     }
 
+    // Write out the last chunk of pairs
+    traversal_cb.flush();
+
     // Update the left bound of the construction range
     if (!traversal_cb.stopped_before_completion()) {
         // The construction is done. Set the remaining range to empty.
         *construction_range_inout = key_range_t::empty();
+    } else if (construction_range_inout->right.unbounded) {
+        *construction_range_inout = key_range_t(
+            key_range_t::open, traversal_cb.get_traversed_right_bound(),
+            key_range_t::none, store_key_t());
     } else {
-        // (the key_range_t construction below needs to be updated if the right bound can
-        //  be bounded. For now we assume it's unbounded.)
-        guarantee(construction_range_inout->right.unbounded);
         *construction_range_inout = key_range_t(
-            key_range_t::bound_t::open, traversal_cb.get_traversed_right_bound(),
-            key_range_t::bound_t::none, store_key_t());
+            key_range_t::open, traversal_cb.get_traversed_right_bound(),
+            key_range_t::open, construction_range_inout->right.key());
     }
 }
 
+bool has_aggregate_sindex(const store_t::sindex_access_vector_t &sindexes) {
+    for (const auto &access : sindexes) {
+        sindex_disk_info_t sindex_info;
+        try {
+            deserialize_sindex_info_or_crash(access->sindex.opaque_definition,
+                                             &sindex_info);
+        } catch (const archive_exc_t &e) {
+            crash("%s", e.what());
+        }
+        if (sindex_info.aggregate == sindex_aggregate_bool_t::AGGREGATE) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void noop_value_deleter_t::delete_value(buf_parent_t, const void *) const { }
@@ -15,6 +15,7 @@
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/store.hpp"
 
+class btree_bulk_loader_t;
 class btree_slice_t;
 enum class delete_mode_t;
 class deletion_context_t;
@@ -111,6 +112,11 @@ struct btree_point_replacer_t {
     virtual return_changes_t should_return_changes() const = 0;
 };
 
+/* `rdb_batched_replace()` applies the replaces in ascending key order rather than in the
+order of `keys`. Rows that go into the same leaf of the primary B-tree are replaced one
+after another under a single descent and acquisition of the leaf, see
+`count_keys_for_leaf()`. The secondary index updates still happen row by row. The stats,
+including `changes` and `first_error`, are still merged in the order of `keys`. */
 batched_replace_response_t rdb_batched_replace(
     const btree_info_t &info,
     scoped_ptr_t<real_superblock_t> *superblock,
@@ -121,6 +127,33 @@ batched_replace_response_t rdb_batched_replace(
     profile::sampler_t *sampler,
     profile::trace_t *trace);
 
+/* `rdb_bulk_insert()` is a faster variant of `rdb_batched_replace()` for batches of new
+rows with distinct keys that are all greater than every key in the B-tree, which is what
+`insert()` with the `presorted` optarg promises. The rows are sorted by key first. Every
+row is replaced starting from a missing row, and the results are appended through a
+`btree_bulk_loader_t` instead of being inserted one at a time. If the batch doesn't
+qualify after all, or if there are `order_by.limit` changefeeds on the affected range,
+it falls back to `rdb_batched_replace()`. The store also uses it for ordinary inserts
+that look like appends according to `btree_slice_t::might_be_append()`. */
+batched_replace_response_t rdb_bulk_insert(
+    const btree_info_t &info,
+    scoped_ptr_t<real_superblock_t> *superblock,
+    const std::vector<store_key_t> &keys,
+    const btree_batched_replacer_t *replacer,
+    rdb_modification_report_cb_t *sindex_cb,
+    ql::configured_limits_t limits,
+    profile::sampler_t *sampler,
+    profile::trace_t *trace);
+
+/* Appends `data`, already serialized into `wm`, to `loader` under `key`, and fills in
+the `added` half of `mod_info_out`. */
+void rdb_bulk_append(btree_bulk_loader_t *loader,
+                     const store_key_t &key,
+                     const ql::datum_t &data,
+                     const write_message_t &wm,
+                     repli_timestamp_t timestamp,
+                     rdb_modification_info_t *mod_info_out);
+
 void rdb_set(const store_key_t &key, ql::datum_t data,
              bool overwrite,
              btree_slice_t *slice, repli_timestamp_t timestamp,
@@ -140,6 +173,15 @@ void rdb_delete(const store_key_t &key, btree_slice_t *slice, repli_timestamp_t
                 profile::trace_t *trace,
                 promise_t<superblock_t *> *pass_back_superblock = nullptr);
 
+/* `rdb_rget_slice()` splits range reads that end in a terminal other than a limit into
+sub-ranges and traverses those concurrently, if every sub-range would have at least
+`rget_subrange_min_rows` rows. Unit tests lower it to split small B-trees. */
+extern int64_t rget_subrange_min_rows;
+
+std::vector<key_range_t> split_rget_range(superblock_t *superblock,
+                                          const key_range_t &range,
+                                          size_t max_subranges);
+
 void rdb_rget_slice(
     btree_slice_t *slice,
     const region_t &shard,
@@ -154,6 +196,9 @@ void rdb_rget_slice(
     rget_read_response_t *response,
     release_superblock_t release_superblock);
 
+/* The rows of a reference index are looked up in the primary B-tree, which is
+`primary_slice` and `primary_superblock`. They must be `nullptr` for other indexes.
+`primary_superblock` is never released. */
 void rdb_rget_secondary_slice(
     btree_slice_t *slice,
     const region_t &shard,
@@ -168,6 +213,8 @@ void rdb_rget_secondary_slice(
     sorting_t sorting,
     require_sindexes_t require_sindex_val,
     const sindex_disk_info_t &sindex_info,
+    btree_slice_t *primary_slice,
+    superblock_t *primary_superblock,
     rget_read_response_t *response,
     release_superblock_t release_superblock);
 
@@ -198,9 +245,37 @@ void rdb_get_nearest_slice(
     const sindex_disk_info_t &sindex_info,
     nearest_geo_read_response_t *response);
 
+/* Answers `group(index=...).count()` from the entries of an aggregate index. */
+void rdb_read_aggregate_sindex(
+    sindex_superblock_t *superblock,
+    const ql::datumspec_t &datumspec,
+    const key_range_t &sindex_range,
+    rget_read_response_t *response,
+    release_superblock_t release_superblock);
+
+/* Produces the same result as `rdb_read_aggregate_sindex()` by evaluating the index
+function on the rows in `pk_range`. The entries of an aggregate index count the rows of
+the whole store, so this is used for reads that only cover part of it. */
+void rdb_scan_aggregate_sindex(
+    real_superblock_t *superblock,
+    const key_range_t &pk_range,
+    const ql::datumspec_t &datumspec,
+    const sindex_disk_info_t &sindex_info,
+    rget_read_response_t *response,
+    release_superblock_t release_superblock);
+
+/* Returns whether the change log index has every change in `sindex_range`, i.e. none of
+them expired or happened while the log had a gap. Reads that start at the beginning of
+the log are always covered. */
+bool rdb_change_log_covers(
+    sindex_superblock_t *superblock,
+    const key_range_t &sindex_range,
+    const sindex_disk_info_t &sindex_info);
+
+/* `superblock` may be the superblock of the primary B-tree or of a secondary index. */
 void rdb_distribution_get(int max_depth,
                           const store_key_t &left_key,
-                          real_superblock_t *superblock,
+                          superblock_t *superblock,
                           distribution_read_response_t *response);
 
 /* Secondary Indexes */
@@ -262,13 +337,22 @@ struct sindex_disk_info_t {
     sindex_disk_info_t(const ql::map_wire_func_t &_mapping,
                        const sindex_reql_version_info_t &_mapping_version_info,
                        sindex_multi_bool_t _multi,
-                       sindex_geo_bool_t _geo) :
+                       sindex_geo_bool_t _geo,
+                       sindex_aggregate_bool_t _aggregate,
+                       sindex_reference_bool_t _reference,
+                       const boost::optional<ql::map_wire_func_t> &_filter,
+                       uint64_t _change_log_size) :
         mapping(_mapping), mapping_version_info(_mapping_version_info),
-        multi(_multi), geo(_geo) { }
+        multi(_multi), geo(_geo), aggregate(_aggregate), reference(_reference),
+        filter(_filter), change_log_size(_change_log_size) { }
     ql::map_wire_func_t mapping;
     sindex_reql_version_info_t mapping_version_info;
     sindex_multi_bool_t multi;
     sindex_geo_bool_t geo;
+    sindex_aggregate_bool_t aggregate;
+    sindex_reference_bool_t reference;
+    boost::optional<ql::map_wire_func_t> filter;
+    uint64_t change_log_size;
 };
 
 void serialize_sindex_info(write_message_t *wm,
@@ -296,6 +380,7 @@ public:
     rdb_modification_report_cb_t(
             store_t *store,
             buf_lock_t *sindex_block,
+            repli_timestamp_t timestamp,
             auto_drainer_t::lock_t lock);
     ~rdb_modification_report_cb_t();
 
@@ -322,6 +407,7 @@ private:
     auto_drainer_t::lock_t lock_;
     store_t *store_;
     buf_lock_t *sindex_block_;
+    repli_timestamp_t timestamp_;
 
     /* Fields initialized by calls to on_mod_report */
     store_t::sindex_access_vector_t sindexes_;
@@ -331,20 +417,27 @@ void rdb_update_sindexes(
     store_t *store,
     const store_t::sindex_access_vector_t &sindexes,
     const rdb_modification_report_t *modification,
+    repli_timestamp_t timestamp,
     txn_t *txn,
     const deletion_context_t *deletion_context,
     cond_t *keys_available_cond,
     index_vals_t *old_keys_out,
     index_vals_t *new_keys_out);
 
+/* If one of the indexes is an aggregate index, the rows that the traversal counted are
+stored in `counted_rows_out` by primary key (which may be `nullptr`). */
 void post_construct_secondary_index_range(
         store_t *store,
         const std::set<uuid_u> &sindexes_to_post_construct,
         key_range_t *construction_range_inout,
         const std::function<bool(int64_t)> &check_should_abort,
+        std::map<store_key_t, ql::datum_t> *counted_rows_out,
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t);
 
+/* Returns whether one of `sindexes` is an aggregate index. */
+bool has_aggregate_sindex(const store_t::sindex_access_vector_t &sindexes);
+
 /* This deleter actually deletes the value and all associated blocks. */
 class rdb_value_deleter_t : public value_deleter_t {
 public:
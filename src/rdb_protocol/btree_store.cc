@@ -91,6 +91,17 @@ store_t::store_t(const region_t &_region,
       perfmon_collection(),
       io_backender_(io_backender), base_path_(base_path),
       perfmon_collection_membership(parent_perfmon_collection, &perfmon_collection, perfmon_name),
+      changefeed_batch_size(secs_to_ticks(1), false),
+      changefeed_batch_size_membership(
+          &perfmon_collection, &changefeed_batch_size, "changefeed_batch_size"),
+      changefeed_limit_reads(secs_to_ticks(1)),
+      changefeed_limit_reads_membership(
+          &perfmon_collection, &changefeed_limit_reads, "changefeed_limit_reads"),
+      changefeed_limit_spare_hits(secs_to_ticks(1)),
+      changefeed_limit_spare_hits_membership(
+          &perfmon_collection,
+          &changefeed_limit_spare_hits,
+          "changefeed_limit_spare_hits"),
       ctx(_ctx),
       table_id(_table_id),
       write_superblock_acq_semaphore(WRITE_SUPERBLOCK_ACQ_WAITERS_LIMIT)
@@ -293,7 +304,8 @@ void store_t::reset_data(
 
         superblock.reset();
         if (!mod_reports.empty()) {
-            update_sindexes(txn.get(), &sindex_block, mod_reports, true);
+            update_sindexes(txn.get(), &sindex_block, mod_reports,
+                            repli_timestamp_t::distant_past, true);
         }
 
         sindex_block.reset_buf_lock();
@@ -335,6 +347,10 @@ std::map<std::string, std::pair<sindex_config_t, sindex_status_t> > store_t::sin
         res->first.func_version = disk_info.mapping_version_info.original_reql_version;
         res->first.multi = disk_info.multi;
         res->first.geo = disk_info.geo;
+        res->first.aggregate = disk_info.aggregate;
+        res->first.reference = disk_info.reference;
+        res->first.filter = disk_info.filter;
+        res->first.change_log_size = disk_info.change_log_size;
 
         res->second.outdated =
             (disk_info.mapping_version_info.latest_compatible_reql_version !=
@@ -350,6 +366,7 @@ std::map<std::string, std::pair<sindex_config_t, sindex_status_t> > store_t::sin
             res->second.ready = false;
             res->second.progress_numerator = get_sindex_progress(pair.second.id);
             res->second.progress_denominator = 1.0;
+            res->second.ranges_progress = get_sindex_ranges_progress(pair.second.id);
             res->second.start_time = get_sindex_start_time(pair.second.id);
         }
     }
@@ -381,7 +398,9 @@ void store_t::sindex_create(
     version_info.original_reql_version = config.func_version;
     version_info.latest_compatible_reql_version = config.func_version;
     version_info.latest_checked_reql_version = reql_version_t::LATEST;
-    sindex_disk_info_t info(config.func, version_info, config.multi, config.geo);
+    sindex_disk_info_t info(config.func, version_info, config.multi, config.geo,
+                            config.aggregate, config.reference, config.filter,
+                            config.change_log_size);
 
     write_message_t wm;
     serialize_sindex_info(&wm, info);
@@ -549,6 +568,7 @@ void store_t::update_sindexes(
             txn_t *txn,
             buf_lock_t *sindex_block,
             const std::vector<rdb_modification_report_t> &mod_reports,
+            repli_timestamp_t timestamp,
             bool release_sindex_block) {
     new_mutex_in_line_t acq = get_in_line_for_sindex_queue(sindex_block);
     {
@@ -563,6 +583,7 @@ void store_t::update_sindexes(
             rdb_update_sindexes(this,
                                 sindexes,
                                 &mod_reports[i],
+                                timestamp,
                                 txn,
                                 &deletion_context,
                                 NULL,
@@ -608,7 +629,16 @@ double store_t::get_sindex_progress(uuid_u const &id) {
     if (iterator == sindex_context.end()) {
         return 0.0;
     } else {
-        return *iterator->second.second;
+        return iterator->second.second->total;
+    }
+}
+
+std::vector<double> store_t::get_sindex_ranges_progress(uuid_u const &id) {
+    auto iterator = sindex_context.find(id);
+    if (iterator == sindex_context.end()) {
+        return std::vector<double>();
+    } else {
+        return iterator->second.second->ranges;
     }
 }
 
@@ -1019,7 +1049,8 @@ MUST_USE bool store_t::acquire_sindex_superblock_for_read(
         real_superblock_t *superblock,
         scoped_ptr_t<sindex_superblock_t> *sindex_sb_out,
         std::vector<char> *opaque_definition_out,
-        uuid_u *sindex_uuid_out)
+        uuid_u *sindex_uuid_out,
+        release_superblock_t release_superblock)
     THROWS_ONLY(sindex_not_ready_exc_t) {
     assert_thread();
     rassert(opaque_definition_out != NULL);
@@ -1028,7 +1059,9 @@ MUST_USE bool store_t::acquire_sindex_superblock_for_read(
     /* Acquire the sindex block. */
     buf_lock_t sindex_block(superblock->expose_buf(), superblock->get_sindex_block_id(),
                             access_t::read);
-    superblock->release();
+    if (release_superblock == release_superblock_t::RELEASE) {
+        superblock->release();
+    }
 
     /* Figure out what the superblock for this index is. */
     secondary_index_t sindex;
@@ -1,6 +1,8 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "rdb_protocol/changefeed.hpp"
 
+#include <algorithm>
+#include <memory>
 #include <queue>
 
 #include "boost_utils.hpp"
@@ -10,6 +12,7 @@
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/interruptor.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "rdb_protocol/artificial_table/backend.hpp"
 #include "rdb_protocol/btree.hpp"
 #include "rdb_protocol/env.hpp"
@@ -316,7 +319,8 @@ boost::optional<datum_t> apply_ops(
 
 server_t::client_info_t::client_info_t()
     : limit_clients(&opt_lt<std::string>),
-      limit_clients_lock(new rwlock_t()) { }
+      limit_clients_lock(new rwlock_t()),
+      all_keys(false) { }
 
 server_t::server_t(mailbox_manager_t *_manager, store_t *_parent)
     : uuid(generate_uuid()),
@@ -324,6 +328,8 @@ server_t::server_t(mailbox_manager_t *_manager, store_t *_parent)
       parent(_parent),
       stop_mailbox(manager,
                    std::bind(&server_t::stop_mailbox_cb, this, ph::_1, ph::_2)),
+      point_stop_mailbox(manager, std::bind(&server_t::point_stop_mailbox_cb,
+                                            this, ph::_1, ph::_2, ph::_3, ph::_4)),
       limit_stop_mailbox(manager, std::bind(&server_t::limit_stop_mailbox_cb,
                                             this, ph::_1, ph::_2, ph::_3, ph::_4)) { }
 
@@ -342,6 +348,29 @@ void server_t::stop_mailbox_cb(signal_t *, client_t::addr_t addr) {
     }
 }
 
+void server_t::point_stop_mailbox_cb(signal_t *,
+                                     client_t::addr_t addr,
+                                     store_key_t key,
+                                     uuid_u sub_id) {
+    auto_drainer_t::lock_t lock(&drainer);
+    rwlock_in_line_t spot(&clients_lock, access_t::read);
+    spot.read_signal()->wait_lazily_unordered();
+    auto it = clients.find(addr);
+    if (it != clients.end()) {
+        ASSERT_NO_CORO_WAITING;
+        // Clients send this to all of their servers, only one of them has the key.
+        // It may not have the changefeed either, if the client's stamp read never
+        // got here.
+        auto key_it = it->second.point_keys.find(key_to_unescaped_str(key));
+        if (key_it != it->second.point_keys.end()) {
+            key_it->second.erase(sub_id);
+            if (key_it->second.empty()) {
+                it->second.point_keys.erase(key_it);
+            }
+        }
+    }
+}
+
 void server_t::limit_stop_mailbox_cb(signal_t *,
                                      client_t::addr_t addr,
                                      boost::optional<std::string> sindex,
@@ -394,6 +423,10 @@ void server_t::limit_stop_mailbox_cb(signal_t *,
 void server_t::add_client(
         const client_t::addr_t &addr,
         region_t region,
+        rdb_context_t *ctx,
+        global_optargs_t optargs,
+        auth::user_context_t user_context,
+        const std::vector<transform_variant_t> &transforms,
         const auto_drainer_t::lock_t &keepalive) {
     keepalive.assert_is_holding(&drainer);
     rwlock_in_line_t spot(&clients_lock, access_t::write);
@@ -410,6 +443,21 @@ void server_t::add_client(
     // that's fine.
     if (!info->cond.has()) {
         info->stamp = 0;
+        if (!transforms.empty()) {
+            // The final `nullptr` argument means we don't profile any work done
+            // with this `env`.
+            info->env = make_scoped<env_t>(
+                ctx,
+                return_empty_normal_batches_t::NO,
+                drainer.get_drain_signal(),
+                std::move(optargs),
+                std::move(user_context),
+                datum_t(),
+                nullptr);
+            for (const auto &transform : transforms) {
+                info->ops.push_back(make_op(transform));
+            }
+        }
         cond_t *stopped = new cond_t();
         info->cond.init(stopped);
         // Passing the raw pointer `stopped` is safe because `add_client_cb` is
@@ -492,18 +540,72 @@ void server_t::add_client_cb(
     guarantee(erased == 1);
 }
 
-struct stamped_msg_t {
-    stamped_msg_t() { }
-    stamped_msg_t(uuid_u _server_uuid, uint64_t _stamp, msg_t _submsg)
-        : server_uuid(std::move(_server_uuid)),
-          stamp(_stamp),
-          submsg(std::move(_submsg)) { }
-    uuid_u server_uuid;
-    uint64_t stamp;
-    msg_t submsg;
-};
+template <cluster_version_t W>
+void serialize(write_message_t *wm, const stamped_msg_t &msg) {
+    serialize<W>(wm, msg.server_uuid);
+    serialize<W>(wm, msg.stamp);
+    if (!msg.serialized_submsgs.empty()) {
+        // `send_all()` serializes for the cluster, which is the only place we send to.
+        static_assert(W == cluster_version_t::CLUSTER,
+                      "stamped_msg_t is only sent over the cluster.");
+        rassert(msg.submsgs.empty());
+        // This matches the serialization of `std::vector<msg_t>`.
+        serialize_varint_uint64(wm, msg.serialized_submsgs.size());
+        for (const auto &submsg : msg.serialized_submsgs) {
+            wm->append(submsg->data(), submsg->size());
+        }
+    } else {
+        serialize<W>(wm, msg.submsgs);
+    }
+}
+
+template <cluster_version_t W>
+archive_result_t deserialize(read_stream_t *s, stamped_msg_t *msg) {
+    archive_result_t res = deserialize<W>(s, &msg->server_uuid);
+    if (bad(res)) { return res; }
+    res = deserialize<W>(s, &msg->stamp);
+    if (bad(res)) { return res; }
+    return deserialize<W>(s, &msg->submsgs);
+}
+
+INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(stamped_msg_t);
+
+// Returns `boost::none` if neither the old nor the new value makes it through
+// the transforms.
+boost::optional<msg_t::change_t> apply_ops_to_change(
+        const msg_t::change_t &change,
+        const std::vector<scoped_ptr_t<op_t> > &ops,
+        env_t *env) {
+    msg_t::change_t ret;
+    if (change.old_val.has()) {
+        boost::optional<datum_t> d = apply_ops(change.old_val, ops, env, datum_t());
+        if (d) {
+            ret.old_val = *d;
+        }
+    }
+    if (change.new_val.has()) {
+        boost::optional<datum_t> d = apply_ops(change.new_val, ops, env, datum_t());
+        if (d) {
+            ret.new_val = *d;
+        }
+    }
+    if (!ret.old_val.has() && !ret.new_val.has()) {
+        return boost::none;
+    }
+    ret.old_indexes = change.old_indexes;
+    ret.new_indexes = change.new_indexes;
+    ret.pkey = change.pkey;
+    return ret;
+}
 
-RDB_MAKE_SERIALIZABLE_3(stamped_msg_t, server_uuid, stamp, submsg);
+std::shared_ptr<const std::vector<char> > serialize_for_batch(const msg_t &msg) {
+    write_message_t wm;
+    serialize<cluster_version_t::CLUSTER>(&wm, msg);
+    vector_stream_t stream;
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    return std::make_shared<const std::vector<char> >(stream.vector());
+}
 
 // This function takes a `lock_t` to make sure you have one.  (We can't just
 // always acquire a drainer lock before sending because we sometimes send a
@@ -514,14 +616,16 @@ void server_t::send_one_with_lock(
         msg_t msg,
         const auto_drainer_t::lock_t &keepalive) {
     keepalive.assert_is_holding(&drainer);
-    uint64_t stamp;
     {
         // We don't need a write lock as long as we make sure the coroutine
         // doesn't block between reading and updating the stamp.
         ASSERT_NO_CORO_WAITING;
-        stamp = client->second.stamp++;
+        uint64_t stamp = client->second.stamp++;
+        // The message goes at the end of any batch that's waiting to be sent, so
+        // it can't overtake the changes before it.
+        add_to_batch(client->first, stamp, serialize_for_batch(msg), keepalive);
     }
-    send(manager, client->first, stamped_msg_t(uuid, stamp, std::move(msg)));
+    send_batch(client->first, keepalive);
 }
 
 void server_t::send_all(
@@ -531,31 +635,146 @@ void server_t::send_all(
         const auto_drainer_t::lock_t &keepalive) {
     keepalive.assert_is_holding(&drainer);
     stamp_spot->guarantee_is_for_lock(&parent->cfeed_stamp_lock);
-    stamp_spot->write_signal()->wait_lazily_unordered();
 
+    // Clients with transforms get their own version of the change, or nothing if
+    // it doesn't make it through the transforms.  Evaluating the transforms can
+    // yield, so we do it before we wait for the stamp lock, which holds up the
+    // other writes to the store.  We can't tell yet which clients will have
+    // taken a stamp by the time we get the lock, so we do it for every client
+    // with transforms in whose regions the change is.
+    std::map<client_t::addr_t, std::shared_ptr<const std::vector<char> > >
+        transformed_msgs;
+    const msg_t::change_t *change = boost::get<msg_t::change_t>(&msg.op);
+    {
+        rwlock_acq_t acq(&clients_lock, access_t::read);
+        for (auto &&pair : clients) {
+            if (pair.second.ops.empty()
+                || !std::any_of(pair.second.regions.begin(),
+                                pair.second.regions.end(),
+                                std::bind(&region_contains_key,
+                                          ph::_1, std::cref(key)))) {
+                continue;
+            }
+            guarantee(change != nullptr);
+            std::shared_ptr<const std::vector<char> > transformed;
+            if (boost::optional<msg_t::change_t> c = apply_ops_to_change(
+                    *change, pair.second.ops, pair.second.env.get())) {
+                transformed = serialize_for_batch(msg_t(std::move(*c)));
+            }
+            transformed_msgs[pair.first] = std::move(transformed);
+        }
+    }
+
+    stamp_spot->write_signal()->wait_lazily_unordered();
     rwlock_acq_t acq(&clients_lock, access_t::read);
-    std::map<client_t::addr_t, uint64_t> stamps;
+    const std::string key_str = key_to_unescaped_str(key);
+    // Only the stamps differ between the other clients, so we serialize the
+    // message for them once.
+    std::shared_ptr<const std::vector<char> > serialized_msg;
+    std::vector<client_t::addr_t> full_batches;
     for (auto &&pair : clients) {
         // We don't need a write lock as long as we make sure the coroutine
         // doesn't block between reading and updating the stamp.
         ASSERT_NO_CORO_WAITING;
-        if (std::any_of(pair.second.regions.begin(),
-                        pair.second.regions.end(),
-                        std::bind(&region_contains_key, ph::_1, std::cref(key)))) {
-            stamps[pair.first] = pair.second.stamp++;
+        if (wants_change(pair.second, key, key_str)) {
+            std::shared_ptr<const std::vector<char> > to_send;
+            if (pair.second.ops.empty()) {
+                if (!serialized_msg) {
+                    serialized_msg = serialize_for_batch(msg);
+                }
+                to_send = serialized_msg;
+            } else {
+                // A client that was added after we evaluated the transforms
+                // can't want the change, because it can only take a stamp
+                // after we're done stamping.
+                auto it = transformed_msgs.find(pair.first);
+                guarantee(it != transformed_msgs.end());
+                if (!it->second) {
+                    continue;
+                }
+                to_send = it->second;
+            }
+            if (add_to_batch(
+                    pair.first, pair.second.stamp++, std::move(to_send), keepalive)) {
+                full_batches.push_back(pair.first);
+            }
         }
     }
     acq.reset();
     stamp_spot->reset(); // Done stamping, no need to hold onto it while we send.
-    for (const auto &pair : stamps) {
-        send(manager, pair.first, stamped_msg_t(uuid, pair.second, msg));
+    for (const auto &addr : full_batches) {
+        send_batch(addr, keepalive);
+    }
+}
+
+bool server_t::wants_change(const client_info_t &info,
+                            const store_key_t &key,
+                            const std::string &key_str) {
+    if (!std::any_of(info.regions.begin(),
+                     info.regions.end(),
+                     std::bind(&region_contains_key, ph::_1, std::cref(key)))) {
+        return false;
     }
+    // This is a hash lookup, so the cost doesn't grow with the number of point
+    // changefeeds.
+    return info.all_keys || info.point_keys.count(key_str) != 0;
+}
+
+bool server_t::add_to_batch(
+        const client_t::addr_t &addr,
+        uint64_t stamp,
+        std::shared_ptr<const std::vector<char> > serialized_msg,
+        const auto_drainer_t::lock_t &keepalive) {
+    keepalive.assert_is_holding(&drainer);
+    ASSERT_NO_CORO_WAITING;
+    batch_t *batch = &batches[addr];
+    if (batch->serialized_msgs.empty()) {
+        batch->first_stamp = stamp;
+        coro_t::spawn_sometime(
+            std::bind(&server_t::send_batch_cb, this, addr, keepalive));
+    }
+    guarantee(batch->first_stamp + batch->serialized_msgs.size() == stamp);
+    batch->serialized_msgs.push_back(std::move(serialized_msg));
+    return batch->serialized_msgs.size() >= MAX_BATCH_SIZE;
+}
+
+void server_t::send_batch(
+        const client_t::addr_t &addr,
+        const auto_drainer_t::lock_t &keepalive) {
+    keepalive.assert_is_holding(&drainer);
+    stamped_msg_t msg;
+    {
+        ASSERT_NO_CORO_WAITING;
+        auto it = batches.find(addr);
+        // Someone else might have sent the batch already.
+        if (it == batches.end()) {
+            return;
+        }
+        parent->changefeed_batch_size.record(it->second.serialized_msgs.size());
+        msg = stamped_msg_t(
+            uuid, it->second.first_stamp, std::move(it->second.serialized_msgs));
+        batches.erase(it);
+    }
+    // Batches can overtake each other while we block here, the clients put them
+    // back in order using the stamps.
+    send(manager, addr, msg);
+}
+
+void server_t::send_batch_cb(client_t::addr_t addr, auto_drainer_t::lock_t keepalive) {
+    // Let the other writes that are running right now add their changes to the
+    // batch first.
+    coro_t::yield();
+    send_batch(addr, keepalive);
 }
 
 server_t::addr_t server_t::get_stop_addr() {
     return stop_mailbox.get_address();
 }
 
+server_t::point_addr_t server_t::get_point_stop_addr() {
+    return point_stop_mailbox.get_address();
+}
+
 server_t::limit_addr_t server_t::get_limit_stop_addr() {
     return limit_stop_mailbox.get_address();
 }
@@ -570,6 +789,26 @@ boost::optional<uint64_t> server_t::get_stamp(
     if (it == clients.end()) {
         return boost::none;
     } else {
+        it->second.all_keys = true;
+        return it->second.stamp;
+    }
+}
+
+boost::optional<uint64_t> server_t::get_point_stamp(
+        const client_t::addr_t &addr,
+        const store_key_t &key,
+        const uuid_u &sub_id,
+        const auto_drainer_t::lock_t &keepalive) {
+    keepalive.assert_is_holding(&drainer);
+    rwlock_acq_t stamp_acq(&parent->cfeed_stamp_lock, access_t::read);
+    rwlock_acq_t client_acq(&clients_lock, access_t::read);
+    auto it = clients.find(addr);
+    if (it == clients.end()) {
+        return boost::none;
+    } else {
+        // We hold the stamp lock, so no change to `key` can slip in between
+        // the stamp and the subscription.
+        it->second.point_keys[key_to_unescaped_str(key)].insert(sub_id);
         return it->second.stamp;
     }
 }
@@ -847,6 +1086,13 @@ bool limit_order_t::operator()(const std::string &a, const std::string &b) const
     unreachable();
 }
 
+// How many rows past the top `n` a `limit_manager_t` keeps in memory.  We keep
+// about as many as the limit itself, but at least enough that a small limit
+// doesn't go to disk for every deletion, and not so many that a huge limit eats
+// all our memory.
+const size_t MIN_LIMIT_SPARE_ITEMS = 16;
+const size_t MAX_LIMIT_SPARE_ITEMS = 1000;
+
 void limit_manager_t::send(msg_t &&msg) {
     if (!parent->drainer.is_draining()) {
         auto_drainer_t::lock_t drain_lock(&parent->drainer);
@@ -879,6 +1125,9 @@ limit_manager_t::limit_manager_t(
       spec(std::move(_spec)),
       gt(std::move(_gt)),
       item_queue(gt),
+      spare(gt),
+      spare_limit(std::min(std::max(spec.limit, MIN_LIMIT_SPARE_ITEMS),
+                           MAX_LIMIT_SPARE_ITEMS)),
       aborted(false) {
     guarantee(clients_lock->read_signal()->is_pulsed());
 
@@ -950,6 +1199,7 @@ public:
                   const keyspec_t::limit_t *_spec,
                   sorting_t _sorting,
                   boost::optional<item_t> _start,
+                  size_t _n,
                   const item_queue_t *_item_queue)
         : env(_env),
           ops(_ops),
@@ -957,6 +1207,7 @@ public:
           spec(_spec),
           sorting(_sorting),
           start(std::move(_start)),
+          n(_n),
           item_queue(_item_queue) { }
 
     std::vector<item_t> operator()(const primary_ref_t &ref) {
@@ -980,7 +1231,6 @@ public:
         case sorting_t::UNORDERED: // fallthru
         default: unreachable();
         }
-        size_t n = spec->limit - item_queue->size();
         rdb_rget_slice(
             ref.btree,
             region_t(),
@@ -1035,7 +1285,7 @@ public:
                 [](const datum_range_t &) { return true; },
                 [](const std::map<datum_t, uint64_t> &) { return false; }));
         datum_range_t srange = spec->range.datumspec.covering_range();
-        size_t n = spec->limit - item_queue->size();
+        size_t to_read = n;
         if (start) {
             datum_t dstart = start->second.first;
             switch (sorting) {
@@ -1054,7 +1304,7 @@ public:
                 if (pair->second.first != dstart) {
                     break;
                 }
-                n += 1;
+                to_read += 1;
             }
         }
         reql_version_t reql_version =
@@ -1070,7 +1320,7 @@ public:
             std::vector<transform_variant_t>(),
             boost::optional<terminal_variant_t>(limit_read_t{
                     is_primary_t::NO,
-                    n,
+                    to_read,
                     // This code uses the same generic code path as a normal
                     // read, and a normal read needs to keep track of the
                     // region and last seen key for unsharding, but we
@@ -1084,6 +1334,8 @@ public:
             sorting,
             require_sindexes_t::NO,
             *ref.sindex_info,
+            nullptr,
+            nullptr,
             &resp,
             release_superblock_t::KEEP);
         auto *gs = boost::get<ql::grouped_t<ql::stream_t> >(&resp.result);
@@ -1098,7 +1350,7 @@ public:
         if (stream.substreams.size() == 1) {
             raw_stream_t *raw_stream = &stream.substreams.begin()->second.stream;
             item_vec = mangle_sort_truncate_stream(
-                std::move(*raw_stream), is_primary_t::NO, sorting, n);
+                std::move(*raw_stream), is_primary_t::NO, sorting, to_read);
         } else {
             guarantee(item_vec.size() == 0);
         }
@@ -1112,18 +1364,45 @@ private:
     const keyspec_t::limit_t *spec;
     sorting_t sorting;
     boost::optional<item_t> start;
+    size_t n;
     const item_queue_t *item_queue;
 };
 
 std::vector<item_t> limit_manager_t::read_more(
     const boost::variant<primary_ref_t, sindex_ref_t> &ref,
-    const boost::optional<item_t> &start) {
+    const boost::optional<item_t> &start,
+    size_t n) {
     guarantee(item_queue.size() < spec.limit);
+    guarantee(spare.size() == 0);
+    parent->parent->changefeed_limit_reads.record();
     ref_visitor_t visitor(
-        env.get(), &ops, &region.inner, &spec, spec.range.sorting, start, &item_queue);
+        env.get(),
+        &ops,
+        &region.inner,
+        &spec,
+        spec.range.sorting,
+        start,
+        n,
+        &item_queue);
     return boost::apply_visitor(visitor, ref);
 }
 
+void limit_manager_t::refill_from_spare(item_queue_t *real_added) {
+    while (item_queue.size() < spec.limit && spare.size() != 0) {
+        // The best spare row is at the end, since the queues are ordered worst
+        // first.
+        auto it = spare.end();
+        --it;
+        item_t item = **it;
+        spare.erase(it);
+        bool inserted = item_queue.insert(item).second;
+        guarantee(inserted);
+        inserted = real_added->insert(std::move(item)).second;
+        guarantee(inserted);
+        parent->parent->changefeed_limit_spare_hits.record();
+    }
+}
+
 void limit_manager_t::commit(
     rwlock_in_line_t *spot,
     const boost::variant<primary_ref_t, sindex_ref_t> &sindex_ref) THROWS_NOTHING {
@@ -1133,14 +1412,19 @@ void limit_manager_t::commit(
     }
 
     // Before we delete anything, we get the boundary between the active set and
-    // the data that didn't make it into the set.  Anything <= that according to
-    // our ordering could never be kicked out of the set because of a read from
-    // disk.
+    // the data that didn't make it into the set, and the boundary between the
+    // spare rows and the data that's only on disk.  Anything <= those according
+    // to our ordering could never be kicked out by a read from disk.
     boost::optional<item_t> active_boundary;
     auto item_queue_it = item_queue.begin();
     if (item_queue_it != item_queue.end()) {
         active_boundary = **item_queue_it;
     }
+    boost::optional<item_t> spare_boundary;
+    auto spare_it = spare.begin();
+    if (spare_it != spare.end()) {
+        spare_boundary = **spare_it;
+    }
 
     item_queue_t real_added(gt);
     std::set<std::string> real_deleted;
@@ -1149,6 +1433,9 @@ void limit_manager_t::commit(
         if (data_deleted) {
             bool inserted = real_deleted.insert(id).second;
             guarantee(inserted);
+        } else {
+            // It's fine if this isn't in `spare` either, see `del`.
+            UNUSED bool spare_deleted = spare.del_id(id);
         }
     }
     deleted.clear();
@@ -1165,29 +1452,53 @@ void limit_manager_t::commit(
             guarantee(inserted);
             inserted = real_added.insert(pair).second;
             guarantee(inserted);
+        } else if (spare_boundary && !gt(item_t(pair), *spare_boundary)) {
+            // Same logic as above, but for the rows right after the active set.
+            bool inserted = spare.insert(pair).second;
+            guarantee(inserted);
         } else {
             added_on_disk = true;
         }
     }
     added.clear();
 
-    std::vector<std::string> truncated = item_queue.truncate_top(spec.limit);
-    for (auto &&id : truncated) {
-        auto it = real_added.find_id(id);
-        if (it != real_added.end()) {
-            real_added.erase(it);
+    // Rows that get kicked out of the active set are still better than
+    // anything in `spare`, so we hold on to them in case they're needed again.
+    while (item_queue.size() > spec.limit) {
+        auto it = item_queue.begin();
+        item_t item = **it;
+        item_queue.erase(it);
+        auto added_it = real_added.find_id(item.first);
+        if (added_it != real_added.end()) {
+            real_added.erase(added_it);
         } else {
-            bool inserted = real_deleted.insert(std::move(id)).second;
+            bool inserted = real_deleted.insert(item.first).second;
             guarantee(inserted);
         }
+        bool inserted = spare.insert(std::move(item)).second;
+        guarantee(inserted);
     }
+    UNUSED std::vector<std::string> spare_trunc = spare.truncate_top(spare_limit);
+
+    refill_from_spare(&real_added);
 
+    // If we ran out of spare rows the rest of the set is on disk.  We read
+    // enough to fill the set and the spare rows in one go, starting after the
+    // worst row left in the set.  (We can't start after `spare_boundary`
+    // because some of the rows before it might have been truncated out of
+    // `spare` above.)
     bool anything_on_disk = real_deleted.size() != 0 || added_on_disk;
     if (item_queue.size() < spec.limit && anything_on_disk) {
+        guarantee(spare.size() == 0);
+        boost::optional<item_t> start;
+        if (item_queue.size() != 0) {
+            start = **item_queue.begin();
+        }
         std::vector<item_t> s;
         boost::optional<exc_t> exc;
         try {
-            s = read_more(sindex_ref, active_boundary);
+            s = read_more(
+                sindex_ref, start, spec.limit - item_queue.size() + spare_limit);
         } catch (const exc_t &e) {
             exc = e;
         }
@@ -1198,25 +1509,16 @@ void limit_manager_t::commit(
             return;
         }
         for (auto &&pair : s) {
-            bool inserted = item_queue.insert(pair).second;
             // Reading duplicates from disk is fine.
-            if (inserted) {
-                bool added_insert = real_added.insert(pair).second;
-                guarantee(added_insert);
-            }
-        }
-        // We need to truncate again because `read_more` may read too much in
-        // the secondary index case.
-        std::vector<std::string> read_trunc = item_queue.truncate_top(spec.limit);
-        for (auto &&id : read_trunc) {
-            auto it = real_added.find_id(id);
-            if (it != real_added.end()) {
-                real_added.erase(it);
-            } else {
-                bool inserted = real_deleted.insert(std::move(id)).second;
+            if (item_queue.find_id(pair.first) == item_queue.end()) {
+                bool inserted = spare.insert(pair).second;
                 guarantee(inserted);
             }
         }
+        refill_from_spare(&real_added);
+        // We need to truncate because `read_more` may read too much in the
+        // secondary index case.
+        spare_trunc = spare.truncate_top(spare_limit);
     }
     std::set<std::string> remaining_deleted;
     for (auto &&id : real_deleted) {
@@ -1617,7 +1919,11 @@ public:
     virtual ~feed_t();
 
     void add_point_sub(point_sub_t *sub, const store_key_t &key) THROWS_NOTHING;
-    void del_point_sub(point_sub_t *sub, const store_key_t &key) THROWS_NOTHING;
+    // `stamp_id` is set if the sub sent a read for a point stamp for `key` under
+    // that id, whether or not the read made it to the shard.
+    void del_point_sub(point_sub_t *sub,
+                       const store_key_t &key,
+                       const boost::optional<uuid_u> &stamp_id) THROWS_NOTHING;
 
     void add_range_sub(range_sub_t *sub) THROWS_NOTHING;
     void del_range_sub(range_sub_t *sub) THROWS_NOTHING;
@@ -1644,6 +1950,9 @@ public:
     bool can_be_removed();
 
     virtual void abort_feed() = 0;
+    // True if the shards have already applied the transforms of the range subs
+    // to the changes we get.
+    virtual bool shards_apply_transforms() const { return false; }
     void stop_subs(const auto_drainer_t::lock_t &lock);
     void mark_detached() { detached = true; }
 
@@ -1663,6 +1972,9 @@ protected:
 private:
     virtual void maybe_remove_feed() = 0;
     virtual void stop_limit_sub(limit_sub_t *sub) = 0;
+    // Tells the shard that the point changefeed `sub_id` no longer needs the
+    // changes to `key`.
+    virtual void forget_point_key(const store_key_t &, const uuid_u &) { }
 
     void add_sub_with_lock(
         rwlock_t *rwlock, const std::function<void()> &f) THROWS_NOTHING;
@@ -1689,7 +2001,10 @@ private:
         rwlock_in_line_t *spot,
         const std::function<void(limit_sub_t *)> &f) THROWS_NOTHING;
 
-    std::map<store_key_t, std::vector<std::set<point_sub_t *> > > point_subs;
+    // Point subs are looked up by the (unescaped) primary key they watch.  Almost
+    // every key has a single sub, so unlike the other subs they aren't split up
+    // by thread until a change comes in.
+    std::unordered_map<std::string, std::vector<point_sub_t *> > point_subs;
     rwlock_t point_subs_lock;
     std::vector<std::set<empty_sub_t *> > empty_subs;
     rwlock_t empty_subs_lock;
@@ -1737,27 +2052,33 @@ public:
                 client_t *client,
                 mailbox_manager_t *manager,
                 namespace_interface_t *ns_if,
-                namespace_id_t const &table_id,
+                client_t::feed_key_t key,
+                std::vector<transform_variant_t> shard_transforms,
+                serializable_env_t s_env,
                 signal_t *interruptor,
                 lifetime_t<name_resolver_t const &> name_resolver);
     ~real_feed_t();
 
     client_t::addr_t get_addr() const;
+    const client_t::feed_key_t &get_key() const { return key; }
     void abort_feed() final { aborted.pulse_if_not_already_pulsed(); }
+    bool shards_apply_transforms() const final { return !key.second.empty(); }
     virtual auto_drainer_t::lock_t get_drainer_lock() { return drainer.lock(); }
 private:
-    virtual void maybe_remove_feed() { client->maybe_remove_feed(client_lock, table_id); }
+    virtual void maybe_remove_feed() { client->maybe_remove_feed(client_lock, key); }
     virtual void stop_limit_sub(limit_sub_t *sub);
+    virtual void forget_point_key(const store_key_t &key, const uuid_u &sub_id);
 
     void mailbox_cb(signal_t *interruptor, stamped_msg_t msg);
     void constructor_cb();
 
     auto_drainer_t::lock_t client_lock;
     client_t *client;
-    namespace_id_t table_id;
+    client_t::feed_key_t key;
     mailbox_manager_t *manager;
     mailbox_t<void(stamped_msg_t)> mailbox;
     std::vector<server_t::addr_t> stop_addrs;
+    std::vector<server_t::point_addr_t> point_stop_addrs;
     std::vector<scoped_ptr_t<disconnect_watcher_t> > disconnect_watchers;
 
     struct queue_t {
@@ -1787,17 +2108,21 @@ real_feed_t::real_feed_t(auto_drainer_t::lock_t _client_lock,
                          client_t *_client,
                          mailbox_manager_t *_manager,
                          namespace_interface_t *ns_if,
-                         namespace_id_t const &_table_id,
+                         client_t::feed_key_t _key,
+                         std::vector<transform_variant_t> shard_transforms,
+                         serializable_env_t s_env,
                          signal_t *interruptor,
                          lifetime_t<name_resolver_t const &> _name_resolver)
-    : feed_t(_table_id, _name_resolver),
+    : feed_t(_key.first, _name_resolver),
       client_lock(std::move(_client_lock)),
       client(_client),
-      table_id(_table_id),
+      key(std::move(_key)),
       manager(_manager),
       mailbox(manager, std::bind(&real_feed_t::mailbox_cb, this, ph::_1, ph::_2)) {
     try {
-        read_t read(changefeed_subscribe_t(mailbox.get_address()),
+        read_t read(changefeed_subscribe_t(mailbox.get_address(),
+                                           std::move(shard_transforms),
+                                           std::move(s_env)),
                     profile_bool_t::DONT_PROFILE, read_mode_t::SINGLE);
         read_response_t read_resp;
         ns_if->read(
@@ -1813,6 +2138,7 @@ real_feed_t::real_feed_t(auto_drainer_t::lock_t _client_lock,
         for (auto it = resp->addrs.begin(); it != resp->addrs.end(); ++it) {
             stop_addrs.push_back(std::move(*it));
         }
+        point_stop_addrs.assign(resp->point_addrs.begin(), resp->point_addrs.end());
 
         std::set<peer_id_t> peers;
         for (auto it = stop_addrs.begin(); it != stop_addrs.end(); ++it) {
@@ -1863,6 +2189,14 @@ client_t::addr_t real_feed_t::get_addr() const {
     return mailbox.get_address();
 }
 
+void real_feed_t::forget_point_key(const store_key_t &pkey, const uuid_u &sub_id) {
+    // Only the server whose region contains `pkey` knows about it, the others
+    // ignore the message.
+    for (const auto &addr : point_stop_addrs) {
+        send(manager, addr, mailbox.get_address(), pkey, sub_id);
+    }
+}
+
 void real_feed_t::constructor_cb() {
     auto lock = make_scoped<auto_drainer_t::lock_t>(&drainer);
     {
@@ -2006,7 +2340,7 @@ public:
     }
     virtual ~point_sub_t() {
         destructor_cleanup(std::bind(&feed_t::del_point_sub, feed, this,
-                                     store_key_t(pkey.print_primary())));
+                                     store_key_t(pkey.print_primary()), stamp_id));
     }
     feed_type_t cfeed_type() const final { return feed_type_t::point; }
 
@@ -2068,10 +2402,14 @@ public:
             state = state_t::READY;
         }
 
+        // If the read is interrupted we can't tell whether the shard saw it, so
+        // we tell the shard to forget the key either way once we go away.
+        stamp_id = generate_uuid();
         read_response_t read_resp;
         nif->read(
             env->get_user_context(),
-            read_t(changefeed_point_stamp_t{addr, store_key_t(pkey.print_primary())},
+            read_t(changefeed_point_stamp_t{
+                       addr, store_key_t(pkey.print_primary()), *stamp_id},
                    profile_bool_t::DONT_PROFILE, read_mode_t::SINGLE),
             &read_resp,
             order_token_t::ignore,
@@ -2148,6 +2486,8 @@ private:
     boost::optional<change_val_t> initial_val;
     uint64_t stamp;
     bool started;
+    // Set once we've sent the read for the point stamp, see `to_stream`.
+    boost::optional<uuid_u> stamp_id;
     state_t state, sent_state;
     bool include_initial;
 
@@ -2854,7 +3194,7 @@ public:
             datum_t new_val = null, old_val = null;
             if (!sub->active()) return;
             bool trivial = false;
-            if (sub->has_ops()) {
+            if (sub->has_ops() && !feed->shards_apply_transforms()) {
                 if (change.new_val.has()) {
                     if (boost::optional<datum_t> d = sub->apply_ops(change.new_val)) {
                         new_val = *d;
@@ -2879,6 +3219,10 @@ public:
                 if (change.old_val.has()) {
                     old_val = change.old_val;
                 }
+                if (sub->has_ops()) {
+                    // The shards applied the transforms, see above.
+                    trivial = (new_val == old_val);
+                }
             }
             ASSERT_NO_CORO_WAITING;
             boost::optional<std::string> sindex = sub->sindex();
@@ -3006,14 +3350,17 @@ void real_feed_t::mailbox_cb(signal_t *, stamped_msg_t msg) {
             guarantee(msg.stamp >= queue->next);
             queue->map.push(std::move(msg));
 
-            // Read as much as we can from the queue (this enforces ordering.)
+            // Read as many batches as we can from the queue (this enforces
+            // ordering.)
             while (queue->map.size() != 0 && queue->map.top().stamp == queue->next) {
-                if (detached) return;
                 const stamped_msg_t &curmsg = queue->map.top();
-                msg_visit(this, &lock,
-                          curmsg.server_uuid, curmsg.stamp, curmsg.submsg.op);
+                for (const auto &submsg : curmsg.submsgs) {
+                    if (detached) return;
+                    msg_visit(this, &lock,
+                              curmsg.server_uuid, queue->next, submsg.op);
+                    queue->next += 1;
+                }
                 queue->map.pop();
-                queue->next += 1;
             }
         }
     }
@@ -3516,14 +3863,31 @@ size_t map_del_sub(Map *map, const Key &key, Sub *sub) THROWS_NOTHING {
 // If this throws we might leak the increment to `num_subs`.
 void feed_t::add_point_sub(point_sub_t *sub, const store_key_t &key) THROWS_NOTHING {
     add_sub_with_lock(&point_subs_lock, [this, sub, &key]() {
-            map_add_sub(&point_subs, key, sub);
+            point_subs[key_to_unescaped_str(key)].push_back(sub);
         });
 }
 
 // Can't throw because it's called in a destructor.
-void feed_t::del_point_sub(point_sub_t *sub, const store_key_t &key) THROWS_NOTHING {
-    del_sub_with_lock(&point_subs_lock, [this, sub, &key]() {
-            return map_del_sub(&point_subs, key, sub);
+void feed_t::del_point_sub(point_sub_t *sub,
+                           const store_key_t &key,
+                           const boost::optional<uuid_u> &stamp_id) THROWS_NOTHING {
+    del_sub_with_lock(&point_subs_lock, [this, sub, &key, &stamp_id]() -> size_t {
+            auto it = point_subs.find(key_to_unescaped_str(key));
+            if (it == point_subs.end()) {
+                return 0;
+            }
+            auto sub_it = std::find(it->second.begin(), it->second.end(), sub);
+            if (sub_it == it->second.end()) {
+                return 0;
+            }
+            it->second.erase(sub_it);
+            if (it->second.empty()) {
+                point_subs.erase(it);
+            }
+            if (stamp_id) {
+                forget_point_key(key, *stamp_id);
+            }
+            return 1;
         });
 }
 
@@ -3609,8 +3973,10 @@ void feed_t::each_range_sub(
 void feed_t::each_point_sub_cb(const std::function<void(point_sub_t *)> &f, int i) {
     on_thread_t th((threadnum_t(i)));
     for (auto const &pair : point_subs) {
-        for (point_sub_t *sub : pair.second[i]) {
-            f(sub);
+        for (point_sub_t *sub : pair.second) {
+            if (sub->home_thread().threadnum == i) {
+                f(sub);
+            }
         }
     }
 }
@@ -3656,10 +4022,23 @@ void feed_t::on_point_sub(
     rwlock_in_line_t spot(&point_subs_lock, access_t::read);
     spot.read_signal()->wait_lazily_unordered();
 
-    auto point_sub = point_subs.find(key);
-    if (point_sub != point_subs.end()) {
-        each_sub_in_vec(point_sub->second, &spot, lock, f);
+    auto point_sub = point_subs.find(key_to_unescaped_str(key));
+    if (point_sub == point_subs.end()) {
+        return;
     }
+    std::map<int, std::vector<point_sub_t *> > subs_by_thread;
+    for (point_sub_t *sub : point_sub->second) {
+        subs_by_thread[sub->home_thread().threadnum].push_back(sub);
+    }
+    std::vector<std::pair<int, std::vector<point_sub_t *> > > thread_subs(
+        subs_by_thread.begin(), subs_by_thread.end());
+    pmap(thread_subs.size(),
+         [&f, &thread_subs](int i) {
+             on_thread_t th((threadnum_t(thread_subs[i].first)));
+             for (point_sub_t *sub : thread_subs[i].second) {
+                 f(sub);
+             }
+         });
 }
 
 void feed_t::on_limit_sub(
@@ -3716,9 +4095,7 @@ void feed_t::stop_subs(const auto_drainer_t::lock_t &lock) {
         spot.write_signal()->wait_lazily_unordered();
         each_point_sub_with_lock(&spot, f);
         for (auto &&pair : point_subs) {
-            for (auto &&set : pair.second) {
-                num_subs -= set.size();
-            }
+            num_subs -= pair.second.size();
         }
         point_subs.clear();
     }
@@ -3855,6 +4232,28 @@ counted_t<datum_stream_t> client_t::new_stream(
     const streamspec_t &ss,
     const namespace_id_t &table_id,
     backtrace_id_t bt) {
+    // Range subscriptions with transforms get a feed that the shards apply the
+    // transforms for, so that they only send us the changes we're interested in.
+    std::vector<transform_variant_t> shard_transforms;
+    if (const auto *range = boost::get<keyspec_t::range_t>(&ss.spec)) {
+        shard_transforms = range->transforms;
+    }
+    const serializable_env_t s_env = env->get_serializable_env();
+    feed_key_t key(table_id, std::vector<char>());
+    if (!shard_transforms.empty()) {
+        // The shards evaluate the transforms with the global optargs and the
+        // user of the subscription that created the feed, so only subscriptions
+        // that agree on those can share it.  (The shards don't use the
+        // deterministic time.)
+        write_message_t wm;
+        serialize<cluster_version_t::CLUSTER>(&wm, shard_transforms);
+        serialize<cluster_version_t::CLUSTER>(&wm, s_env.global_optargs);
+        serialize<cluster_version_t::CLUSTER>(&wm, s_env.user_context);
+        vector_stream_t stream;
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        key.second = stream.vector();
+    }
     bool is_second_try = false;
     uuid_u last_feed_uuid;
     for (;;) {
@@ -3872,7 +4271,7 @@ counted_t<datum_stream_t> client_t::new_stream(
                 auto_drainer_t::lock_t lock(&drainer, throw_if_draining_t::YES);
                 rwlock_in_line_t spot(&feeds_lock, access_t::write);
                 spot.read_signal()->wait_lazily_unordered();
-                auto feed_it = feeds.find(table_id);
+                auto feed_it = feeds.find(key);
 
                 if (is_second_try) {
                     guarantee(!last_feed_uuid.is_unset());
@@ -3905,11 +4304,13 @@ counted_t<datum_stream_t> client_t::new_stream(
                         this,
                         manager,
                         access.get(),
-                        table_id,
+                        key,
+                        shard_transforms,
+                        s_env,
                         &interruptor,
                         make_lifetime(name_resolver));
                     feed_it = feeds.insert(
-                        std::make_pair(table_id, std::move(val))).first;
+                        std::make_pair(key, std::move(val))).first;
                 }
 
                 guarantee(feed_it != feeds.end());
@@ -3949,13 +4350,13 @@ counted_t<datum_stream_t> client_t::new_stream(
 }
 
 void client_t::maybe_remove_feed(
-    const auto_drainer_t::lock_t &lock, const uuid_u &uuid) {
+    const auto_drainer_t::lock_t &lock, const feed_key_t &key) {
     assert_thread();
     lock.assert_is_holding(&drainer);
     scoped_ptr_t<real_feed_t> destroy;
     rwlock_in_line_t spot(&feeds_lock, access_t::write);
     spot.write_signal()->wait_lazily_unordered();
-    auto feed_it = feeds.find(uuid);
+    auto feed_it = feeds.find(key);
     // The feed might have disappeared because it may have been detached while
     // we held the lock, in which case we don't need to do anything.  The feed
     // might also have gotten a new subscriber, in which case we don't want to
@@ -3979,7 +4380,7 @@ scoped_ptr_t<real_feed_t> client_t::detach_feed(
     // there's nothing to detach.
     // It's also possible that the feed had been removed and a new feed has since been
     // added for this table uuid, so we need to compare the pointer to `expected_feed`.
-    auto feed_it = feeds.find(expected_feed->get_table_id());
+    auto feed_it = feeds.find(expected_feed->get_key());
     if (feed_it != feeds.end() && feed_it->second.get_or_null() == expected_feed) {
         ret.swap(feed_it->second);
         ret->mark_detached();
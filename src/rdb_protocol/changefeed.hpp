@@ -6,7 +6,10 @@
 #include <exception>
 #include <functional>
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
@@ -126,7 +129,34 @@ struct msg_t {
 RDB_DECLARE_SERIALIZABLE(msg_t);
 
 class real_feed_t;
-struct stamped_msg_t;
+
+// A batch of messages from one `server_t`, with consecutive stamps starting at
+// `stamp`.
+struct stamped_msg_t {
+    stamped_msg_t() { }
+    stamped_msg_t(uuid_u _server_uuid, uint64_t _stamp, msg_t _submsg)
+        : server_uuid(std::move(_server_uuid)),
+          stamp(_stamp) {
+        submsgs.push_back(std::move(_submsg));
+    }
+    stamped_msg_t(
+            uuid_u _server_uuid,
+            uint64_t _stamp,
+            std::vector<std::shared_ptr<const std::vector<char> > > _serialized_submsgs)
+        : server_uuid(std::move(_server_uuid)),
+          stamp(_stamp),
+          serialized_submsgs(std::move(_serialized_submsgs)) { }
+    uuid_u server_uuid;
+    uint64_t stamp;
+    std::vector<msg_t> submsgs;
+    /* `send_all()` sends the same message to every client that's interested in a
+    change. It serializes the message only once, and the batches for the individual
+    clients share the serialized form, which is sent instead of `submsgs`. It's
+    never set on the receiving end. */
+    std::vector<std::shared_ptr<const std::vector<char> > > serialized_submsgs;
+};
+
+RDB_DECLARE_SERIALIZABLE(stamped_msg_t);
 
 typedef mailbox_addr_t<void(stamped_msg_t)> client_addr_t;
 
@@ -224,8 +254,14 @@ public:
         const streamspec_t &ss,
         const namespace_id_t &table_id,
         backtrace_id_t bt);
+    // Feeds are shared by all the subscriptions on a table, except for range
+    // subscriptions with transforms.  Those share a feed with the subscriptions
+    // that have the same transforms, global optargs and user, and the shards
+    // apply the transforms before sending the changes.  The second half of the
+    // key is those serialized, and is empty for a feed of the whole table.
+    typedef std::pair<namespace_id_t, std::vector<char> > feed_key_t;
     void maybe_remove_feed(
-        const auto_drainer_t::lock_t &lock, const namespace_id_t &uuid);
+        const auto_drainer_t::lock_t &lock, const feed_key_t &key);
     scoped_ptr_t<real_feed_t> detach_feed(
         const auto_drainer_t::lock_t &lock,
         real_feed_t *expected_feed);
@@ -238,7 +274,7 @@ private:
             signal_t *)
         > const namespace_source;
     name_resolver_t const &name_resolver;
-    std::map<namespace_id_t, scoped_ptr_t<real_feed_t> > feeds;
+    std::map<feed_key_t, scoped_ptr_t<real_feed_t> > feeds;
     // This lock manages access to the `feeds` map.  The `feeds` map needs to be
     // read whenever `new_stream` is called, and needs to be written to whenever
     // `new_stream` is called with a table not already in the `feeds` map, or
@@ -255,6 +291,9 @@ private:
 };
 
 typedef mailbox_addr_t<void(client_addr_t)> server_addr_t;
+// Clients send the primary key and id of a point changefeed to this address when
+// the changefeed goes away.
+typedef mailbox_addr_t<void(client_addr_t, store_key_t, uuid_u)> server_point_addr_t;
 
 template<class Id, class Key, class Val, class Gt>
 class index_queue_t {
@@ -433,7 +472,11 @@ private:
     // Can throw `exc_t` exceptions if an error occurs while reading from disk.
     std::vector<item_t> read_more(
         const boost::variant<primary_ref_t, sindex_ref_t> &ref,
-        const boost::optional<item_t> &start);
+        const boost::optional<item_t> &start,
+        size_t n);
+    // Moves the best rows out of `spare` until `item_queue` is full again, adding
+    // them to `real_added`.
+    void refill_from_spare(item_queue_t *real_added);
     void send(msg_t &&msg);
 
     scoped_ptr_t<env_t> env;
@@ -445,7 +488,14 @@ private:
     std::vector<scoped_ptr_t<op_t> > ops;
 
     limit_order_t gt;
+    // The top `n` rows, which is what the client sees.
     item_queue_t item_queue;
+    // The rows that come right after the ones in `item_queue`, so that we don't
+    // have to go to disk every time a row drops out of the top `n`.  Every row
+    // in `spare` is worse than every row in `item_queue`, and every row on disk
+    // that isn't in either is worse than every row in `spare`.
+    item_queue_t spare;
+    size_t spare_limit;
 
     std::map<std::string, std::pair<datum_t, datum_t> > added;
     std::set<std::string> deleted;
@@ -462,13 +512,21 @@ public:
 class server_t {
 public:
     typedef server_addr_t addr_t;
+    typedef server_point_addr_t point_addr_t;
     typedef mailbox_addr_t<void(client_t::addr_t, boost::optional<std::string>, uuid_u)>
         limit_addr_t;
     explicit server_t(mailbox_manager_t *_manager, store_t *_parent);
     ~server_t();
+    // If `transforms` isn't empty, they are applied to the changes before they
+    // are sent to the client, and changes that neither the old nor the new value
+    // makes it through aren't sent at all.
     void add_client(
         const client_t::addr_t &addr,
         region_t region,
+        rdb_context_t *ctx,
+        global_optargs_t optargs,
+        auth::user_context_t user_context,
+        const std::vector<transform_variant_t> &transforms,
         const auto_drainer_t::lock_t &keepalive);
     void add_limit_client(
         const client_t::addr_t &addr,
@@ -490,10 +548,19 @@ public:
         rwlock_in_line_t *stamp_spot,
         const auto_drainer_t::lock_t &keepalive);
     addr_t get_stop_addr();
+    point_addr_t get_point_stop_addr();
     limit_addr_t get_limit_stop_addr();
+    // Once a client has taken a stamp with `get_stamp`, it gets all the changes
+    // in its regions.  Until then it only gets the changes to the keys it took a
+    // stamp for with `get_point_stamp`, which is all that point changefeeds need.
     boost::optional<uint64_t> get_stamp(
         const client_t::addr_t &addr,
         const auto_drainer_t::lock_t &keepalive);
+    boost::optional<uint64_t> get_point_stamp(
+        const client_t::addr_t &addr,
+        const store_key_t &key,
+        const uuid_u &sub_id,
+        const auto_drainer_t::lock_t &keepalive);
     uuid_u get_uuid();
     // `f` will be called with a read lock on `clients` and a write lock on the
     // limit manager.
@@ -513,6 +580,10 @@ public:
 private:
     friend class limit_manager_t;
     void stop_mailbox_cb(signal_t *interruptor, client_t::addr_t addr);
+    void point_stop_mailbox_cb(signal_t *interruptor,
+                               client_t::addr_t addr,
+                               store_key_t key,
+                               uuid_u sub_id);
     void limit_stop_mailbox_cb(signal_t *interruptor,
                                client_t::addr_t addr,
                                boost::optional<std::string> sindex,
@@ -541,9 +612,23 @@ private:
                      bool(const boost::optional<std::string> &,
                           const boost::optional<std::string> &)> > limit_clients;
         scoped_ptr_t<rwlock_t> limit_clients_lock;
+        // Only set if the client has transforms for us to apply.
+        scoped_ptr_t<env_t> env;
+        std::vector<scoped_ptr_t<op_t> > ops;
+        // See `get_stamp`.  `point_keys` maps the keys of the point changefeeds to
+        // the ids of the changefeeds on them.  We keep the ids rather than a count
+        // so that removing a changefeed is idempotent: a client whose stamp read
+        // was interrupted can't tell whether it reached us, so it always sends the
+        // stop message, and we ignore it if we never saw the changefeed.
+        bool all_keys;
+        std::unordered_map<std::string, std::set<uuid_u> > point_keys;
     };
     std::map<client_t::addr_t, client_info_t> clients;
 
+    static bool wants_change(const client_info_t &info,
+                             const store_key_t &key,
+                             const std::string &key_str);
+
     void prune_dead_limit(
         auto_drainer_t::lock_t *stealable_lock,
         scoped_ptr_t<rwlock_in_line_t> *stealable_clients_read_lock,
@@ -555,16 +640,38 @@ private:
                             msg_t msg,
                             const auto_drainer_t::lock_t &lock);
 
+    // Changes are sent to each client in batches of consecutively stamped
+    // messages.  A batch is sent once it holds `MAX_BATCH_SIZE` messages, or once
+    // the writes that are running at the same time have had a chance to add to
+    // it, whichever comes first.
+    static const size_t MAX_BATCH_SIZE = 128;
+    struct batch_t {
+        uint64_t first_stamp;
+        std::vector<std::shared_ptr<const std::vector<char> > > serialized_msgs;
+    };
+    std::map<client_t::addr_t, batch_t> batches;
+
+    // Returns true if the batch is full and should be sent right away.  This
+    // mustn't block between assigning `stamp` and adding the message.
+    bool add_to_batch(const client_t::addr_t &addr,
+                      uint64_t stamp,
+                      std::shared_ptr<const std::vector<char> > serialized_msg,
+                      const auto_drainer_t::lock_t &lock);
+    void send_batch(const client_t::addr_t &addr, const auto_drainer_t::lock_t &lock);
+    void send_batch_cb(client_t::addr_t addr, auto_drainer_t::lock_t lock);
+
     // Controls access to `clients`.  A `server_t` needs to read `clients` when:
     // * `send_all` is called
-    // * `get_stamp` is called
+    // * `get_stamp` or `get_point_stamp` is called
     // And needs to write to clients when:
     // * `add_client` is called
     // * `clear` is called
     // * A message is received at `stop_mailbox` unsubscribing a client
     // A lock is needed because e.g. `send_all` calls `send`, which can block,
     // while looping over `clients`, and we need to make sure the map doesn't
-    // change under it.
+    // change under it.  The stamp functions and `point_stop_mailbox` update the
+    // keys a client wants with only a read lock, which is fine because they don't
+    // block while doing so, and the stamp functions hold the stamp lock too.
     rwlock_t clients_lock;
     // We need access to the stamp lock that exists on the parent.
     store_t *parent;
@@ -574,6 +681,9 @@ private:
     // to unsubscribe.  The callback of this mailbox acquires the drainer, so it
     // has to be destroyed first.
     mailbox_t<void(client_t::addr_t)> stop_mailbox;
+    // Clients send a message to this mailbox when they remove a point changefeed
+    // that may have taken a point stamp.
+    mailbox_t<void(client_t::addr_t, store_key_t, uuid_u)> point_stop_mailbox;
     // Clients send a message to this mailbox to unsubscribe a particular limit
     // changefeed.
     mailbox_t<void(client_t::addr_t, boost::optional<std::string>, uuid_u)>
@@ -10,14 +10,18 @@
 #include "time.hpp"
 
 bool sindex_config_t::operator==(const sindex_config_t &o) const {
-    if (func_version != o.func_version || multi != o.multi || geo != o.geo) {
+    if (func_version != o.func_version || multi != o.multi || geo != o.geo
+        || aggregate != o.aggregate || reference != o.reference
+        || change_log_size != o.change_log_size) {
         return false;
     }
     /* This is kind of a hack--we compare the functions by serializing them and comparing
     the serialized values. */
     write_message_t wm1, wm2;
     serialize<cluster_version_t::CLUSTER>(&wm1, func);
+    serialize<cluster_version_t::CLUSTER>(&wm1, filter);
     serialize<cluster_version_t::CLUSTER>(&wm2, o.func);
+    serialize<cluster_version_t::CLUSTER>(&wm2, o.filter);
     vector_stream_t stream1, stream2;
     int res = send_write_message(&stream1, &wm1);
     guarantee(res == 0);
@@ -26,8 +30,72 @@ bool sindex_config_t::operator==(const sindex_config_t &o) const {
     return stream1.vector() == stream2.vector();
 }
 
-RDB_IMPL_SERIALIZABLE_4_SINCE_v2_1(sindex_config_t,
-    func, func_version, multi, geo);
+template <cluster_version_t W>
+void serialize(write_message_t *wm, const sindex_config_t &sc) {
+    serialize<W>(wm, sc.func);
+    serialize<W>(wm, sc.func_version);
+    serialize<W>(wm, sc.multi);
+    serialize<W>(wm, sc.geo);
+    serialize<W>(wm, sc.aggregate);
+    serialize<W>(wm, sc.reference);
+    serialize<W>(wm, sc.filter);
+    serialize<W>(wm, sc.change_log_size);
+}
+
+INSTANTIATE_SERIALIZE_FOR_CLUSTER_AND_DISK(sindex_config_t);
+
+template <cluster_version_t W>
+archive_result_t deserialize_sindex_config_pre_v2_4(
+        read_stream_t *s, sindex_config_t *sc) {
+    archive_result_t res = deserialize<W>(s, &sc->func);
+    if (bad(res)) { return res; }
+    res = deserialize<W>(s, &sc->func_version);
+    if (bad(res)) { return res; }
+    res = deserialize<W>(s, &sc->multi);
+    if (bad(res)) { return res; }
+    res = deserialize<W>(s, &sc->geo);
+    if (bad(res)) { return res; }
+    sc->aggregate = sindex_aggregate_bool_t::REGULAR;
+    sc->reference = sindex_reference_bool_t::COPY;
+    sc->filter = boost::none;
+    sc->change_log_size = 0;
+    return res;
+}
+
+template <cluster_version_t W>
+archive_result_t deserialize(read_stream_t *s, sindex_config_t *sc) {
+    archive_result_t res = deserialize_sindex_config_pre_v2_4<W>(s, sc);
+    if (bad(res)) { return res; }
+    res = deserialize<W>(s, &sc->aggregate);
+    if (bad(res)) { return res; }
+    res = deserialize<W>(s, &sc->reference);
+    if (bad(res)) { return res; }
+    res = deserialize<W>(s, &sc->filter);
+    if (bad(res)) { return res; }
+    res = deserialize<W>(s, &sc->change_log_size);
+    return res;
+}
+
+template <>
+archive_result_t deserialize<cluster_version_t::v2_1>(
+        read_stream_t *s, sindex_config_t *sc) {
+    return deserialize_sindex_config_pre_v2_4<cluster_version_t::v2_1>(s, sc);
+}
+
+template <>
+archive_result_t deserialize<cluster_version_t::v2_2>(
+        read_stream_t *s, sindex_config_t *sc) {
+    return deserialize_sindex_config_pre_v2_4<cluster_version_t::v2_2>(s, sc);
+}
+
+template <>
+archive_result_t deserialize<cluster_version_t::v2_3>(
+        read_stream_t *s, sindex_config_t *sc) {
+    return deserialize_sindex_config_pre_v2_4<cluster_version_t::v2_3>(s, sc);
+}
+
+template archive_result_t deserialize<cluster_version_t::v2_4_is_latest>(
+    read_stream_t *, sindex_config_t *);
 
 bool write_hook_config_t::operator==(const write_hook_config_t &o) const {
     if (func_version != o.func_version) {
@@ -52,13 +120,17 @@ RDB_IMPL_SERIALIZABLE_2_SINCE_v2_4(write_hook_config_t,
 void sindex_status_t::accum(const sindex_status_t &other) {
     progress_numerator += other.progress_numerator;
     progress_denominator += other.progress_denominator;
+    ranges_progress.insert(ranges_progress.end(),
+                           other.ranges_progress.begin(),
+                           other.ranges_progress.end());
     ready &= other.ready;
     start_time = std::min(start_time, other.start_time);
     rassert(outdated == other.outdated);
 }
 
-RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(sindex_status_t,
-    progress_numerator, progress_denominator, ready, outdated, start_time);
+RDB_IMPL_SERIALIZABLE_6_FOR_CLUSTER(sindex_status_t,
+    progress_numerator, progress_denominator, ranges_progress, ready, outdated,
+    start_time);
 
 const char *rql_perfmon_name = "query_engine";
 
@@ -79,6 +151,7 @@ rdb_context_t::rdb_context_t()
       cluster_interface(nullptr),
       manager(nullptr),
       reql_http_proxy(),
+      io_backender(nullptr),
       stats(&get_global_perfmon_collection()) { }
 
 rdb_context_t::rdb_context_t(
@@ -90,6 +163,7 @@ rdb_context_t::rdb_context_t(
       cluster_interface(_cluster_interface),
       manager(nullptr),
       reql_http_proxy(),
+      io_backender(nullptr),
       stats(&get_global_perfmon_collection()) {
     init_auth_watchables(auth_semilattice_view);
 }
@@ -101,11 +175,15 @@ rdb_context_t::rdb_context_t(
         std::shared_ptr<semilattice_read_view_t<auth_semilattice_metadata_t>>
             auth_semilattice_view,
         perfmon_collection_t *global_stats,
-        const std::string &_reql_http_proxy)
+        const std::string &_reql_http_proxy,
+        io_backender_t *_io_backender,
+        const base_path_t &_base_path)
     : extproc_pool(_extproc_pool),
       cluster_interface(_cluster_interface),
       manager(_mailbox_manager),
       reql_http_proxy(_reql_http_proxy),
+      io_backender(_io_backender),
+      base_path(_base_path),
       stats(global_stats) {
     init_auth_watchables(auth_semilattice_view);
 }
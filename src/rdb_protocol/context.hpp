@@ -47,6 +47,7 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
 class auth_semilattice_metadata_t;
 class ellipsoid_spec_t;
 class extproc_pool_t;
+class io_backender_t;
 class name_string_t;
 class namespace_interface_t;
 template <class> class cross_thread_watchable_variable_t;
@@ -54,18 +55,34 @@ template <class> class semilattice_read_view_t;
 
 enum class sindex_multi_bool_t { SINGLE = 0, MULTI = 1};
 enum class sindex_geo_bool_t { REGULAR = 0, GEO = 1};
+/* An aggregate index doesn't index the rows themselves. It keeps the number of rows for
+every value of the index function instead, so `group(index=...).count()` can be answered
+without reading the rows. */
+enum class sindex_aggregate_bool_t { REGULAR = 0, AGGREGATE = 1};
+/* The entries of a reference index only hold the primary key of their row, which is
+part of the entry's key anyway. Reads look the rows up in the primary B-tree. */
+enum class sindex_reference_bool_t { COPY = 0, REFERENCE = 1};
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(sindex_multi_bool_t, int8_t,
         sindex_multi_bool_t::SINGLE, sindex_multi_bool_t::MULTI);
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(sindex_geo_bool_t, int8_t,
         sindex_geo_bool_t::REGULAR, sindex_geo_bool_t::GEO);
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(sindex_aggregate_bool_t, int8_t,
+        sindex_aggregate_bool_t::REGULAR, sindex_aggregate_bool_t::AGGREGATE);
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(sindex_reference_bool_t, int8_t,
+        sindex_reference_bool_t::COPY, sindex_reference_bool_t::REFERENCE);
 
 class sindex_config_t {
 public:
     sindex_config_t() { }
     sindex_config_t(const ql::map_wire_func_t &_func, reql_version_t _func_version,
-            sindex_multi_bool_t _multi, sindex_geo_bool_t _geo) :
-        func(_func), func_version(_func_version), multi(_multi), geo(_geo) { }
+            sindex_multi_bool_t _multi, sindex_geo_bool_t _geo,
+            sindex_aggregate_bool_t _aggregate, sindex_reference_bool_t _reference,
+            const boost::optional<ql::map_wire_func_t> &_filter,
+            uint64_t _change_log_size) :
+        func(_func), func_version(_func_version), multi(_multi), geo(_geo),
+        aggregate(_aggregate), reference(_reference), filter(_filter),
+        change_log_size(_change_log_size) { }
 
     bool operator==(const sindex_config_t &o) const;
     bool operator!=(const sindex_config_t &o) const {
@@ -76,6 +93,17 @@ public:
     reql_version_t func_version;
     sindex_multi_bool_t multi;
     sindex_geo_bool_t geo;
+    sindex_aggregate_bool_t aggregate;
+    sindex_reference_bool_t reference;
+    /* A partial index only has entries for the rows that pass `filter`. Reads of it
+    must be followed by the same filter. */
+    boost::optional<ql::map_wire_func_t> filter;
+    /* A change log index doesn't index the rows. If `change_log_size` isn't zero, it
+    keeps an entry for every write that changed the value of `func` for a row, keyed by
+    the write's timestamp, and drops the entries that are more than `change_log_size`
+    timestamps older than the newest one. Timestamps are per shard, so it can only be
+    read on tables with a single shard. */
+    uint64_t change_log_size;
 };
 RDB_DECLARE_SERIALIZABLE(sindex_config_t);
 
@@ -106,6 +134,9 @@ public:
     void accum(const sindex_status_t &other);
     double progress_numerator;
     double progress_denominator;
+    /* The progress of each of the primary key sub-ranges that are being constructed
+    concurrently, across all stores. */
+    std::vector<double> ranges_progress;
     bool ready;
     bool outdated;
     /* Note that `start_time` is only valid when `ready` is false, and while we
@@ -171,6 +202,17 @@ public:
         r_sanity_fail();
     }
 
+    /* Estimates which fraction of the entries of `index` (the primary key or a
+    secondary index) lie in `range`, from the key distribution of the index's B-trees.
+    Returns false if there's no estimate to be had. */
+    virtual bool estimate_index_fraction(
+        ql::env_t *,
+        const std::string &,
+        const key_range_t &,
+        double *) {
+        return false;
+    }
+
     virtual ql::datum_t read_row(ql::env_t *env,
         ql::datum_t pval, read_mode_t read_mode) = 0;
     virtual counted_t<ql::datum_stream_t> read_all(
@@ -219,7 +261,8 @@ public:
         boost::optional<counted_t<const ql::func_t> > conflict_func,
         return_changes_t return_changes,
         durability_requirement_t durability,
-        ignore_write_hook_t ignore_write_hook) = 0;
+        ignore_write_hook_t ignore_write_hook,
+        presorted_t presorted) = 0;
     virtual bool write_sync_depending_on_durability(
         ql::env_t *env,
         durability_requirement_t durability) = 0;
@@ -470,7 +513,9 @@ public:
         std::shared_ptr<semilattice_read_view_t<auth_semilattice_metadata_t>>
             auth_semilattice_view,
         perfmon_collection_t *global_stats,
-        const std::string &_reql_http_proxy);
+        const std::string &_reql_http_proxy,
+        io_backender_t *_io_backender,
+        const base_path_t &_base_path);
 
     ~rdb_context_t();
 
@@ -481,6 +526,12 @@ public:
 
     const std::string reql_http_proxy;
 
+    /* Used for writing temporary files, e.g. the sorted runs of an `order_by` that
+    doesn't fit in memory. `io_backender` is `nullptr` on proxies and in unit tests,
+    which don't have a data directory. */
+    io_backender_t *io_backender;
+    const base_path_t base_path;
+
     class stats_t {
     public:
         explicit stats_t(perfmon_collection_t *global_stats);
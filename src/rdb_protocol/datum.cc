@@ -1834,6 +1834,170 @@ int datum_t::cmp(const datum_t &rhs) const {
         });
 }
 
+// The hash is 64-bit FNV-1a over a canonical encoding of the datum, in which every
+// value starts with a tag for its type and integers are written in little-endian order.
+const uint64_t datum_hash_offset_basis = 0xcbf29ce484222325ULL;
+const uint64_t datum_hash_prime = 0x100000001b3ULL;
+
+void datum_hash_bytes(uint64_t *h, const char *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        *h ^= static_cast<uint8_t>(data[i]);
+        *h *= datum_hash_prime;
+    }
+}
+
+void datum_hash_uint64(uint64_t *h, uint64_t value) {
+    for (size_t i = 0; i < sizeof(value); ++i) {
+        *h ^= (value >> (8 * i)) & 0xff;
+        *h *= datum_hash_prime;
+    }
+}
+
+void datum_hash_string(uint64_t *h, const char *data, size_t size) {
+    datum_hash_uint64(h, size);
+    datum_hash_bytes(h, data, size);
+}
+
+void datum_hash_num(uint64_t *h, double num) {
+    // `0.0` and `-0.0` compare as equal, so they need the same hash.
+    if (num == 0.0) {
+        num = 0.0;
+    }
+    uint64_t bits;
+    static_assert(sizeof(bits) == sizeof(num), "double must be 64 bits");
+    memcpy(&bits, &num, sizeof(bits));
+    datum_hash_uint64(h, bits);
+}
+
+uint64_t datum_t::hash_unchecked_stack() const {
+    uint64_t h = datum_hash_offset_basis;
+    if (is_ptype() && !pseudo_compares_as_obj()) {
+        // Pseudotypes are only equal to pseudotypes of the same type, and
+        // `pseudo_cmp()` decides which of their fields matter.
+        std::string reql_type = get_reql_type();
+        datum_hash_bytes(&h, "p", 1);
+        datum_hash_string(&h, reql_type.data(), reql_type.size());
+        if (get_type() == R_BINARY) {
+            datum_hash_string(&h, as_binary().data(), as_binary().size());
+            return h;
+        } else if (reql_type == pseudo::time_string) {
+            datum_hash_num(&h, pseudo::time_to_epoch_time(*this));
+            return h;
+        }
+        // Other pseudotypes can't be compared at all, so we just hash them as
+        // objects below.
+    }
+
+    switch (get_type()) {
+    case MINVAL: datum_hash_bytes(&h, "-", 1); break;
+    case MAXVAL: datum_hash_bytes(&h, "+", 1); break;
+    case R_NULL: datum_hash_bytes(&h, "n", 1); break;
+    case R_BOOL:
+        datum_hash_bytes(&h, "b", 1);
+        datum_hash_uint64(&h, as_bool() ? 1 : 0);
+        break;
+    case R_NUM:
+        datum_hash_bytes(&h, "d", 1);
+        datum_hash_num(&h, as_num());
+        break;
+    case R_STR:
+        datum_hash_bytes(&h, "s", 1);
+        datum_hash_string(&h, as_str().data(), as_str().size());
+        break;
+    case R_ARRAY: {
+        datum_hash_bytes(&h, "a", 1);
+        const size_t sz = arr_size();
+        datum_hash_uint64(&h, sz);
+        for (size_t i = 0; i < sz; ++i) {
+            datum_hash_uint64(&h, unchecked_get(i).hash());
+        }
+    } break;
+    case R_OBJECT: {
+        datum_hash_bytes(&h, "o", 1);
+        const size_t sz = obj_size();
+        datum_hash_uint64(&h, sz);
+        for (size_t i = 0; i < sz; ++i) {
+            auto pair = unchecked_get_pair(i);
+            datum_hash_string(&h, pair.first.data(), pair.first.size());
+            datum_hash_uint64(&h, pair.second.hash());
+        }
+    } break;
+    case R_BINARY: // This should be handled by the ptype code above
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+    return h;
+}
+
+uint64_t datum_t::hash() const {
+    return call_with_enough_stack_datum<uint64_t>([&] {
+            return this->hash_unchecked_stack();
+        });
+}
+
+// Escapes null bytes the same way as `str_to_str_key()`, so that the null byte that
+// terminates every value in a sort key is smaller than any byte of the string.
+void append_escaped_sort_key_string(const datum_string_t &str, std::string *str_out) {
+    for (size_t i = 0; i < str.size(); ++i) {
+        switch (str.data()[i]) {
+        case '\x00':
+            str_out->append("\x01\x01");
+            break;
+        case '\x01':
+            str_out->append("\x01\x02");
+            break;
+        default:
+            str_out->append(1, str.data()[i]);
+        }
+    }
+}
+
+bool datum_t::append_sort_key_unchecked_stack(std::string *str_out) const {
+    switch (get_type()) {
+    case MINVAL: // fallthru
+    case MAXVAL:
+        extrema_to_str_key(extrema_encoding_t::LATEST, extrema_ok_t::OK, str_out);
+        break;
+    // Type names sort alphabetically, and "NULL" sorts between "BOOL" and "NUMBER".
+    case R_NULL: str_out->append("L"); break;
+    case R_BOOL: bool_to_str_key(str_out); break;
+    case R_NUM: num_to_str_key(str_out); break;
+    case R_STR:
+        str_out->append("S");
+        append_escaped_sort_key_string(as_str(), str_out);
+        break;
+    case R_BINARY:
+        str_out->append("PBINARY:");
+        append_escaped_sort_key_string(as_binary(), str_out);
+        break;
+    case R_ARRAY: {
+        str_out->append("A");
+        const size_t sz = arr_size();
+        for (size_t i = 0; i < sz; ++i) {
+            if (!unchecked_get(i).append_sort_key(str_out)) {
+                return false;
+            }
+        }
+    } break;
+    case R_OBJECT:
+        if (!is_ptype(pseudo::time_string)) {
+            return false;
+        }
+        pseudo::time_to_str_key(*this, str_out);
+        break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+    str_out->append(1, '\0');
+    return true;
+}
+
+bool datum_t::append_sort_key(std::string *str_out) const {
+    return call_with_enough_stack_datum<bool>([&] {
+            return this->append_sort_key_unchecked_stack(str_out);
+        });
+}
+
 bool datum_t::operator==(const datum_t &rhs) const { return cmp(rhs) == 0; }
 bool datum_t::operator!=(const datum_t &rhs) const { return cmp(rhs) != 0; }
 bool datum_t::operator<(const datum_t &rhs) const { return cmp(rhs) < 0; }
@@ -330,6 +330,21 @@ public:
     bool operator>(const datum_t &rhs) const;
     bool operator>=(const datum_t &rhs) const;
 
+    // A hash that is consistent with `operator==`, i.e. data that compare as equal
+    // have the same hash. It only depends on the value of the datum (not on its
+    // in-memory representation), so it's the same on every server and in every
+    // version, and can be used to partition data between servers.
+    uint64_t hash() const;
+
+    // Appends a byte string to `*str_out` such that comparing the byte strings of two
+    // data with `memcmp` orders them the same way as `cmp()`. This uses the same
+    // encoding as secondary index keys, except that nothing is truncated and that
+    // null is supported. Every value is followed by a null byte, so the byte strings
+    // of several values can be concatenated into a compound key. Returns `false` if
+    // the datum contains a value that has no such encoding (objects, geometry and
+    // pseudotypes other than times and binary data).
+    bool append_sort_key(std::string *str_out) const;
+
     NORETURN void runtime_fail(base_exc_t::type_t exc_type,
                                const char *test, const char *file, int line,
                                std::string msg) const;
@@ -403,6 +418,8 @@ private:
         std::string *str_out) const;
 
     int cmp_unchecked_stack(const datum_t &rhs) const;
+    uint64_t hash_unchecked_stack() const;
+    bool append_sort_key_unchecked_stack(std::string *str_out) const;
 
     int pseudo_cmp(const datum_t &rhs) const;
     bool pseudo_compares_as_obj() const;
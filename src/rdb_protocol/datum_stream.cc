@@ -4,6 +4,9 @@
 #include <map>
 
 #include "boost_utils.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/disk_backed_queue.hpp"
+#include "containers/uuid.hpp"
 #include "rdb_protocol/batching.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
@@ -1604,6 +1607,148 @@ indexed_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batch
     return ret;
 }
 
+// EXTERNAL_SORT_DATUM_STREAM_T
+
+/* A sorted run of rows in a temporary file. Rows are written and read in chunks of
+`CHUNK_SIZE`, so that only one chunk per run needs to be in memory while merging. */
+class external_sort_datum_stream_t::run_t {
+public:
+    static const size_t CHUNK_SIZE = 1000;
+
+    run_t(io_backender_t *io_backender,
+          const base_path_t &base_path,
+          perfmon_collection_t *stats_parent)
+        : queue(io_backender,
+                serializer_filepath_t(
+                    base_path, "sort_" + uuid_to_str(generate_uuid())),
+                stats_parent),
+          position(0) { }
+
+    void append(datum_t &&row) {
+        chunk.push_back(std::move(row));
+        if (chunk.size() >= CHUNK_SIZE) {
+            finish();
+        }
+    }
+
+    // Must be called after the last `append()`.
+    void finish() {
+        if (!chunk.empty()) {
+            queue.push(chunk);
+            chunk.clear();
+        }
+    }
+
+    // Returns the next row without removing it, or `nullptr` if the run is exhausted.
+    datum_t *head() {
+        if (position == chunk.size()) {
+            chunk.clear();
+            position = 0;
+            if (queue.empty()) {
+                return nullptr;
+            }
+            queue.pop(&chunk);
+        }
+        return &chunk[position];
+    }
+
+    // Must only be called if `head()` returned a row.
+    datum_t pop() {
+        r_sanity_check(position < chunk.size());
+        return std::move(chunk[position++]);
+    }
+
+private:
+    disk_backed_queue_t<std::vector<datum_t> > queue;
+    std::vector<datum_t> chunk;
+    size_t position;
+
+    DISABLE_COPYING(run_t);
+};
+
+external_sort_datum_stream_t::external_sort_datum_stream_t(
+        io_backender_t *_io_backender,
+        const base_path_t &_base_path,
+        lt_cmp_t _lt_cmp,
+        backtrace_id_t bt)
+    : eager_datum_stream_t(bt),
+      io_backender(_io_backender),
+      base_path(_base_path),
+      lt_cmp(std::move(_lt_cmp)),
+      rows_left(0) {
+    r_sanity_check(io_backender != nullptr);
+}
+
+external_sort_datum_stream_t::~external_sort_datum_stream_t() { }
+
+void external_sort_datum_stream_t::add_run(env_t *env, std::vector<datum_t> &&rows) {
+    {
+        profile::sampler_t sampler("Sorting in-memory.", env->trace);
+        stable_sort_rows(env, &sampler, lt_cmp, &rows);
+    }
+    if (runs.size() >= MAX_RUNS) {
+        merge_runs(env);
+    }
+    scoped_ptr_t<run_t> run(new run_t(io_backender, base_path, &perfmon_collection));
+    rows_left += rows.size();
+    for (auto &&row : rows) {
+        run->append(std::move(row));
+    }
+    run->finish();
+    runs.push_back(std::move(run));
+}
+
+void external_sort_datum_stream_t::merge_runs(env_t *env) {
+    scoped_ptr_t<run_t> merged(
+        new run_t(io_backender, base_path, &perfmon_collection));
+    profile::sampler_t sampler("Merging sorted runs.", env->trace);
+    for (size_t i = min_run(env, &sampler); i < runs.size();
+         i = min_run(env, &sampler)) {
+        merged->append(runs[i]->pop());
+        sampler.new_sample();
+    }
+    merged->finish();
+    runs.clear();
+    runs.push_back(std::move(merged));
+}
+
+size_t external_sort_datum_stream_t::min_run(env_t *env, profile::sampler_t *sampler) {
+    size_t best = runs.size();
+    datum_t *best_row = nullptr;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        datum_t *row = runs[i]->head();
+        if (row != nullptr
+            && (best_row == nullptr || lt_cmp(env, sampler, *row, *best_row))) {
+            best = i;
+            best_row = row;
+        }
+    }
+    return best;
+}
+
+std::vector<datum_t>
+external_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<datum_t> ret;
+    batcher_t batcher = batchspec.to_batcher();
+
+    profile::sampler_t sampler("Merging sorted runs.", env->trace);
+    while (!batcher.should_send_batch()) {
+        size_t i = min_run(env, &sampler);
+        if (i == runs.size()) {
+            break;
+        }
+        datum_t row = runs[i]->pop();
+        --rows_left;
+        batcher.note_el(row);
+        ret.push_back(std::move(row));
+    }
+    return ret;
+}
+
+bool external_sort_datum_stream_t::is_exhausted() const {
+    return rows_left == 0 && batch_cache_exhausted();
+}
+
 // ORDERED_DISTINCT_DATUM_STREAM_T
 ordered_distinct_datum_stream_t::ordered_distinct_datum_stream_t(
     counted_t<datum_stream_t> _source) : wrapper_datum_stream_t(_source) { }
@@ -2372,6 +2517,163 @@ bool eq_join_datum_stream_t::is_exhausted() const {
     return false;
 }
 
+hash_join_datum_stream_t::hash_join_datum_stream_t(
+        counted_t<datum_stream_t> _stream,
+        std::vector<datum_t> &&_right_rows,
+        counted_t<const func_t> _predicate,
+        bool _outer,
+        backtrace_id_t _bt) :
+    eager_datum_stream_t(_bt),
+    stream(std::move(_stream)),
+    right_rows(std::move(_right_rows)),
+    predicate(std::move(_predicate)),
+    outer(_outer),
+    has_right_index(false),
+    left_pos(0),
+    left_matched(false),
+    is_array_hash_join(stream->is_array()),
+    is_infinite_hash_join(stream->is_infinite()),
+    hash_join_type(stream->cfeed_type()) { }
+
+hash_join_datum_stream_t::hash_join_datum_stream_t(
+        counted_t<datum_stream_t> _stream,
+        std::vector<datum_t> &&_right_prefix,
+        counted_t<const func_t> _right_func,
+        counted_t<const func_t> _predicate,
+        bool _outer,
+        backtrace_id_t _bt) :
+    eager_datum_stream_t(_bt),
+    stream(std::move(_stream)),
+    right_rows(std::move(_right_prefix)),
+    right_func(std::move(_right_func)),
+    predicate(std::move(_predicate)),
+    outer(_outer),
+    has_right_index(false),
+    left_pos(0),
+    left_matched(false),
+    is_array_hash_join(stream->is_array()),
+    is_infinite_hash_join(stream->is_infinite()),
+    hash_join_type(stream->cfeed_type()) { }
+
+void hash_join_datum_stream_t::set_right_index(datum_string_t _left_field,
+                                               right_index_t &&_right_index) {
+    guarantee(!right_func.has());
+    has_right_index = true;
+    left_field = std::move(_left_field);
+    right_index = std::move(_right_index);
+}
+
+void hash_join_datum_stream_t::set_right_remainder(
+        counted_t<datum_stream_t> &&_right_remainder) {
+    guarantee(right_func.has());
+    right_remainder = std::move(_right_remainder);
+}
+
+std::vector<datum_t> hash_join_datum_stream_t::next_raw_batch(
+    env_t *env,
+    const batchspec_t &batchspec) {
+    batcher_t batcher = batchspec.to_batcher();
+
+    datum_string_t right("right");
+    datum_string_t left("left");
+    std::vector<datum_t> res;
+    auto emit = [&](const datum_t &left_row, const datum_t *right_row) {
+        ql::datum_object_builder_t res_item;
+        bool conflict = false;
+        conflict |= res_item.add(left, left_row);
+        if (right_row != nullptr) {
+            conflict |= res_item.add(right, *right_row);
+        }
+        guarantee(!conflict);
+        datum_t res_datum = std::move(res_item).to_datum();
+        batcher.note_el(res_datum);
+        res.push_back(std::move(res_datum));
+    };
+
+    while (!batcher.should_send_batch()) {
+        if (left_pos == left_batch.size()) {
+            if (stream->is_exhausted()) {
+                break;
+            }
+            left_batch = stream->next_batch(env, batchspec);
+            left_pos = 0;
+            if (left_batch.empty()) {
+                // The input stream is either exhausted or a changefeed.
+                break;
+            }
+        }
+        const datum_t &left_row = left_batch[left_pos];
+
+        if (right_func.has()) {
+            // Stream the rest of the right-hand sequence one row at a time, so that a
+            // big one is never held in memory and the batcher can cut the output
+            // between rows.
+            if (!right_stream.has()) {
+                left_matched = false;
+                for (const datum_t &right_row : right_rows) {
+                    if (predicate->call(env, left_row, right_row)->as_bool()) {
+                        emit(left_row, &right_row);
+                        left_matched = true;
+                    }
+                }
+                if (right_remainder.has()) {
+                    right_stream = std::move(right_remainder);
+                    right_remainder.reset();
+                } else {
+                    right_stream = right_func->call(env)->as_seq(env);
+                    for (size_t i = 0; i < right_rows.size(); ++i) {
+                        if (!right_stream->next(env, batchspec).has()) {
+                            break;
+                        }
+                    }
+                }
+            }
+            datum_t right_row = right_stream->next(env, batchspec);
+            if (right_row.has()) {
+                if (predicate->call(env, left_row, right_row)->as_bool()) {
+                    emit(left_row, &right_row);
+                    left_matched = true;
+                }
+                continue;
+            }
+            right_stream.reset();
+        } else {
+            left_matched = false;
+            datum_t key;
+            if (has_right_index && left_row.get_type() == datum_t::R_OBJECT) {
+                key = left_row.get_field(left_field, NOTHROW);
+            }
+            if (key.has()) {
+                auto it = right_index.find(key);
+                if (it != right_index.end()) {
+                    for (size_t i : it->second) {
+                        emit(left_row, &right_rows[i]);
+                    }
+                    left_matched = true;
+                }
+            } else {
+                for (const datum_t &right_row : right_rows) {
+                    if (predicate->call(env, left_row, right_row)->as_bool()) {
+                        emit(left_row, &right_row);
+                        left_matched = true;
+                    }
+                }
+            }
+        }
+        if (outer && !left_matched) {
+            emit(left_row, nullptr);
+        }
+        ++left_pos;
+    }
+    return res;
+}
+
+bool hash_join_datum_stream_t::is_exhausted() const {
+    return stream->is_exhausted()
+        && left_pos == left_batch.size()
+        && batch_cache_exhausted();
+}
+
 fold_datum_stream_t::fold_datum_stream_t(
     counted_t<datum_stream_t> &&_stream,
     datum_t _base,
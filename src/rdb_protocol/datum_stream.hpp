@@ -9,6 +9,7 @@
 #include <queue>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -21,6 +22,7 @@
 #include "containers/scoped.hpp"
 #include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/context.hpp"
+#include "rdb_protocol/datum_utils.hpp"
 #include "rdb_protocol/math_utils.hpp"
 #include "rdb_protocol/order_util.hpp"
 #include "rdb_protocol/protocol.hpp"
@@ -261,6 +263,51 @@ private:
     std::vector<datum_t> data;
 };
 
+/* `external_sort_datum_stream_t` implements unindexed `order_by`s of sequences that are
+too big to sort in memory. The input is handed to it in pieces with `add_run()`, each of
+which is sorted in memory and written to a temporary disk-backed queue as a sorted run;
+`next_raw_batch()` then merges the runs lazily. To bound the number of open files and the
+memory used for merging, at most `MAX_RUNS` runs are kept at a time: when there would be
+more, the existing runs are first merged into a single bigger one. */
+class external_sort_datum_stream_t : public eager_datum_stream_t {
+public:
+    static const size_t MAX_RUNS = 16;
+
+    external_sort_datum_stream_t(io_backender_t *io_backender,
+                                 const base_path_t &base_path,
+                                 lt_cmp_t lt_cmp,
+                                 backtrace_id_t bt);
+    ~external_sort_datum_stream_t();
+
+    // Must not be called once the stream has started returning rows.
+    void add_run(env_t *env, std::vector<datum_t> &&rows);
+
+    bool is_array() const final { return false; }
+    bool is_infinite() const final { return false; }
+    bool is_exhausted() const final;
+    feed_type_t cfeed_type() const final { return feed_type_t::not_feed; }
+
+    std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+private:
+    class run_t;
+
+    // Merges all of `runs` into a single run.
+    void merge_runs(env_t *env);
+    // Returns the index of the run with the smallest next row, or `runs.size()` if
+    // all runs are exhausted. Ties go to the earlier run, which keeps the sort stable.
+    size_t min_run(env_t *env, profile::sampler_t *sampler);
+
+    io_backender_t *io_backender;
+    base_path_t base_path;
+    lt_cmp_t lt_cmp;
+
+    perfmon_collection_t perfmon_collection;
+    std::vector<scoped_ptr_t<run_t> > runs;
+    size_t rows_left;
+};
+
 struct coro_info_t;
 class coro_stream_t;
 
@@ -987,6 +1034,84 @@ private:
     feed_type_t eq_join_type;
 };
 
+/* `hash_join_datum_stream_t` implements `inner_join` and `outer_join`. It's either given
+the rows of the right-hand sequence, which the join term evaluates once when they fit
+under the array size limit, or the rows it read before reaching the limit together with
+a function that evaluates the right-hand sequence again.
+In the first case, if the predicate is an equality between a field of the left row and a
+field of the right row, the caller can also index the right rows by the value of their
+field with `set_right_index()`; each left row is then matched by looking up the value of
+its own field instead of by calling the predicate once per pair of rows. Otherwise, and
+for left rows that don't have the field, every left row is matched by calling the
+predicate on every right row, like the nested loop that the join terms used to rewrite
+into. When the right-hand sequence is evaluated again, each left row is matched against
+the rows that were read first, and then against the rest of the sequence, which is
+streamed and never held in memory. The first left row continues on the stream the join
+term was reading from, given with `set_right_remainder()`; later ones skip over the rows
+that were read first. */
+class hash_join_datum_stream_t : public eager_datum_stream_t {
+public:
+    // Indices into the right rows, in order, by the value of the right join field.
+    typedef std::unordered_map<datum_t, std::vector<size_t>,
+                               optional_datum_hash_t, optional_datum_equal_t>
+        right_index_t;
+
+    hash_join_datum_stream_t(counted_t<datum_stream_t> _stream,
+                             std::vector<datum_t> &&_right_rows,
+                             counted_t<const func_t> _predicate,
+                             bool _outer,
+                             backtrace_id_t bt);
+    hash_join_datum_stream_t(counted_t<datum_stream_t> _stream,
+                             std::vector<datum_t> &&_right_prefix,
+                             counted_t<const func_t> _right_func,
+                             counted_t<const func_t> _predicate,
+                             bool _outer,
+                             backtrace_id_t bt);
+
+    void set_right_index(datum_string_t _left_field, right_index_t &&_right_index);
+    void set_right_remainder(counted_t<datum_stream_t> &&_right_remainder);
+
+    bool is_array() const final {
+        return is_array_hash_join;
+    }
+    bool is_infinite() const final {
+        return is_infinite_hash_join;
+    }
+    bool is_exhausted() const final;
+
+    std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    feed_type_t cfeed_type() const final {
+        return hash_join_type;
+    }
+
+private:
+    counted_t<datum_stream_t> stream;
+    std::vector<datum_t> right_rows;
+    counted_t<const func_t> right_func;
+    counted_t<const func_t> predicate;
+    bool outer;
+
+    bool has_right_index;
+    datum_string_t left_field;
+    right_index_t right_index;
+
+    // The left rows that haven't been joined yet, starting at `left_pos`. When
+    // `right_func` is set, `right_stream` is the rest of the right-hand sequence being
+    // streamed for `left_batch[left_pos]` and `left_matched` says if a right row
+    // matched it yet. `right_remainder` is the stream for the first left row.
+    std::vector<datum_t> left_batch;
+    size_t left_pos;
+    counted_t<datum_stream_t> right_remainder;
+    counted_t<datum_stream_t> right_stream;
+    bool left_matched;
+
+    bool is_array_hash_join;
+    bool is_infinite_hash_join;
+    feed_type_t hash_join_type;
+};
+
 class lazy_datum_stream_t : public datum_stream_t {
 public:
     lazy_datum_stream_t(
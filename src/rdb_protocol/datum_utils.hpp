@@ -17,4 +17,26 @@ public:
     }
 };
 
+// Hash and equality for hash tables keyed by data that may be empty, the
+// counterparts of `optional_datum_less_t`.
+class optional_datum_hash_t {
+public:
+    optional_datum_hash_t() { }
+    size_t operator()(const ql::datum_t &d) const {
+        return d.has() ? static_cast<size_t>(d.hash()) : 0;
+    }
+};
+
+class optional_datum_equal_t {
+public:
+    optional_datum_equal_t() { }
+    bool operator()(const ql::datum_t &a, const ql::datum_t &b) const {
+        if (a.has()) {
+            return b.has() && a == b;
+        } else {
+            return !b.has();
+        }
+    }
+};
+
 #endif /* RDB_PROTOCOL_DATUM_UTILS_HPP_ */
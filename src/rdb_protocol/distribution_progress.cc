@@ -50,6 +50,40 @@ double distribution_progress_estimator_t::estimate_progress(
     }
 }
 
+std::vector<key_range_t> distribution_progress_estimator_t::split_range(
+        const key_range_t &range, size_t max_parts) const {
+    guarantee(max_parts > 0);
+    std::vector<key_range_t> parts;
+    const double range_begin = estimate_progress(range.left);
+    const double range_end =
+        range.right.unbounded ? 1.0 : estimate_progress(range.right.key());
+    store_key_t part_left = range.left;
+    if (max_parts > 1 && range_end > range_begin) {
+        const double step = (range_end - range_begin) / max_parts;
+        double next_split = range_begin + step;
+        for (auto it = distribution_counts.upper_bound(range.left);
+             it != distribution_counts.end() && parts.size() + 1 < max_parts;
+             ++it) {
+            if (!range.contains_key(it->first)) {
+                break;
+            }
+            const double progress = estimate_progress(it->first);
+            if (progress >= next_split) {
+                parts.push_back(key_range_t(
+                    key_range_t::closed, part_left, key_range_t::open, it->first));
+                part_left = it->first;
+                while (next_split <= progress) {
+                    next_split += step;
+                }
+            }
+        }
+    }
+    key_range_t last_part = range;
+    last_part.left = part_left;
+    parts.push_back(last_part);
+    return parts;
+}
+
 RDB_IMPL_SERIALIZABLE_2(distribution_progress_estimator_t,
     distribution_counts, distribution_counts_sum);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(distribution_progress_estimator_t);
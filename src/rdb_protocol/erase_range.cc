@@ -95,66 +95,93 @@ continue_bool_t rdb_erase_small_range(
         throw interrupted_exc_t();
     }
 
-    /* Step 2: Erase each key individually and create the corresponding
-       modification reports. */
+    /* Step 2: Erase the keys and create the corresponding modification reports. Keys
+       that are next to each other usually live in the same leaf, so instead of
+       descending from the root once per key, we descend once per leaf and erase all of
+       the collected keys in that leaf while we hold it. */
     const max_block_size_t max_block_size = superblock->cache()->max_block_size();
     rdb_value_sizer_t sizer(max_block_size);
-    for (const auto &key : key_collector.get_collected_keys()) {
+    const std::vector<store_key_t> &keys = key_collector.get_collected_keys();
+    size_t next_key = 0;
+    while (next_key < keys.size()) {
         promise_t<superblock_t *> pass_back_superblock_promise;
         {
             keyvalue_location_t kv_location;
             find_keyvalue_location_for_write(
                 &sizer,
                 superblock,
-                key.btree_key(),
+                keys[next_key].btree_key(),
                 /* don't update subtree recencies as we traverse the tree */
                 repli_timestamp_t::distant_past,
                 deletion_context->balancing_detacher(),
                 &kv_location,
                 NULL /* profile::trace_t */,
                 &pass_back_superblock_promise);
-            btree_slice->stats.pm_keys_set.record();
-            btree_slice->stats.pm_total_keys_set += 1;
 
             // We're still holding a write lock on the superblock, so if the value
             // disappeared since we've populated key_collector, something fishy
             // is going on.
             guarantee(kv_location.value.has());
 
-            // The mod_report we generate is a simple delete. While there is generally
-            // a difference between an erase and a delete (deletes get backfilled,
-            // while an erase is as if the value had never existed), that
-            // difference is irrelevant in the case of secondary indexes.
-            rdb_modification_report_t mod_report;
-            mod_report.primary_key = key;
-            // Get the full data
-            const rdb_value_t *rdb_value = kv_location.value_as<rdb_value_t>();
-            mod_report.info.deleted.first = get_data(rdb_value,
-                                                     buf_parent_t(&kv_location.buf));
-            // Get the inline value
-            mod_report.info.deleted.second.assign(rdb_value->value_ref(),
-                rdb_value->value_ref() + rdb_value->inline_size(max_block_size));
-            mod_reports_out->push_back(mod_report);
-
-            // Detach the value
-            deletion_context->in_tree_deleter()->delete_value(
-                buf_parent_t(&kv_location.buf), kv_location.value.get());
-            // Erase the entry from the leaf node
-            kv_location.value.reset();
-            null_key_modification_callback_t null_cb;
-            apply_keyvalue_change(&sizer, &kv_location, key.btree_key(),
-                                  repli_timestamp_t::invalid /* ignored for erase */,
-                                  deletion_context->in_tree_deleter(),
-                                  &null_cb,
-                                  delete_mode_t::ERASE);
+            std::vector<store_key_t> leaf_keys;
+            scoped_malloc_t<void> value = std::move(kv_location.value);
+            for (;;) {
+                const store_key_t &key = keys[next_key];
+                btree_slice->stats.pm_keys_set.record();
+                btree_slice->stats.pm_total_keys_set += 1;
+
+                // The mod_report we generate is a simple delete. While there is
+                // generally a difference between an erase and a delete (deletes get
+                // backfilled, while an erase is as if the value had never existed),
+                // that difference is irrelevant in the case of secondary indexes.
+                rdb_modification_report_t mod_report;
+                mod_report.primary_key = key;
+                // Get the full data
+                const rdb_value_t *rdb_value =
+                    static_cast<const rdb_value_t *>(value.get());
+                mod_report.info.deleted.first = get_data(rdb_value,
+                                                         buf_parent_t(&kv_location.buf));
+                // Get the inline value
+                mod_report.info.deleted.second.assign(rdb_value->value_ref(),
+                    rdb_value->value_ref() + rdb_value->inline_size(max_block_size));
+                mod_reports_out->push_back(mod_report);
+
+                // Detach the value
+                deletion_context->in_tree_deleter()->delete_value(
+                    buf_parent_t(&kv_location.buf), value.get());
+                leaf_keys.push_back(key);
+                ++next_key;
+
+                // Keep going as long as the next key is in the same leaf.
+                if (next_key == keys.size()) {
+                    break;
+                }
+                bool key_found;
+                {
+                    buf_read_t read(&kv_location.buf);
+                    key_found = leaf::lookup(
+                        &sizer,
+                        static_cast<const leaf_node_t *>(read.get_data_read()),
+                        keys[next_key].btree_key(),
+                        value.get());
+                }
+                if (!key_found) {
+                    break;
+                }
+            }
+
+            // Erase the entries from the leaf node
+            erase_keyvalues_from_leaf(&sizer, &kv_location, leaf_keys,
+                                      deletion_context->in_tree_deleter());
         } // kv_location is destroyed here. That's important because sometimes
           // pass_back_superblock_promise isn't pulsed before the kv_location
           // gets deleted.
         guarantee(pass_back_superblock_promise.wait() == superblock);
 
-        guarantee(key >= deleted_out->right.key());
+        const store_key_t &last_key = keys[next_key - 1];
+        guarantee(last_key >= deleted_out->right.key());
         *deleted_out = key_range_t(key_range_t::closed, key_range.left,
-                                   key_range_t::closed, key);
+                                   key_range_t::closed, last_key);
 
         if (interruptor->is_pulsed()) {
             /* Note: We have to check the interruptor at the beginning or the end of the
@@ -33,8 +33,12 @@ struct always_true_key_tester_t : public key_tester_t {
     }
 };
 
-/* `rdb_erase_small_range` has a complexity of O(log n * m) where n is the size of
-the btree, and m is the number of documents actually being deleted.
+/* `rdb_erase_small_range` has a complexity of O(log n * l + m) where n is the size of
+the btree, m is the number of documents actually being deleted and l is the number of
+leaf nodes that they are stored in. It descends from the root once per leaf rather than
+once per document. A leaf whose entries are all being erased is dropped from its parent
+as a whole rather than emptied and merged into a sibling. Every value is still read once,
+because the secondary indexes need the old documents and blobs have to be detached.
 
 It also requires O(m) memory.
 
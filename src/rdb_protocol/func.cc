@@ -99,6 +99,314 @@ bool reql_func_t::is_simple_selector() const {
     return body->is_simple_selector();
 }
 
+bool field_comparison_t::test(const datum_t &row, bool *result_out) const {
+    if (row.get_type() != datum_t::R_OBJECT) {
+        return false;
+    }
+    // Rows that were read from disk are only deserialized lazily, so this doesn't
+    // materialize the rest of the row.
+    datum_t lhs = row.get_field(field, NOTHROW);
+    if (!lhs.has()) {
+        return false;
+    }
+    // These must match `predicate_term_t`.
+    switch (static_cast<int>(op)) {
+    case Term::EQ: *result_out = lhs == value; break;
+    case Term::NE: *result_out = !(lhs == value); break;
+    case Term::LT: *result_out = lhs.cmp(value) < 0; break;
+    case Term::LE: *result_out = lhs.cmp(value) <= 0; break;
+    case Term::GT: *result_out = lhs.cmp(value) > 0; break;
+    case Term::GE: *result_out = lhs.cmp(value) >= 0; break;
+    default: unreachable();
+    }
+    return true;
+}
+
+bool field_paths_t::extract(const datum_t &row, datum_t *result_out) const {
+    std::vector<datum_t> values;
+    values.reserve(paths.size());
+    for (const auto &path : paths) {
+        datum_t value = row;
+        for (const datum_string_t &field : path) {
+            // Other types have their own semantics for `(field)`, e.g. arrays pluck
+            // the field from each element.
+            if (value.get_type() != datum_t::R_OBJECT) {
+                return false;
+            }
+            value = value.get_field(field, NOTHROW);
+            if (!value.has()) {
+                return false;
+            }
+        }
+        values.push_back(std::move(value));
+    }
+    if (is_array) {
+        *result_out = datum_t(std::move(values), configured_limits_t::unlimited);
+    } else {
+        guarantee(values.size() == 1);
+        *result_out = std::move(values[0]);
+    }
+    return true;
+}
+
+// Returns `true` if `term` is a reference to the argument number `index` of a function
+// with the argument names `arg_names`.
+bool is_func_arg(const raw_term_t &term,
+                 const std::vector<sym_t> &arg_names,
+                 size_t index) {
+    switch (static_cast<int>(term.type())) {
+    case Term::IMPLICIT_VAR:
+        return index == 0 && function_emits_implicit_variable(arg_names);
+    case Term::VAR: {
+        if (index >= arg_names.size()
+            || term.num_args() != 1
+            || term.arg(0).type() != Term::DATUM) {
+            return false;
+        }
+        datum_t name = term.arg(0).datum();
+        return name.get_type() == datum_t::R_NUM
+            && name.as_num() == static_cast<double>(arg_names[index].value);
+    }
+    default:
+        return false;
+    }
+}
+
+// Returns `true` if `term` is `arg(field)` or `arg.get_field(field)` with a constant
+// string `field`, where `arg` is the argument number `index`.
+bool is_field_of_func_arg(const raw_term_t &term,
+                          const std::vector<sym_t> &arg_names,
+                          size_t index,
+                          datum_string_t *field_out) {
+    if (term.type() != Term::BRACKET && term.type() != Term::GET_FIELD) {
+        return false;
+    }
+    if (term.num_args() != 2 || term.num_optargs() != 0
+        || !is_func_arg(term.arg(0), arg_names, index)
+        || term.arg(1).type() != Term::DATUM) {
+        return false;
+    }
+    datum_t field = term.arg(1).datum();
+    if (field.get_type() != datum_t::R_STR) {
+        return false;
+    }
+    *field_out = field.as_str();
+    return true;
+}
+
+// Returns `true` if `term` is a chain of constant fields like `row(a)(b)` on the first
+// argument of a function with the argument names `arg_names`, and appends the fields to
+// `path_out`.
+bool get_field_path(const raw_term_t &term,
+                    const std::vector<sym_t> &arg_names,
+                    std::vector<datum_string_t> *path_out) {
+    if (term.type() != Term::BRACKET && term.type() != Term::GET_FIELD) {
+        return false;
+    }
+    if (term.num_args() != 2 || term.num_optargs() != 0
+        || term.arg(1).type() != Term::DATUM) {
+        return false;
+    }
+    datum_t field = term.arg(1).datum();
+    if (field.get_type() != datum_t::R_STR) {
+        return false;
+    }
+    if (!is_func_arg(term.arg(0), arg_names, 0)
+        && !get_field_path(term.arg(0), arg_names, path_out)) {
+        return false;
+    }
+    path_out->push_back(field.as_str());
+    return true;
+}
+
+bool reql_func_t::get_field_paths(field_paths_t *out) const {
+    if (arg_names.size() != 1) {
+        return false;
+    }
+    const raw_term_t &src = body->get_src();
+    field_paths_t res;
+    if (src.type() == Term::MAKE_ARRAY) {
+        if (src.num_args() == 0 || src.num_optargs() != 0) {
+            return false;
+        }
+        res.is_array = true;
+        res.paths.resize(src.num_args());
+        for (size_t i = 0; i < src.num_args(); ++i) {
+            if (!get_field_path(src.arg(i), arg_names, &res.paths[i])) {
+                return false;
+            }
+        }
+    } else {
+        res.is_array = false;
+        res.paths.resize(1);
+        if (!get_field_path(src, arg_names, &res.paths[0])) {
+            return false;
+        }
+    }
+    *out = std::move(res);
+    return true;
+}
+
+bool reql_func_t::get_field_selector(datum_string_t *field_out) const {
+    return arg_names.size() == 1
+        && is_field_of_func_arg(body->get_src(), arg_names, 0, field_out);
+}
+
+bool reql_func_t::get_field_equality(datum_string_t *field0_out,
+                                     datum_string_t *field1_out) const {
+    const raw_term_t &src = body->get_src();
+    if (arg_names.size() != 2 || src.type() != Term::EQ
+        || src.num_args() != 2 || src.num_optargs() != 0) {
+        return false;
+    }
+    return (is_field_of_func_arg(src.arg(0), arg_names, 0, field0_out)
+            && is_field_of_func_arg(src.arg(1), arg_names, 1, field1_out))
+        || (is_field_of_func_arg(src.arg(0), arg_names, 1, field1_out)
+            && is_field_of_func_arg(src.arg(1), arg_names, 0, field0_out));
+}
+
+bool reql_func_t::get_field_comparison(field_comparison_t *out) const {
+    if (arg_names.size() != 1) {
+        return false;
+    }
+    const raw_term_t &src = body->get_src();
+    Term::TermType op = src.type();
+    Term::TermType flipped_op;
+    switch (static_cast<int>(op)) {
+    case Term::EQ: flipped_op = Term::EQ; break;
+    case Term::NE: flipped_op = Term::NE; break;
+    case Term::LT: flipped_op = Term::GT; break;
+    case Term::LE: flipped_op = Term::GE; break;
+    case Term::GT: flipped_op = Term::LT; break;
+    case Term::GE: flipped_op = Term::LE; break;
+    default: return false;
+    }
+    if (src.num_args() != 2 || src.num_optargs() != 0) {
+        return false;
+    }
+    // The captured scope would only matter if the body referred to other variables,
+    // which a comparison between a field and a constant doesn't.
+    if (src.arg(1).type() == Term::DATUM
+        && is_field_of_func_arg(src.arg(0), arg_names, 0, &out->field)) {
+        out->op = op;
+        out->value = src.arg(1).datum();
+        return true;
+    }
+    if (src.arg(0).type() == Term::DATUM
+        && is_field_of_func_arg(src.arg(1), arg_names, 0, &out->field)) {
+        out->op = flipped_op;
+        out->value = src.arg(0).datum();
+        return true;
+    }
+    return false;
+}
+
+// Appends the variable numbers that the `FUNC` term `func` binds to `vars_out`.
+bool get_func_var_numbers(const raw_term_t &func, std::vector<double> *vars_out) {
+    if (func.num_args() != 2) {
+        return false;
+    }
+    raw_term_t vars = func.arg(0);
+    if (vars.type() == Term::DATUM) {
+        datum_t d = vars.datum();
+        if (d.get_type() != datum_t::R_ARRAY) {
+            return false;
+        }
+        for (size_t i = 0; i < d.arr_size(); ++i) {
+            if (d.get(i).get_type() != datum_t::R_NUM) {
+                return false;
+            }
+            vars_out->push_back(d.get(i).as_num());
+        }
+        return true;
+    } else if (vars.type() == Term::MAKE_ARRAY) {
+        for (size_t i = 0; i < vars.num_args(); ++i) {
+            if (vars.arg(i).type() != Term::DATUM
+                || vars.arg(i).datum().get_type() != datum_t::R_NUM) {
+                return false;
+            }
+            vars_out->push_back(vars.arg(i).datum().as_num());
+        }
+        return true;
+    }
+    return false;
+}
+
+// Returns `true` if `a` and `b` are the same term, up to the numbers of the variables
+// that their functions bind. `vars` maps the variables that are bound around `a` to the
+// corresponding ones around `b`.
+bool terms_are_equivalent(const raw_term_t &a,
+                          const raw_term_t &b,
+                          const std::map<double, double> &vars) {
+    if (a.type() != b.type()
+        || a.num_args() != b.num_args()
+        || a.num_optargs() != b.num_optargs()) {
+        return false;
+    }
+    switch (static_cast<int>(a.type())) {
+    case Term::DATUM:
+        return a.datum() == b.datum();
+    case Term::VAR: {
+        if (a.num_args() != 1
+            || a.arg(0).type() != Term::DATUM
+            || b.arg(0).type() != Term::DATUM) {
+            return false;
+        }
+        datum_t a_var = a.arg(0).datum();
+        datum_t b_var = b.arg(0).datum();
+        if (a_var.get_type() != datum_t::R_NUM || b_var.get_type() != datum_t::R_NUM) {
+            return false;
+        }
+        auto it = vars.find(a_var.as_num());
+        return it != vars.end() && it->second == b_var.as_num();
+    }
+    case Term::FUNC: {
+        std::vector<double> a_vars, b_vars;
+        if (!get_func_var_numbers(a, &a_vars)
+            || !get_func_var_numbers(b, &b_vars)
+            || a_vars.size() != b_vars.size()) {
+            return false;
+        }
+        std::map<double, double> inner_vars = vars;
+        for (size_t i = 0; i < a_vars.size(); ++i) {
+            inner_vars[a_vars[i]] = b_vars[i];
+        }
+        return terms_are_equivalent(a.arg(1), b.arg(1), inner_vars);
+    }
+    default:
+        break;
+    }
+    for (size_t i = 0; i < a.num_args(); ++i) {
+        if (!terms_are_equivalent(a.arg(i), b.arg(i), vars)) {
+            return false;
+        }
+    }
+    bool optargs_equivalent = true;
+    a.each_optarg([&](const raw_term_t &a_optarg, const std::string &name) {
+        boost::optional<raw_term_t> b_optarg = b.optarg(name);
+        if (!b_optarg || !terms_are_equivalent(a_optarg, *b_optarg, vars)) {
+            optargs_equivalent = false;
+        }
+    });
+    return optargs_equivalent;
+}
+
+bool reql_func_t::is_equivalent(const func_t &other) const {
+    const reql_func_t *other_reql = dynamic_cast<const reql_func_t *>(&other);
+    if (other_reql == nullptr
+        || captured_scope.size() != 0
+        || other_reql->captured_scope.size() != 0
+        || arg_names.size() != other_reql->arg_names.size()) {
+        return false;
+    }
+    std::map<double, double> vars;
+    for (size_t i = 0; i < arg_names.size(); ++i) {
+        vars[static_cast<double>(arg_names[i].value)] =
+            static_cast<double>(other_reql->arg_names[i].value);
+    }
+    return terms_are_equivalent(body->get_src(), other_reql->body->get_src(), vars);
+}
+
 js_func_t::js_func_t(const std::string &_js_source,
                      uint64_t timeout_ms,
                      backtrace_id_t _backtrace)
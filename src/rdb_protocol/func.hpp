@@ -27,6 +27,38 @@ namespace ql {
 
 class func_visitor_t;
 
+// Describes a function of the form `function(row) { return row(field) <op> value; }`,
+// where `value` is a constant and `<op>` is one of `eq`, `ne`, `lt`, `le`, `gt` and
+// `ge`. Filters use it to test rows against such predicates without going through the
+// term interpreter. See `func_t::get_field_comparison()`.
+class field_comparison_t {
+public:
+    // Returns `false` without touching `*result_out` if `row` isn't an object or doesn't
+    // have the field. The caller must then call the function the regular way, which
+    // takes care of defaults and errors.
+    bool test(const datum_t &row, bool *result_out) const;
+
+    datum_string_t field;
+    Term::TermType op;
+    datum_t value;
+};
+
+// Describes a function of the form `function(row) { return row(a)(b); }`, or an array
+// of such field paths like `function(row) { return [row(a), row(b)(c)]; }`, with
+// constant fields. Secondary index updates use it to compute index values without going
+// through the term interpreter. See `func_t::get_field_paths()`.
+class field_paths_t {
+public:
+    // Returns `false` without touching `*result_out` if a value along one of the paths
+    // isn't an object or doesn't have the field. The caller must then call the function
+    // the regular way, which takes care of errors.
+    bool extract(const datum_t &row, datum_t *result_out) const;
+
+    std::vector<std::vector<datum_string_t> > paths;
+    // Whether the function returns an array of the paths instead of a single one.
+    bool is_array;
+};
+
 class func_t : public slow_atomic_countable_t<func_t>, public bt_rcheckable_t {
 public:
     virtual ~func_t();
@@ -70,6 +102,36 @@ public:
         return false;
     }
 
+    // Returns `true` and fills in `*out` if the function is a simple field comparison.
+    virtual bool get_field_comparison(UNUSED field_comparison_t *out) const {
+        return false;
+    }
+
+    // Returns `true` and sets `*field_out` if the function is
+    // `function(row) { return row(field); }` with a constant `field`.
+    virtual bool get_field_selector(UNUSED datum_string_t *field_out) const {
+        return false;
+    }
+
+    // Returns `true` and fills in `*out` if the function only selects fields.
+    virtual bool get_field_paths(UNUSED field_paths_t *out) const {
+        return false;
+    }
+
+    // Returns `true` and sets `*field0_out` and `*field1_out` if the function is
+    // `function(a, b) { return a(field0).eq(b(field1)); }` with constant fields.
+    virtual bool get_field_equality(UNUSED datum_string_t *field0_out,
+                                    UNUSED datum_string_t *field1_out) const {
+        return false;
+    }
+
+    // Returns `true` if `other` is the same function as this one, up to the numbers of
+    // the variables that they bind. Functions with a captured scope are never the
+    // same.
+    virtual bool is_equivalent(UNUSED const func_t &other) const {
+        return false;
+    }
+
 protected:
     explicit func_t(backtrace_id_t bt);
 
@@ -110,6 +172,13 @@ public:
 
     bool is_simple_selector() const final;
 
+    bool get_field_comparison(field_comparison_t *out) const final;
+    bool get_field_selector(datum_string_t *field_out) const final;
+    bool get_field_paths(field_paths_t *out) const final;
+    bool get_field_equality(datum_string_t *field0_out,
+                            datum_string_t *field1_out) const final;
+    bool is_equivalent(const func_t &other) const final;
+
 private:
     template <cluster_version_t> friend class wire_func_serialization_visitor_t;
     bool filter_helper(env_t *env, datum_t arg) const;
@@ -34,11 +34,6 @@ public:
         GROUPBY_REDUCE_B,
         GROUPBY_FINAL_OBJ,
         GROUPBY_FINAL_VAL,
-        INNERJOIN_N,
-        INNERJOIN_M,
-        OUTERJOIN_N,
-        OUTERJOIN_M,
-        OUTERJOIN_LST,
         EQJOIN_ROW,
         EQJOIN_V,
         UPDATE_OLDROW,
@@ -176,7 +171,7 @@ public:
 
     template <class T>
     reql_t error(T &&message) {
-        return reql_t(Term::ERROR, std::forward<T>(message));
+        return reql_t(this, Term::ERROR, std::forward<T>(message));
     }
 
     template <class Cond, class Then, class Else>
@@ -38,11 +38,13 @@ scoped_ptr_t<val_t> global_optargs_t::get_optarg(env_t *env, const std::string &
 
 static const std::set<std::string> acceptable_optargs({
     "_EVAL_FLAGS_",
+    "_LIMIT_",
     "_NO_RECURSE_",
     "_SHORTCUT_",
     "array_limit",
     "attempts",
     "auth",
+    "auto_index",
     "base",
     "binary_format",
     "changefeed_queue_size",
@@ -89,6 +91,7 @@ static const std::set<std::string> acceptable_optargs({
     "page",
     "page_limit",
     "params",
+    "presorted",
     "primary_key",
     "primary_replica_tag",
     "profile",
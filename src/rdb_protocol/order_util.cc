@@ -1,8 +1,10 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "rdb_protocol/order_util.hpp"
 
+#include <algorithm>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
@@ -143,4 +145,70 @@ bool lt_cmp_t::operator()(env_t *env,
     return false;
 }
 
+bool lt_cmp_t::sort_key(env_t *env, datum_t row, std::string *key_out) const {
+    key_out->clear();
+    for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+        const size_t start = key_out->size();
+        datum_t val;
+        try {
+            val = it->second->call(env, row)->as_datum();
+        } catch (const base_exc_t &e) {
+            if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+                throw;
+            }
+        }
+        if (!val.has()) {
+            // Missing values sort before everything else, like in `operator()`.
+            key_out->append("\x01\0", 2);
+        } else if (!val.append_sort_key(key_out)) {
+            return false;
+        }
+        if (it->first == DESC) {
+            // No key is a prefix of another one, so inverting the bytes reverses the
+            // order.
+            for (size_t i = start; i < key_out->size(); ++i) {
+                (*key_out)[i] = ~(*key_out)[i];
+            }
+        }
+    }
+    return true;
+}
+
+void stable_sort_rows(env_t *env,
+                      profile::sampler_t *sampler,
+                      const lt_cmp_t &lt_cmp,
+                      std::vector<datum_t> *rows) {
+    // The keys, and the positions of their rows to keep the sort stable.
+    std::vector<std::pair<std::string, size_t> > keys;
+    keys.reserve(rows->size());
+    bool have_keys = true;
+    try {
+        for (size_t i = 0; i < rows->size() && have_keys; ++i) {
+            if (sampler != nullptr) {
+                sampler->new_sample();
+            }
+            keys.push_back(std::make_pair(std::string(), i));
+            have_keys = lt_cmp.sort_key(env, (*rows)[i], &keys.back().first);
+        }
+    } catch (const base_exc_t &) {
+        // `lt_cmp` only evaluates a sort function if the previous ones are equal, so it
+        // might not raise this error at all. Let it decide.
+        have_keys = false;
+    }
+
+    if (!have_keys) {
+        std::stable_sort(rows->begin(), rows->end(),
+                         boost::bind(lt_cmp, env, sampler, _1, _2));
+        return;
+    }
+
+    std::sort(keys.begin(), keys.end());
+    std::vector<datum_t> sorted;
+    sorted.reserve(rows->size());
+    for (const auto &key : keys) {
+        sorted.push_back(std::move((*rows)[key.second]));
+    }
+    rows->swap(sorted);
+}
+
 } // namespace ql
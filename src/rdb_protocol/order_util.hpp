@@ -5,6 +5,7 @@
 
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "errors.hpp"
 
@@ -54,11 +55,24 @@ public:
                     datum_t l,
                     datum_t r) const;
 
+    // Sets `*key_out` to a key for `row` such that comparing the keys of two rows with
+    // `memcmp` orders them the same way as this comparison (see
+    // `datum_t::append_sort_key()`). Returns `false` if `row` has no such key.
+    bool sort_key(env_t *env, datum_t row, std::string *key_out) const;
+
 private:
     const std::vector<std::pair<order_direction_t, counted_t<const func_t> > >
         comparisons;
 };
 
+// Sorts `rows` like `std::stable_sort` with `lt_cmp`. If every row has a sort key, the
+// keys are computed once per row and compared as byte strings, instead of evaluating
+// the sort functions twice for every comparison.
+void stable_sort_rows(env_t *env,
+                      profile::sampler_t *sampler,
+                      const lt_cmp_t &lt_cmp,
+                      std::vector<datum_t> *rows);
+
 } // namespace ql
 
 #endif
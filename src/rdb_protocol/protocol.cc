@@ -11,6 +11,7 @@
 #include "btree/reql_specific.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/pmap.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/disk_backed_queue.hpp"
 #include "rdb_protocol/btree.hpp"
@@ -29,16 +30,70 @@ store_key_t key_max(sorting_t sorting) {
 
 namespace rdb_protocol {
 
-void post_construct_and_drain_queue(
+size_t sindex_post_construction_max_parallelism =
+    SINDEX_POST_CONSTRUCTION_MAX_PARALLELISM;
+
+MUST_USE bool post_construct_and_drain_queue(
         auto_drainer_t::lock_t lock,
         uuid_u sindex_id_to_bring_up_to_date,
-        key_range_t *construction_range_inout,
+        std::vector<key_range_t> *remaining_ranges_inout,
+        size_t parallelism,
         int64_t max_pairs_to_construct,
         store_t *store,
-        scoped_ptr_t<disk_backed_queue_wrapper_t<rdb_modification_report_t> >
-            &&mod_queue)
+        disk_backed_queue_wrapper_t<rdb_modification_report_t> *mod_queue,
+        int64_t *mod_queue_size_out)
     THROWS_NOTHING;
 
+/* Secondary indexes are constructed in multiple sub-ranges of the primary key range at
+the same time, but `needs_post_construction_range` can only describe a single range. So
+we store the range from the leftmost unconstructed key to the end of the key space,
+which might contain keys that have already been constructed. Writes to such keys must
+go through the mod queue rather than being applied to the index directly. */
+key_range_t post_construction_envelope(const std::vector<key_range_t> &remaining_ranges) {
+    for (const key_range_t &range : remaining_ranges) {
+        if (!range.is_empty()) {
+            return key_range_t(
+                key_range_t::closed, range.left, key_range_t::none, store_key_t());
+        }
+    }
+    return key_range_t::empty();
+}
+
+bool is_post_construction_remaining(
+        const std::vector<key_range_t> &remaining_ranges,
+        const store_key_t &key) {
+    for (const key_range_t &range : remaining_ranges) {
+        if (range.contains_key(key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void estimate_post_construction_progress(
+        const distribution_progress_estimator_t &progress_estimator,
+        const std::vector<key_range_t> &ranges,
+        const std::vector<key_range_t> &remaining_ranges,
+        store_t::sindex_construction_progress_t *progress_out) {
+    progress_out->total = progress_estimator.estimate_progress(ranges.front().left);
+    progress_out->ranges.clear();
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        const double begin = progress_estimator.estimate_progress(ranges[i].left);
+        const double end = ranges[i].right.unbounded
+            ? 1.0
+            : progress_estimator.estimate_progress(ranges[i].right.key());
+        const double current = remaining_ranges[i].is_empty()
+            ? end
+            : progress_estimator.estimate_progress(remaining_ranges[i].left);
+        progress_out->total += current - begin;
+        if (end > begin) {
+            progress_out->ranges.push_back((current - begin) / (end - begin));
+        } else {
+            progress_out->ranges.push_back(remaining_ranges[i].is_empty() ? 1.0 : 0.0);
+        }
+    }
+}
+
 /* Creates a queue of operations for the sindex, runs a post construction for
  * the data already in the btree and finally drains the queue. */
 void resume_construct_sindex(
@@ -47,6 +102,7 @@ void resume_construct_sindex(
         store_t *store,
         auto_drainer_t::lock_t store_keepalive) THROWS_NOTHING {
     with_priority_t p(CORO_PRIORITY_SINDEX_CONSTRUCTION);
+    guarantee(construct_range.right.unbounded);
 
     // Block out backfills to improve performance.
     // A very useful side-effect of this is that if a server is added as a new replica
@@ -62,12 +118,19 @@ void resume_construct_sindex(
     // at the same time less efficient).
     rwlock_in_line_t backfill_lock_acq(&store->backfill_postcon_lock, access_t::write);
 
-    // Used by the `jobs` table and `indexStatus` to track the progress of the
-    // construction.
+    // We split the range into sub-ranges with roughly the same number of keys, which
+    // are traversed concurrently.
     distribution_progress_estimator_t progress_estimator(
         store, store_keepalive.get_drain_signal());
-    double current_progress =
-        progress_estimator.estimate_progress(construct_range.left);
+    const std::vector<key_range_t> ranges = progress_estimator.split_range(
+        construct_range, sindex_post_construction_max_parallelism);
+    std::vector<key_range_t> remaining_ranges = ranges;
+
+    // Used by the `jobs` table and `indexStatus` to track the progress of the
+    // construction.
+    store_t::sindex_construction_progress_t current_progress;
+    estimate_post_construction_progress(
+        progress_estimator, ranges, remaining_ranges, &current_progress);
     map_insertion_sentry_t<
         store_t::sindex_context_map_t::key_type,
         store_t::sindex_context_map_t::mapped_type> sindex_context_sentry(
@@ -94,100 +157,124 @@ void resume_construct_sindex(
 
     uuid_u post_construct_id = generate_uuid();
 
-    /* Secondary indexes are constructed in multiple passes, moving through the primary
-    key range from the smallest key to the largest one. In each pass, we handle a
-    certain number of primary keys and put the corresponding entries into the secondary
-    index. While this happens, we use a queue to keep track of any writes to the range
-    we're constructing. We then drain the queue and atomically delete it, before we
-    start the next pass. */
-    const int64_t PAIRS_TO_CONSTRUCT_PER_PASS = 512;
-    key_range_t remaining_range = construct_range;
-    while (!remaining_range.is_empty()) {
-        scoped_ptr_t<disk_backed_queue_wrapper_t<rdb_modification_report_t> > mod_queue;
-        {
-            /* Start a transaction and acquire the sindex_block */
-            write_token_t token;
-            store->new_write_token(&token);
-            scoped_ptr_t<txn_t> txn;
-            scoped_ptr_t<real_superblock_t> superblock;
-            try {
-                store->acquire_superblock_for_write(1,
-                                                    write_durability_t::SOFT,
-                                                    &token,
-                                                    &txn,
-                                                    &superblock,
-                                                    store_keepalive.get_drain_signal());
-            } catch (const interrupted_exc_t &) {
-                return;
-            }
-            buf_lock_t sindex_block(superblock->expose_buf(),
-                                    superblock->get_sindex_block_id(),
-                                    access_t::write);
-            superblock.reset();
-
-            /* We register our modification queue here.
-             * We must register it before calling post_construct_and_drain_queue to
-             * make sure that every changes which we don't learn about in
-             * the concurrent traversal that's started there, we do learn about from the
-             * mod queue. Changes that happen between the mod queue registration and
-             * the parallel traversal will be accounted for twice. That is ok though,
-             * since every modification can be applied repeatedly without causing any
-             * damage (if that should ever not true for any of the modifications, that
-             * modification must be fixed or this code would have to be changed to
-             * account for that). */
-            const int64_t MAX_MOD_QUEUE_MEMORY_BYTES = 8 * MEGABYTE;
-            mod_queue.init(
-                    new disk_backed_queue_wrapper_t<rdb_modification_report_t>(
-                        store->io_backender_,
-                        serializer_filepath_t(
-                            store->base_path_,
-                            "post_construction_" + uuid_to_str(post_construct_id)),
-                        &store->perfmon_collection,
-                        MAX_MOD_QUEUE_MEMORY_BYTES));
-
-            secondary_index_t sindex;
-            bool found_index =
-                get_secondary_index(&sindex_block, sindex_to_construct, &sindex);
-            if (!found_index || sindex.being_deleted) {
-                // The index was deleted. Abort construction.
-                sindex_block.reset_buf_lock();
-                txn->commit();
-                return;
-            }
-
-            new_mutex_in_line_t acq =
-                store->get_in_line_for_sindex_queue(&sindex_block);
-            store->register_sindex_queue(mod_queue.get(), remaining_range, &acq);
-
+    /* We register a queue that keeps track of any writes to the range we're
+    constructing. It stays registered for the whole construction, and covers the range
+    that's stored in the index's `needs_post_construction_range`. */
+    scoped_ptr_t<disk_backed_queue_wrapper_t<rdb_modification_report_t> > mod_queue;
+    {
+        /* Start a transaction and acquire the sindex_block */
+        write_token_t token;
+        store->new_write_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        try {
+            store->acquire_superblock_for_write(1,
+                                                write_durability_t::SOFT,
+                                                &token,
+                                                &txn,
+                                                &superblock,
+                                                store_keepalive.get_drain_signal());
+        } catch (const interrupted_exc_t &) {
+            return;
+        }
+        buf_lock_t sindex_block(superblock->expose_buf(),
+                                superblock->get_sindex_block_id(),
+                                access_t::write);
+        superblock.reset();
+
+        /* We register our modification queue here.
+         * We must register it before calling post_construct_and_drain_queue to
+         * make sure that every changes which we don't learn about in
+         * the concurrent traversal that's started there, we do learn about from the
+         * mod queue. Changes that happen between the mod queue registration and
+         * the parallel traversal will be accounted for twice. That is ok though,
+         * since every modification can be applied repeatedly without causing any
+         * damage (if that should ever not true for any of the modifications, that
+         * modification must be fixed or this code would have to be changed to
+         * account for that). The counts of aggregate indexes are the exception,
+         * `post_construct_and_drain_queue` reconciles them with what the traversal
+         * counted. */
+        const int64_t MAX_MOD_QUEUE_MEMORY_BYTES = 8 * MEGABYTE;
+        mod_queue.init(
+                new disk_backed_queue_wrapper_t<rdb_modification_report_t>(
+                    store->io_backender_,
+                    serializer_filepath_t(
+                        store->base_path_,
+                        "post_construction_" + uuid_to_str(post_construct_id)),
+                    &store->perfmon_collection,
+                    MAX_MOD_QUEUE_MEMORY_BYTES));
+
+        secondary_index_t sindex;
+        bool found_index =
+            get_secondary_index(&sindex_block, sindex_to_construct, &sindex);
+        if (!found_index || sindex.being_deleted) {
+            // The index was deleted. Abort construction.
             sindex_block.reset_buf_lock();
             txn->commit();
+            return;
         }
 
-        // This updates `remaining_range`.
-        post_construct_and_drain_queue(
-            store_keepalive,
-            sindex_to_construct,
-            &remaining_range,
-            PAIRS_TO_CONSTRUCT_PER_PASS,
-            store,
-            std::move(mod_queue));
+        new_mutex_in_line_t acq =
+            store->get_in_line_for_sindex_queue(&sindex_block);
+        store->register_sindex_queue(mod_queue.get(), construct_range, &acq);
 
-        // Update the progress value
-        current_progress = progress_estimator.estimate_progress(remaining_range.left);
+        sindex_block.reset_buf_lock();
+        txn->commit();
+    }
+
+    /* Secondary indexes are constructed in multiple passes, moving through each of the
+    sub-ranges from the smallest key to the largest one. In each pass, we handle a
+    certain number of primary keys in up to `parallelism` sub-ranges and put the
+    corresponding entries into the secondary index. We then drain the queue of writes
+    that happened in the meantime, before we start the next pass.
+
+    We back off to fewer concurrent sub-ranges whenever the table receives a lot of
+    writes during a pass, and slowly go back up while it's idle. */
+    const int64_t PAIRS_TO_CONSTRUCT_PER_PASS = 512;
+    const int64_t MOD_QUEUE_SIZE_HIGH_WATERMARK = 16;
+    size_t parallelism = ranges.size();
+    while (!post_construction_envelope(remaining_ranges).is_empty()) {
+        int64_t mod_queue_size;
+        // This updates `remaining_ranges`, and deregisters the queue if the
+        // construction is complete or was aborted.
+        if (!post_construct_and_drain_queue(
+                store_keepalive,
+                sindex_to_construct,
+                &remaining_ranges,
+                parallelism,
+                PAIRS_TO_CONSTRUCT_PER_PASS,
+                store,
+                mod_queue.get(),
+                &mod_queue_size)) {
+            return;
+        }
+
+        if (mod_queue_size > MOD_QUEUE_SIZE_HIGH_WATERMARK) {
+            parallelism = std::max<size_t>(1, parallelism / 2);
+        } else {
+            parallelism = std::min(ranges.size(), parallelism + 1);
+        }
+
+        // Update the progress values
+        estimate_post_construction_progress(
+            progress_estimator, ranges, remaining_ranges, &current_progress);
     }
 }
 
 /* This function is used by resume_construct_sindex. It traverses the primary btree
-and creates entries in the given secondary index. It then applies outstanding changes
-from the mod_queue and deregisters it. */
-void post_construct_and_drain_queue(
+in up to `parallelism` of the remaining ranges at the same time and creates entries in
+the given secondary index. It then applies outstanding changes from the mod_queue.
+Returns `false` if the construction was aborted. In that case and when the construction
+is complete, the mod_queue is deregistered. */
+bool post_construct_and_drain_queue(
         auto_drainer_t::lock_t lock,
         uuid_u sindex_id_to_bring_up_to_date,
-        key_range_t *construction_range_inout,
+        std::vector<key_range_t> *remaining_ranges_inout,
+        size_t parallelism,
         int64_t max_pairs_to_construct,
         store_t *store,
-        scoped_ptr_t<disk_backed_queue_wrapper_t<rdb_modification_report_t> >
-            &&mod_queue)
+        disk_backed_queue_wrapper_t<rdb_modification_report_t> *mod_queue,
+        int64_t *mod_queue_size_out)
     THROWS_NOTHING {
 
     // `post_construct_secondary_index_range` can post-construct multiple secondary
@@ -198,20 +285,50 @@ void post_construct_and_drain_queue(
     sindexes_to_bring_up_to_date.insert(sindex_id_to_bring_up_to_date);
 
     try {
-        const size_t MOD_QUEUE_SIZE_LIMIT = 16;
-        // This constructs a part of the index and updates `construction_range_inout`
-        // to the range that's still remaining.
-        post_construct_secondary_index_range(
-            store,
-            sindexes_to_bring_up_to_date,
-            construction_range_inout,
-            // Abort if the mod_queue gets larger than the `MOD_QUEUE_SIZE_LIMIT`, or
-            // we've constructed `max_pairs_to_construct` pairs.
-            [&](int64_t pairs_constructed) {
-                return pairs_constructed >= max_pairs_to_construct
-                    || mod_queue->size() > MOD_QUEUE_SIZE_LIMIT;
-            },
-            lock.get_drain_signal());
+        // Pick the leftmost sub-ranges that aren't done yet, so that the
+        // `needs_post_construction_range` of the index shrinks as quickly as possible.
+        std::vector<key_range_t *> active_ranges;
+        for (key_range_t &range : *remaining_ranges_inout) {
+            if (!range.is_empty() && active_ranges.size() < parallelism) {
+                active_ranges.push_back(&range);
+            }
+        }
+
+        // The ranges as they were before this pass, and the rows that the traversal
+        // counted if the index is an aggregate index. We use them to reconcile the
+        // counts with the queue below.
+        const std::vector<key_range_t> ranges_before_pass = *remaining_ranges_inout;
+        std::map<store_key_t, ql::datum_t> counted_rows;
+
+        const size_t MOD_QUEUE_SIZE_LIMIT = 16 * active_ranges.size();
+        bool interrupted = false;
+        pmap(active_ranges.size(), [&](size_t i) {
+            try {
+                // This constructs a part of the index and updates the range to the
+                // part that's still remaining.
+                post_construct_secondary_index_range(
+                    store,
+                    sindexes_to_bring_up_to_date,
+                    active_ranges[i],
+                    // Abort if the mod_queue gets larger than the
+                    // `MOD_QUEUE_SIZE_LIMIT`, or we've constructed
+                    // `max_pairs_to_construct` pairs.
+                    [&](int64_t pairs_constructed) {
+                        return pairs_constructed >= max_pairs_to_construct
+                            || mod_queue->size() > MOD_QUEUE_SIZE_LIMIT;
+                    },
+                    &counted_rows,
+                    lock.get_drain_signal());
+            } catch (const interrupted_exc_t &) {
+                interrupted = true;
+            }
+        });
+        if (interrupted) {
+            throw interrupted_exc_t();
+        }
+
+        const key_range_t envelope =
+            post_construction_envelope(*remaining_ranges_inout);
 
         // Drain the queue.
         {
@@ -249,13 +366,14 @@ void post_construct_and_drain_queue(
                     &queue_sindex_block,
                     &sindexes);
 
-            // Pretend that the indexes in `sindexes` have been post-constructed up to
-            // the new range. This is important to make the call to
-            // `rdb_update_sindexes()` below actually update the indexes.
+            // Pretend that the indexes in `sindexes` have been fully post-constructed.
+            // This is important to make the call to `rdb_update_sindexes()` below
+            // actually update the indexes. We check ourselves which keys have been
+            // constructed.
             // We use the same trick in the `post_construct_traversal_helper_t`.
             // TODO: Avoid this hackery (here and in `post_construct_traversal_helper_t`)
             for (auto &&access : sindexes) {
-                access->sindex.needs_post_construction_range = *construction_range_inout;
+                access->sindex.needs_post_construction_range = key_range_t::empty();
             }
 
             if (sindexes.empty()) {
@@ -273,6 +391,18 @@ void post_construct_and_drain_queue(
                 store->get_in_line_for_sindex_queue(&queue_sindex_block);
             acq.acq_signal()->wait_lazily_unordered();
 
+            // The traversal reads a snapshot that is taken after the queue started
+            // collecting writes, so the queue can contain writes to the keys of this
+            // pass that the traversal has already seen. Applying those twice is fine
+            // for regular indexes, but not for the counts of an aggregate index.
+            // Instead we replace the old value of the first write to each of those
+            // keys by the row that the traversal counted (if any). Writes to a key
+            // are queued in order, so from there on every write's old value is the
+            // one the index has counted.
+            const bool reconcile_counted_rows = has_aggregate_sindex(sindexes);
+            std::set<store_key_t> reconciled_keys;
+
+            *mod_queue_size_out = mod_queue->size();
             while (mod_queue->size() > 0) {
                 if (lock.get_drain_signal()->is_pulsed()) {
                     sindexes.clear();
@@ -306,14 +436,25 @@ void post_construct_and_drain_queue(
                     mod_queue->available->unset_callback();
                 }
                 rdb_modification_report_t mod_report = mod_queue->pop();
-                // We only need to apply modifications that fall in the range that
-                // has actually been constructed.
-                // If it's in the range that is still to be constructed we ignore it.
-                if (!construction_range_inout->contains_key(mod_report.primary_key)) {
+                // We only need to apply modifications that fall in the ranges that
+                // have actually been constructed.
+                // If it's in a range that is still to be constructed we ignore it.
+                if (!is_post_construction_remaining(*remaining_ranges_inout,
+                                                    mod_report.primary_key)) {
+                    if (reconcile_counted_rows
+                        && is_post_construction_remaining(ranges_before_pass,
+                                                          mod_report.primary_key)
+                        && reconciled_keys.insert(mod_report.primary_key).second) {
+                        auto it = counted_rows.find(mod_report.primary_key);
+                        mod_report.info.deleted = std::make_pair(
+                            it == counted_rows.end() ? ql::datum_t() : it->second,
+                            std::vector<char>());
+                    }
                     rdb_post_construction_deletion_context_t deletion_context;
                     rdb_update_sindexes(store,
                                         sindexes,
                                         &mod_report,
+                                        repli_timestamp_t::distant_past,
                                         queue_txn.get(),
                                         &deletion_context,
                                         NULL,
@@ -323,17 +464,23 @@ void post_construct_and_drain_queue(
             }
 
             // Mark parts of the index up to date (except for what remains in
-            // `construction_range_inout`).
+            // `envelope`).
             store->mark_index_up_to_date(sindex_id_to_bring_up_to_date,
                                          &queue_sindex_block,
-                                         *construction_range_inout);
-            store->deregister_sindex_queue(mod_queue.get(), &acq);
+                                         envelope);
+            // Shrink the range of the queue to the new envelope. We do this under the
+            // same acquisition of the sindex queue line, so no write can slip through
+            // in between.
+            store->deregister_sindex_queue(mod_queue, &acq);
+            if (!envelope.is_empty()) {
+                store->register_sindex_queue(mod_queue, envelope, &acq);
+            }
 
             sindexes.clear();
             queue_sindex_block.reset_buf_lock();
             queue_txn->commit();
 
-            return;
+            return true;
         }
     } catch (const interrupted_exc_t &) {
         // We were interrupted so we just exit. Sindex post construct is in an
@@ -344,7 +491,7 @@ void post_construct_and_drain_queue(
         /* We were interrupted, this means we can't deregister the sindex queue
          * the standard way because it requires blocks. Use the emergency
          * method instead. */
-        store->emergency_deregister_sindex_queue(mod_queue.get());
+        store->emergency_deregister_sindex_queue(mod_queue);
     } else {
         /* The sindexes we were post constructing were all deleted. Time to
          * deregister the queue. */
@@ -373,14 +520,14 @@ void post_construct_and_drain_queue(
 
         new_mutex_in_line_t acq =
             store->get_in_line_for_sindex_queue(&queue_sindex_block);
-        store->deregister_sindex_queue(mod_queue.get(), &acq);
+        store->deregister_sindex_queue(mod_queue, &acq);
 
         queue_sindex_block.reset_buf_lock();
         queue_txn->commit();
     }
+    return false;
 }
 
-
 bool range_key_tester_t::key_should_be_erased(const btree_key_t *key) {
     uint64_t h = hash_region_hasher(key);
     return delete_range->beg <= h && h < delete_range->end
@@ -732,6 +879,9 @@ void rdb_r_unshard_visitor_t::operator()(const changefeed_subscribe_t &) {
         for (auto it = res->addrs.begin(); it != res->addrs.end(); ++it) {
             out->addrs.insert(std::move(*it));
         }
+        for (auto it = res->point_addrs.begin(); it != res->point_addrs.end(); ++it) {
+            out->point_addrs.insert(std::move(*it));
+        }
         for (auto it = res->server_uuids.begin();
              it != res->server_uuids.end(); ++it) {
             out->server_uuids.insert(std::move(*it));
@@ -956,6 +1106,26 @@ void rdb_r_unshard_visitor_t::unshard_range_batch(const query_t &q, sorting_t so
 }
 
 void rdb_r_unshard_visitor_t::operator()(const distribution_read_t &dg) {
+    if (static_cast<bool>(dg.sindex_id)) {
+        // Every shard has its own copy of the index with the entries for its own
+        // rows, and they all span the whole range of secondary keys. So the counts
+        // add up rather than being stitched together by region.
+        distribution_read_response_t res;
+        for (size_t i = 0; i < count; ++i) {
+            auto result =
+                boost::get<distribution_read_response_t>(&responses[i].response);
+            guarantee(result != NULL, "Bad boost::get\n");
+            for (const auto &pair : result->key_counts) {
+                res.key_counts[pair.first] += pair.second;
+            }
+        }
+        if (dg.result_limit > 0 && res.key_counts.size() > dg.result_limit) {
+            scale_down_distribution(dg.result_limit, &res.key_counts);
+        }
+        response_out->response = res;
+        return;
+    }
+
     // TODO: do this without copying so much and/or without dynamic memory
     // Sort results by region
     std::vector<distribution_read_response_t> results(count);
@@ -1264,7 +1434,8 @@ struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
                                             temp_conflict_func,
                                             bi.limits,
                                             bi.serializable_env,
-                                            bi.return_changes);
+                                            bi.return_changes,
+                                            bi.presorted);
             return true;
         } else {
             return false;
@@ -1322,12 +1493,14 @@ batched_insert_t::batched_insert_t(
         const boost::optional<counted_t<const ql::func_t> > &_conflict_func,
         const ql::configured_limits_t &_limits,
         serializable_env_t s_env,
-        return_changes_t _return_changes)
+        return_changes_t _return_changes,
+        presorted_t _presorted)
         : inserts(std::move(_inserts)), pkey(_pkey),
           conflict_behavior(_conflict_behavior),
           limits(_limits),
           serializable_env(std::move(s_env)),
-          return_changes(_return_changes) {
+          return_changes(_return_changes),
+          presorted(_presorted) {
     r_sanity_check(inserts.size() != 0);
 
     if (_conflict_func) {
@@ -1471,8 +1644,8 @@ RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
     rget_read_response_t, stamp_response, result, reql_version);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(nearest_geo_read_response_t, results_or_error);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(distribution_read_response_t, region, key_counts);
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
-    changefeed_subscribe_response_t, server_uuids, addrs);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
+    changefeed_subscribe_response_t, server_uuids, addrs, point_addrs);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
     changefeed_limit_subscribe_response_t, shards, limit_addrs);
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
@@ -1537,10 +1710,11 @@ RDB_IMPL_SERIALIZABLE_8_FOR_CLUSTER(
     table_name,
     sindex_id);
 
-RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
-        distribution_read_t, max_depth, result_limit, region);
+RDB_IMPL_SERIALIZABLE_4_FOR_CLUSTER(
+        distribution_read_t, max_depth, result_limit, region, sindex_id);
 
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_subscribe_t, addr, shard_region);
+RDB_IMPL_SERIALIZABLE_4_FOR_CLUSTER(
+    changefeed_subscribe_t, addr, shard_region, transforms, serializable_env);
 RDB_IMPL_SERIALIZABLE_7_FOR_CLUSTER(
     changefeed_limit_subscribe_t,
     addr,
@@ -1551,7 +1725,7 @@ RDB_IMPL_SERIALIZABLE_7_FOR_CLUSTER(
     region,
     current_shard);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_stamp_t, addr, region);
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_point_stamp_t, addr, key);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(changefeed_point_stamp_t, addr, key, sub_id);
 
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(read_t, read, profile, read_mode);
 
@@ -1570,7 +1744,7 @@ RDB_IMPL_SERIALIZABLE_6_FOR_CLUSTER(
         write_hook,
         serializable_env,
         return_changes);
-RDB_IMPL_SERIALIZABLE_8_FOR_CLUSTER(
+RDB_IMPL_SERIALIZABLE_9_FOR_CLUSTER(
         batched_insert_t,
         inserts,
         pkey,
@@ -1579,7 +1753,8 @@ RDB_IMPL_SERIALIZABLE_8_FOR_CLUSTER(
         conflict_func,
         limits,
         serializable_env,
-        return_changes);
+        return_changes,
+        presorted);
 
 RDB_IMPL_SERIALIZABLE_3_SINCE_v1_13(point_write_t, key, data, overwrite);
 RDB_IMPL_SERIALIZABLE_1_SINCE_v1_13(point_delete_t, key);
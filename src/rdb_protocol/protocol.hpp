@@ -93,6 +93,11 @@ void resume_construct_sindex(
         auto_drainer_t::lock_t store_keepalive)
     THROWS_NOTHING;
 
+/* `resume_construct_sindex()` traverses at most this many sub-ranges of the primary key
+range concurrently. It's `SINDEX_POST_CONSTRUCTION_MAX_PARALLELISM`, except in unit tests
+that compare a serial construction with a parallel one. */
+extern size_t sindex_post_construction_max_parallelism;
+
 } // namespace rdb_protocol
 
 struct point_read_response_t {
@@ -168,6 +173,7 @@ struct changefeed_subscribe_response_t {
     changefeed_subscribe_response_t() { }
     std::set<uuid_u> server_uuids;
     std::set<ql::changefeed::server_t::addr_t> addrs;
+    std::set<ql::changefeed::server_t::point_addr_t> point_addrs;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_subscribe_response_t);
 
@@ -436,6 +442,10 @@ public:
     int max_depth;
     size_t result_limit;
     region_t region;
+    /* If set, the read returns the distribution of this secondary index instead of
+    the primary B-tree's. The keys are secondary index keys then, and aren't limited
+    to `region`. */
+    boost::optional<std::string> sindex_id;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(distribution_read_t);
 
@@ -443,8 +453,19 @@ struct changefeed_subscribe_t {
     changefeed_subscribe_t() { }
     explicit changefeed_subscribe_t(ql::changefeed::client_t::addr_t _addr)
         : addr(_addr), shard_region(region_t::universe()) { }
+    changefeed_subscribe_t(ql::changefeed::client_t::addr_t _addr,
+                           std::vector<ql::transform_variant_t> _transforms,
+                           serializable_env_t s_env)
+        : addr(_addr),
+          shard_region(region_t::universe()),
+          transforms(std::move(_transforms)),
+          serializable_env(std::move(s_env)) { }
     ql::changefeed::client_t::addr_t addr;
     region_t shard_region;
+    // If this isn't empty, the shards apply these transforms to the changes and
+    // only send the ones that are left.
+    std::vector<ql::transform_variant_t> transforms;
+    serializable_env_t serializable_env;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_subscribe_t);
 
@@ -477,6 +498,8 @@ RDB_DECLARE_SERIALIZABLE(changefeed_limit_subscribe_t);
 struct changefeed_point_stamp_t {
     ql::changefeed::client_t::addr_t addr;
     store_key_t key;
+    // Identifies the point changefeed, so it can later be removed from the shard.
+    uuid_u sub_id;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_point_stamp_t);
 
@@ -610,7 +633,8 @@ struct batched_insert_t {
         const boost::optional<counted_t<const ql::func_t> > &_conflict_func,
         const ql::configured_limits_t &_limits,
         serializable_env_t s_env,
-        return_changes_t _return_changes);
+        return_changes_t _return_changes,
+        presorted_t _presorted);
 
     std::vector<ql::datum_t> inserts;
     std::string pkey;
@@ -620,6 +644,7 @@ struct batched_insert_t {
     ql::configured_limits_t limits;
     serializable_env_t serializable_env;
     return_changes_t return_changes;
+    presorted_t presorted;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(batched_insert_t);
 
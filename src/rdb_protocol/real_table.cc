@@ -23,6 +23,55 @@ const std::string &real_table_t::get_pkey() const {
     return pkey;
 }
 
+bool real_table_t::estimate_index_fraction(
+        ql::env_t *env,
+        const std::string &index,
+        const key_range_t &range,
+        double *fraction_out) {
+    /* Two levels of the B-trees are plenty to tell a selective range from one that
+    covers most of the index, and they're usually cached. */
+    static const int depth = 2;
+    static const size_t limit = 128;
+    distribution_read_t inner_read(depth, limit);
+    if (index != get_pkey()) {
+        inner_read.sindex_id = index;
+    }
+    read_t read(inner_read, profile_bool_t::DONT_PROFILE, read_mode_t::OUTDATED);
+    read_response_t res;
+    try {
+        namespace_access.get()->read(
+            env->get_user_context(),
+            read,
+            &res,
+            order_token_t::ignore,
+            env->interruptor);
+    } catch (const cannot_perform_query_exc_t &) {
+        return false;
+    } catch (const auth::permission_error_t &) {
+        return false;
+    }
+    const distribution_read_response_t *d_res =
+        boost::get<distribution_read_response_t>(&res.response);
+    r_sanity_check(d_res != nullptr);
+
+    /* Each count covers the keys from its own key up to the next one. We attribute
+    it to the range if it starts inside of it, which is accurate enough once the
+    range covers more than a couple of buckets. */
+    int64_t total = 0;
+    int64_t in_range = 0;
+    for (const auto &pair : d_res->key_counts) {
+        total += pair.second;
+        if (range.contains_key(pair.first)) {
+            in_range += pair.second;
+        }
+    }
+    if (total <= 0) {
+        return false;
+    }
+    *fraction_out = static_cast<double>(in_range) / static_cast<double>(total);
+    return true;
+}
+
 ql::datum_t real_table_t::read_row(
     ql::env_t *env, ql::datum_t pval, read_mode_t read_mode) {
     read_t read(point_read_t(store_key_t(pval.print_primary())),
@@ -296,7 +345,8 @@ ql::datum_t real_table_t::write_batched_insert(
     boost::optional<counted_t<const ql::func_t> > conflict_func,
     return_changes_t return_changes,
     durability_requirement_t durability,
-    ignore_write_hook_t ignore_write_hook) {
+    ignore_write_hook_t ignore_write_hook,
+    presorted_t presorted) {
 
     // Get write_hook function
     boost::optional<counted_t<const ql::func_t> > write_hook =
@@ -314,7 +364,8 @@ ql::datum_t real_table_t::write_batched_insert(
             conflict_func,
             env->limits(),
             env->get_serializable_env(),
-            return_changes);
+            return_changes,
+            presorted);
         write_t w(std::move(write), durability, env->profile(), env->limits());
         write_response_t response;
         write_with_profile(env, &w, &response);
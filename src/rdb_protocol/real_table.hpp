@@ -45,6 +45,12 @@ public:
     namespace_id_t get_id() const;
     const std::string &get_pkey() const;
 
+    bool estimate_index_fraction(
+        ql::env_t *env,
+        const std::string &index,
+        const key_range_t &range,
+        double *fraction_out);
+
     ql::datum_t read_row(ql::env_t *env, ql::datum_t pval, read_mode_t read_mode);
     counted_t<ql::datum_stream_t> read_all(
         ql::env_t *env,
@@ -92,7 +98,8 @@ public:
         boost::optional<counted_t<const ql::func_t> > conflict_func,
         return_changes_t return_changes,
         durability_requirement_t durability,
-        ignore_write_hook_t ignore_write_hook);
+        ignore_write_hook_t ignore_write_hook,
+        presorted_t presorted);
     bool write_sync_depending_on_durability(ql::env_t *env,
         durability_requirement_t durability);
 
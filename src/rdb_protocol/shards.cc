@@ -711,6 +711,50 @@ private:
     }
 };
 
+class count_distinct_terminal_t : public skip_terminal_t<hyperloglog_t> {
+public:
+    explicit count_distinct_terminal_t(const count_distinct_wire_func_t &_f)
+        : skip_terminal_t<hyperloglog_t>(_f, hyperloglog_t()) { }
+private:
+    virtual void maybe_acc(env_t *env,
+                           const datum_t &el,
+                           hyperloglog_t *out,
+                           const acc_func_t &_f) {
+        out->add(_f(env, el));
+    }
+    virtual datum_t unpack(hyperloglog_t *hll) {
+        return datum_t(static_cast<double>(hll->estimate()));
+    }
+    virtual void unshard_impl(env_t *, hyperloglog_t *out, hyperloglog_t *el) {
+        out->merge(*el);
+    }
+};
+
+class percentile_terminal_t : public skip_terminal_t<tdigest_t> {
+public:
+    explicit percentile_terminal_t(const percentile_wire_func_t &_f)
+        : skip_terminal_t<tdigest_t>(_f, tdigest_t()),
+          percentile(_f.percentile) { }
+private:
+    virtual void maybe_acc(env_t *env,
+                           const datum_t &el,
+                           tdigest_t *out,
+                           const acc_func_t &_f) {
+        out->add(_f(env, el).as_num());
+    }
+    virtual datum_t unpack(tdigest_t *digest) {
+        rcheck_datum(!digest->empty(), base_exc_t::NON_EXISTENCE,
+                     "Cannot take the percentile of an empty stream.  (If you passed "
+                     "`percentile` a field name, it may be that no elements of the "
+                     "stream had that field.)");
+        return datum_t(digest->quantile(percentile / 100));
+    }
+    virtual void unshard_impl(env_t *, tdigest_t *out, tdigest_t *el) {
+        out->merge(*el);
+    }
+    double percentile;
+};
+
 optimizer_t::optimizer_t() { }
 optimizer_t::optimizer_t(const datum_t &_row,
                          const datum_t &_val)
@@ -828,6 +872,12 @@ public:
     T *operator()(const reduce_wire_func_t &f) const {
         return new reduce_terminal_t(f);
     }
+    T *operator()(const count_distinct_wire_func_t &f) const {
+        return new count_distinct_terminal_t(f);
+    }
+    T *operator()(const percentile_wire_func_t &f) const {
+        return new percentile_terminal_t(f);
+    }
     T *operator()(const limit_read_t &lr) const {
         return new limit_append_t(
             lr.is_primary,
@@ -1037,7 +1087,8 @@ public:
         : f(_f.filter_func.compile_wire_func()),
           default_val(_f.default_filter_val
                       ? _f.default_filter_val->compile_wire_func()
-                      : counted_t<const func_t>()) { }
+                      : counted_t<const func_t>()),
+          is_field_comparison(f->get_field_comparison(&field_comparison)) { }
 private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const std::function<datum_t()> &) {
@@ -1045,7 +1096,14 @@ private:
         auto loc = it;
         try {
             for (it = lst->begin(); it != lst->end(); ++it) {
-                if (f->filter_call(env, *it, default_val)) {
+                // Simple predicates like `row('status').eq('active')` are tested
+                // directly against the row; everything else, including rows that
+                // lack the field, goes through the function.
+                bool matches;
+                if (!is_field_comparison || !field_comparison.test(*it, &matches)) {
+                    matches = f->filter_call(env, *it, default_val);
+                }
+                if (matches) {
                     std::swap(*loc, *it);
                     ++loc;
                 }
@@ -1056,6 +1114,8 @@ private:
         lst->erase(loc, lst->end());
     }
     counted_t<const func_t> f, default_val;
+    field_comparison_t field_comparison;
+    bool is_field_comparison;
 };
 
 class concatmap_trans_t : public ungrouped_op_t {
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <limits>
 #include <map>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -19,6 +20,7 @@
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/datum_utils.hpp"
 #include "rdb_protocol/profile.hpp"
+#include "rdb_protocol/sketches.hpp"
 #include "rdb_protocol/wire_func.hpp"
 #include "region/region.hpp"
 #include "stl_utils.hpp"
@@ -34,10 +36,10 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(require_sindexes_t,
 
 namespace ql {
 
-template<class T>
-T groups_to_batch(std::map<datum_t, T, optional_datum_less_t> *g) {
+template<class map_t>
+typename map_t::mapped_type groups_to_batch(map_t *g) {
     if (g->size() == 0) {
-        return T();
+        return typename map_t::mapped_type();
     } else {
         r_sanity_check(g->size() == 1 && !g->begin()->first.has());
         return std::move(g->begin()->second);
@@ -47,7 +49,10 @@ T groups_to_batch(std::map<datum_t, T, optional_datum_less_t> *g) {
 // This stuff previously resided in the protocol, but has been broken out since
 // we want to use this logic in multiple places.
 typedef std::vector<ql::datum_t> datums_t;
-typedef std::map<ql::datum_t, datums_t, optional_datum_less_t> groups_t;
+// The groups of a single batch. Grouping every row looks up its group here, so this
+// is a hash table; the groups are only sorted once they reach a `grouped_t`.
+typedef std::unordered_map<ql::datum_t, datums_t,
+                           optional_datum_hash_t, optional_datum_equal_t> groups_t;
 
 struct rget_item_t {
     rget_item_t() = default;
@@ -182,6 +187,14 @@ template <cluster_version_t W>
 void serialize_grouped(write_message_t *wm, const datums_t &ds) {
     serialize<W>(wm, ds);
 }
+template <cluster_version_t W>
+void serialize_grouped(write_message_t *wm, const hyperloglog_t &hll) {
+    serialize<W>(wm, hll);
+}
+template <cluster_version_t W>
+void serialize_grouped(write_message_t *wm, const tdigest_t &digest) {
+    serialize<W>(wm, digest);
+}
 
 template <cluster_version_t W>
 archive_result_t deserialize_grouped(
@@ -219,6 +232,14 @@ template <cluster_version_t W>
 archive_result_t deserialize_grouped(read_stream_t *s, datums_t *ds) {
     return deserialize<W>(s, ds);
 }
+template <cluster_version_t W>
+archive_result_t deserialize_grouped(read_stream_t *s, hyperloglog_t *hll) {
+    return deserialize<W>(s, hll);
+}
+template <cluster_version_t W>
+archive_result_t deserialize_grouped(read_stream_t *s, tdigest_t *digest) {
+    return deserialize<W>(s, digest);
+}
 
 // This is basically a templated typedef with special serialization.
 template<class T>
@@ -344,6 +365,8 @@ typedef boost::variant<
     grouped_t<std::pair<double, uint64_t> >, // Avg.
     grouped_t<ql::datum_t>, // Reduce (may be NULL)
     grouped_t<optimizer_t>, // min, max
+    grouped_t<hyperloglog_t>, // count_distinct
+    grouped_t<tdigest_t>, // percentile
     grouped_t<stream_t>, // No terminal.
     exc_t // Don't re-order (we don't want this to initialize to an error.)
     > result_t;
@@ -384,7 +407,9 @@ typedef boost::variant<count_wire_func_t,
                        min_wire_func_t,
                        max_wire_func_t,
                        reduce_wire_func_t,
-                       limit_read_t
+                       limit_read_t,
+                       count_distinct_wire_func_t,
+                       percentile_wire_func_t
                        > terminal_variant_t;
 
 class accumulator_t {
@@ -0,0 +1,212 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "rdb_protocol/sketches.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+// The number of bits of the hash that select a register.
+const int HLL_PRECISION = 12;
+const size_t HLL_NUM_REGISTERS = 1 << HLL_PRECISION;
+
+// `datum_t::hash()` is FNV-1a, whose high bits don't depend much on the last bytes of
+// the input. HyperLogLog needs all bits to be well distributed, so we mix them with the
+// finalizer of MurmurHash3.
+uint64_t mix_hash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void hyperloglog_t::add(const datum_t &d) {
+    add_hash(mix_hash(d.hash()));
+}
+
+void hyperloglog_t::add_hash(uint64_t hash) {
+    if (registers.empty()) {
+        auto it = std::lower_bound(hashes.begin(), hashes.end(), hash);
+        if (it == hashes.end() || *it != hash) {
+            hashes.insert(it, hash);
+            if (hashes.size() * sizeof(uint64_t) > HLL_NUM_REGISTERS) {
+                switch_to_registers();
+            }
+        }
+    } else {
+        size_t index = hash >> (64 - HLL_PRECISION);
+        // The position of the first one bit in the remaining bits.
+        uint64_t rest = hash << HLL_PRECISION;
+        uint8_t rank = 1;
+        while (rank <= 64 - HLL_PRECISION && (rest >> 63) == 0) {
+            ++rank;
+            rest <<= 1;
+        }
+        registers[index] = std::max(registers[index], rank);
+    }
+}
+
+void hyperloglog_t::switch_to_registers() {
+    registers.resize(HLL_NUM_REGISTERS, 0);
+    for (uint64_t hash : hashes) {
+        add_hash(hash);
+    }
+    hashes = std::vector<uint64_t>();
+}
+
+void hyperloglog_t::merge(const hyperloglog_t &other) {
+    if (registers.empty() && other.registers.empty()) {
+        std::vector<uint64_t> merged;
+        merged.reserve(hashes.size() + other.hashes.size());
+        std::set_union(hashes.begin(), hashes.end(),
+                       other.hashes.begin(), other.hashes.end(),
+                       std::back_inserter(merged));
+        hashes.swap(merged);
+        if (hashes.size() * sizeof(uint64_t) > HLL_NUM_REGISTERS) {
+            switch_to_registers();
+        }
+    } else {
+        if (registers.empty()) {
+            switch_to_registers();
+        }
+        if (other.registers.empty()) {
+            for (uint64_t hash : other.hashes) {
+                add_hash(hash);
+            }
+        } else {
+            for (size_t i = 0; i < HLL_NUM_REGISTERS; ++i) {
+                registers[i] = std::max(registers[i], other.registers[i]);
+            }
+        }
+    }
+}
+
+uint64_t hyperloglog_t::estimate() const {
+    if (registers.empty()) {
+        return hashes.size();
+    }
+    const double m = HLL_NUM_REGISTERS;
+    double sum = 0;
+    size_t num_zero = 0;
+    for (uint8_t r : registers) {
+        sum += ldexp(1.0, -static_cast<int>(r));
+        num_zero += (r == 0) ? 1 : 0;
+    }
+    const double alpha = 0.7213 / (1 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && num_zero != 0) {
+        // Linear counting is more accurate for small cardinalities. We don't need the
+        // large range correction because our hashes have 64 bits.
+        estimate = m * log(m / num_zero);
+    }
+    return static_cast<uint64_t>(llround(estimate));
+}
+
+// Larger values give more accurate quantiles and more centroids.
+const double TDIGEST_COMPRESSION = 100;
+// How many centroids we collect before compressing them.
+const size_t TDIGEST_BUFFER_SIZE = 5 * TDIGEST_COMPRESSION;
+
+tdigest_t::tdigest_t() : min(0), max(0) { }
+
+void tdigest_t::add(double value) {
+    if (centroids.empty()) {
+        min = max = value;
+    } else {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    centroids.push_back(std::make_pair(value, 1.0));
+    if (centroids.size() > TDIGEST_BUFFER_SIZE) {
+        compress();
+    }
+}
+
+void tdigest_t::merge(const tdigest_t &other) {
+    if (other.centroids.empty()) {
+        return;
+    }
+    if (centroids.empty()) {
+        min = other.min;
+        max = other.max;
+    } else {
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+    centroids.insert(centroids.end(), other.centroids.begin(), other.centroids.end());
+    if (centroids.size() > TDIGEST_BUFFER_SIZE) {
+        compress();
+    }
+}
+
+void tdigest_t::compress() {
+    if (centroids.empty()) {
+        return;
+    }
+    std::sort(centroids.begin(), centroids.end());
+    double total = 0;
+    for (const auto &c : centroids) {
+        total += c.second;
+    }
+
+    std::vector<std::pair<double, double> > compressed;
+    compressed.push_back(centroids[0]);
+    // The total weight of the centroids before `compressed.back()`.
+    double before = 0;
+    for (size_t i = 1; i < centroids.size(); ++i) {
+        std::pair<double, double> *last = &compressed.back();
+        double weight = last->second + centroids[i].second;
+        double q = (before + weight / 2) / total;
+        // Centroids may only grow large where `q * (1 - q)` is large, i.e. away from
+        // the tails of the distribution.
+        double limit = 4 * total * q * (1 - q) / TDIGEST_COMPRESSION;
+        if (weight <= std::max(limit, 1.0)) {
+            last->first += (centroids[i].first - last->first)
+                * (centroids[i].second / weight);
+            last->second = weight;
+        } else {
+            before += last->second;
+            compressed.push_back(centroids[i]);
+        }
+    }
+    centroids.swap(compressed);
+}
+
+double tdigest_t::quantile(double q) {
+    guarantee(!centroids.empty());
+    compress();
+    double total = 0;
+    for (const auto &c : centroids) {
+        total += c.second;
+    }
+    const double target = q * total;
+
+    // We treat every centroid as if its weight was centered on its mean, and
+    // interpolate linearly between those points, and `min` and `max` at the ends.
+    double prev_value = min;
+    double prev_position = 0;
+    double position = 0;
+    for (const auto &c : centroids) {
+        double center = position + c.second / 2;
+        if (target < center) {
+            double fraction = (target - prev_position) / (center - prev_position);
+            return prev_value + (c.first - prev_value) * fraction;
+        }
+        prev_value = c.first;
+        prev_position = center;
+        position += c.second;
+    }
+    if (total <= prev_position) {
+        return max;
+    }
+    double fraction = (target - prev_position) / (total - prev_position);
+    return prev_value + (max - prev_value) * fraction;
+}
+
+}  // namespace ql
@@ -0,0 +1,72 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_SKETCHES_HPP_
+#define RDB_PROTOCOL_SKETCHES_HPP_
+
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "containers/archive/stl_types.hpp"
+#include "rpc/serialize_macros.hpp"
+
+namespace ql {
+
+class datum_t;
+
+/* `hyperloglog_t` estimates the number of distinct values that were added to it in a
+fixed amount of space. Values are added by their `datum_t::hash()`, which is the same on
+every server, so sketches that were built on different shards can be merged.
+
+Small sets are counted exactly by keeping a sorted list of the hashes. Once that list
+would take more space than the registers, the sketch switches to 2^12 one-byte registers,
+which gives a standard error of about 1.6%. */
+class hyperloglog_t {
+public:
+    hyperloglog_t() { }
+
+    void add(const datum_t &d);
+    void merge(const hyperloglog_t &other);
+    uint64_t estimate() const;
+
+    RDB_MAKE_ME_SERIALIZABLE_2(hyperloglog_t, hashes, registers);
+
+private:
+    void add_hash(uint64_t hash);
+    void switch_to_registers();
+
+    // Sorted and without duplicates. Only used while `registers` is empty.
+    std::vector<uint64_t> hashes;
+    std::vector<uint8_t> registers;
+};
+
+/* `tdigest_t` estimates quantiles of a distribution of numbers. It keeps the numbers as
+a list of weighted centroids that are small near the tails of the distribution and large
+in the middle, so extreme quantiles such as the 99th percentile are accurate even though
+the number of centroids is bounded. Digests can be merged by combining their centroids.
+*/
+class tdigest_t {
+public:
+    tdigest_t();
+
+    void add(double value);
+    void merge(const tdigest_t &other);
+    bool empty() const { return centroids.empty(); }
+
+    // `q` must be between 0 and 1, and the digest must not be empty.
+    double quantile(double q);
+
+    RDB_MAKE_ME_SERIALIZABLE_3(tdigest_t, centroids, min, max);
+
+private:
+    void compress();
+
+    // Pairs of mean and weight. They're only sorted by mean right after `compress()`,
+    // new values are appended at the end.
+    std::vector<std::pair<double, double> > centroids;
+    double min, max;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_SKETCHES_HPP_
@@ -1,6 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/store.hpp"
 
+#include <algorithm>
 #include <list>
 
 #include "btree/backfill_debug.hpp"
@@ -138,6 +139,22 @@ void store_t::help_construct_bring_sindexes_up_to_date() {
                 coro_t::spawn_sometime(std::bind(clear_sindex,
                                                  it->second.id, drainer.lock()));
             } else if (!it->second.post_construction_complete()) {
+                // The entries of an aggregate index count rows from the whole key
+                // range, so they can't be cleared for the part that is left. We
+                // construct such an index from scratch instead.
+                sindex_disk_info_t sindex_info;
+                try {
+                    deserialize_sindex_info_or_crash(it->second.opaque_definition,
+                                                     &sindex_info);
+                } catch (const archive_exc_t &e) {
+                    crash("%s", e.what());
+                }
+                if (sindex_info.aggregate == sindex_aggregate_bool_t::AGGREGATE
+                    && it->second.needs_post_construction_range
+                        != key_range_t::universe()) {
+                    it->second.needs_post_construction_range = key_range_t::universe();
+                    set_secondary_index(&sindex_block, it->first, it->second);
+                }
                 coro_t::spawn_sometime(std::bind(&rdb_protocol::resume_construct_sindex,
                                                  it->second.id,
                                                  it->second.needs_post_construction_range,
@@ -157,7 +174,8 @@ scoped_ptr_t<sindex_superblock_t> acquire_sindex_for_read(
     const std::string &table_name,
     const std::string &sindex_id,
     sindex_disk_info_t *sindex_info_out,
-    uuid_u *sindex_uuid_out) {
+    uuid_u *sindex_uuid_out,
+    release_superblock_t release_superblock) {
     rassert(sindex_info_out != NULL);
     rassert(sindex_uuid_out != NULL);
 
@@ -172,7 +190,8 @@ scoped_ptr_t<sindex_superblock_t> acquire_sindex_for_read(
             superblock,
             &sindex_sb,
             &sindex_mapping_data,
-            &sindex_uuid);
+            &sindex_uuid,
+            release_superblock);
         // TODO: consider adding some logic on the machine handling the
         // query to attach a real backtrace here.
         rcheck_toplevel(found, ql::base_exc_t::OP_FAILED,
@@ -193,6 +212,89 @@ scoped_ptr_t<sindex_superblock_t> acquire_sindex_for_read(
     return sindex_sb;
 }
 
+/* A `count()` over all of the documents in the store doesn't need to traverse the
+B-tree, because the B-tree keeps track of its population in the stat block. Returns
+`false` if `rget` isn't such a read. */
+bool count_from_population(store_t *store,
+                           real_superblock_t *superblock,
+                           const rget_read_t &rget,
+                           rget_read_response_t *res) {
+    if (static_cast<bool>(rget.primary_keys)
+        || !rget.transforms.empty()
+        || !static_cast<bool>(rget.terminal)
+        || boost::get<ql::count_wire_func_t>(&*rget.terminal) == nullptr
+        || !region_is_superset(rget.region, store->get_region())) {
+        return false;
+    }
+    int64_t population;
+    if (!get_btree_population(superblock, &population) || population < 0) {
+        return false;
+    }
+    // This is what `count_terminal_t` would have produced.
+    ql::grouped_t<uint64_t> counts;
+    if (population > 0) {
+        counts[ql::datum_t()] = population;
+    }
+    res->result = std::move(counts);
+    return true;
+}
+
+/* `group(index=...).count()` is the only kind of read that an aggregate index can
+answer. */
+bool is_aggregate_read(const rget_read_t &rget) {
+    if (!static_cast<bool>(rget.sindex)
+        || rget.transforms.size() != 1
+        || !static_cast<bool>(rget.terminal)
+        || boost::get<ql::count_wire_func_t>(&*rget.terminal) == nullptr) {
+        return false;
+    }
+    const ql::group_wire_func_t *group =
+        boost::get<ql::group_wire_func_t>(&rget.transforms[0]);
+    return group != nullptr
+        && group->should_append_index()
+        && !group->is_multi()
+        && group->compile_funcs().empty();
+}
+
+/* A partial index only has entries for the rows that pass its filter. A read of one,
+whether of a range or of specific values through `get_all`, must apply the same filter
+first, so that it returns the rows that a read of a full index would. */
+bool repeats_sindex_filter(const rget_read_t &rget,
+                           const ql::map_wire_func_t &sindex_filter) {
+    if (rget.transforms.empty()) {
+        return false;
+    }
+    const ql::filter_wire_func_t *filter =
+        boost::get<ql::filter_wire_func_t>(&rget.transforms[0]);
+    return filter != nullptr
+        && !static_cast<bool>(filter->default_filter_val)
+        && sindex_filter.compile_wire_func()->is_equivalent(
+            *filter->filter_func.compile_wire_func());
+}
+
+/* Looks up the definition of a ready secondary index without releasing `superblock`.
+Returns `false` if there's no such index, or if it isn't ready yet. */
+bool get_ready_sindex_info(real_superblock_t *superblock,
+                           const std::string &sindex_id,
+                           sindex_disk_info_t *sindex_info_out) {
+    secondary_index_t sindex;
+    {
+        buf_lock_t sindex_block(superblock->expose_buf(),
+                                superblock->get_sindex_block_id(),
+                                access_t::read);
+        if (!get_secondary_index(&sindex_block, sindex_name_t(sindex_id), &sindex)
+            || !sindex.is_ready()) {
+            return false;
+        }
+    }
+    try {
+        deserialize_sindex_info_or_crash(sindex.opaque_definition, sindex_info_out);
+    } catch (const archive_exc_t &e) {
+        crash("%s", e.what());
+    }
+    return true;
+}
+
 void do_read(ql::env_t *env,
              store_t *store,
              btree_slice_t *btree,
@@ -207,6 +309,12 @@ void do_read(ql::env_t *env,
         if (sindex_id_out != nullptr) {
             *sindex_id_out = boost::none;
         }
+        if (count_from_population(store, superblock, rget, res)) {
+            if (release_superblock == release_superblock_t::RELEASE) {
+                superblock->release();
+            }
+            return;
+        }
         rdb_rget_slice(
             btree,
             *rget.current_shard,
@@ -222,6 +330,23 @@ void do_read(ql::env_t *env,
             release_superblock);
     } else {
         // rget using a secondary index
+        if (is_aggregate_read(rget)
+            && !region_is_superset(rget.region, store->get_region())) {
+            sindex_disk_info_t aggregate_info;
+            if (get_ready_sindex_info(superblock, rget.sindex->id, &aggregate_info)
+                && aggregate_info.aggregate == sindex_aggregate_bool_t::AGGREGATE) {
+                res->reql_version =
+                    aggregate_info.mapping_version_info.latest_compatible_reql_version;
+                rdb_scan_aggregate_sindex(
+                    superblock,
+                    rget.region.inner,
+                    rget.sindex->datumspec,
+                    aggregate_info,
+                    res,
+                    release_superblock_t::RELEASE);
+                return;
+            }
+        }
         sindex_disk_info_t sindex_info;
         uuid_u sindex_uuid;
         scoped_ptr_t<sindex_superblock_t> sindex_sb;
@@ -234,7 +359,12 @@ void do_read(ql::env_t *env,
                     rget.table_name,
                     rget.sindex->id,
                     &sindex_info,
-                    &sindex_uuid);
+                    &sindex_uuid,
+                    release_superblock_t::KEEP);
+            // Only reference indexes need the primary B-tree for the rest of the read.
+            if (sindex_info.reference == sindex_reference_bool_t::COPY) {
+                superblock->release();
+            }
             if (sindex_id_out != nullptr) {
                 *sindex_id_out = sindex_uuid;
             }
@@ -258,6 +388,92 @@ void do_read(ql::env_t *env,
                     ql::backtrace_id_t::empty());
                 return;
             }
+            if (sindex_info.aggregate == sindex_aggregate_bool_t::AGGREGATE) {
+                if (!is_aggregate_read(rget)) {
+                    res->result = ql::exc_t(
+                        ql::base_exc_t::LOGIC,
+                        strprintf(
+                            "Index `%s` is an aggregate index.  It can only be used "
+                            "by `group` followed by `count`.",
+                            rget.sindex->id.c_str()),
+                        ql::backtrace_id_t::empty());
+                    return;
+                }
+                rdb_read_aggregate_sindex(
+                    sindex_sb.get(),
+                    rget.sindex->datumspec,
+                    sindex_range,
+                    res,
+                    release_superblock_t::RELEASE);
+                return;
+            }
+            if (static_cast<bool>(sindex_info.filter)
+                && !repeats_sindex_filter(rget, *sindex_info.filter)) {
+                res->result = ql::exc_t(
+                    ql::base_exc_t::LOGIC,
+                    strprintf(
+                        "Index `%s` is a partial index.  `between`, `get_all` and "
+                        "`order_by` on it must be followed by `filter` with the "
+                        "index's filter function.",
+                        rget.sindex->id.c_str()),
+                    ql::backtrace_id_t::empty());
+                return;
+            }
+
+            const bool is_reference =
+                sindex_info.reference == sindex_reference_bool_t::REFERENCE;
+            if (is_reference
+                && static_cast<bool>(rget.terminal)
+                && boost::get<ql::limit_read_t>(&*rget.terminal) != nullptr) {
+                // The limit manager of a changefeed reads the index while writes
+                // are applied, when it can't look up rows in the primary B-tree.
+                res->result = ql::exc_t(
+                    ql::base_exc_t::LOGIC,
+                    strprintf(
+                        "Index `%s` is a reference index.  Changefeeds on `limit` "
+                        "can't use a reference index.",
+                        rget.sindex->id.c_str()),
+                    ql::backtrace_id_t::empty());
+                return;
+            }
+            if (sindex_info.change_log_size != 0) {
+                if (static_cast<bool>(rget.terminal)
+                    && boost::get<ql::limit_read_t>(&*rget.terminal) != nullptr) {
+                    // Writes don't maintain limit changefeeds on change log indexes.
+                    res->result = ql::exc_t(
+                        ql::base_exc_t::LOGIC,
+                        strprintf(
+                            "Index `%s` is a change log index.  Changefeeds on "
+                            "`limit` can't use a change log index.",
+                            rget.sindex->id.c_str()),
+                        ql::backtrace_id_t::empty());
+                    return;
+                }
+                const key_range_t &shard_range = rget.current_shard->inner;
+                if (shard_range.left != store_key_t::min()
+                    || shard_range.right.key_or_max() != store_key_t::max()) {
+                    // Each shard has timestamps of its own, so a single resume token
+                    // can't say where to continue on all of them.
+                    res->result = ql::exc_t(
+                        ql::base_exc_t::LOGIC,
+                        strprintf(
+                            "Index `%s` is a change log index.  Change log indexes "
+                            "can only be read on tables with a single shard.",
+                            rget.sindex->id.c_str()),
+                        ql::backtrace_id_t::empty());
+                    return;
+                }
+                if (!rdb_change_log_covers(sindex_sb.get(), sindex_range, sindex_info)) {
+                    res->result = ql::exc_t(
+                        ql::base_exc_t::OP_FAILED,
+                        strprintf(
+                            "The change log of index `%s` doesn't go back that far "
+                            "anymore.  Read the table again instead.",
+                            rget.sindex->id.c_str()),
+                        ql::backtrace_id_t::empty());
+                    return;
+                }
+            }
 
             rdb_rget_secondary_slice(
                 store->get_sindex_slice(sindex_uuid),
@@ -273,8 +489,13 @@ void do_read(ql::env_t *env,
                 rget.sorting,
                 rget.sindex->require_sindex_val,
                 sindex_info,
+                is_reference ? btree : nullptr,
+                is_reference ? superblock : nullptr,
                 res,
                 release_superblock_t::RELEASE);
+            if (release_superblock == release_superblock_t::RELEASE) {
+                superblock->release();
+            }
         } catch (const ql::exc_t &e) {
             res->result = e;
             return;
@@ -292,12 +513,19 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
     void operator()(const changefeed_subscribe_t &s) {
         auto cserver = store->get_or_make_changefeed_server(s.shard_region);
         guarantee(cserver.first != nullptr);
-        cserver.first->add_client(s.addr, s.shard_region, cserver.second);
+        cserver.first->add_client(s.addr,
+                                  s.shard_region,
+                                  ctx,
+                                  s.serializable_env.global_optargs,
+                                  s.serializable_env.user_context,
+                                  s.transforms,
+                                  cserver.second);
         response->response = changefeed_subscribe_response_t();
         auto res = boost::get<changefeed_subscribe_response_t>(&response->response);
         guarantee(res != NULL);
         res->server_uuids.insert(cserver.first->get_uuid());
         res->addrs.insert(cserver.first->get_stop_addr());
+        res->point_addrs.insert(cserver.first->get_point_stop_addr());
     }
 
     void operator()(const changefeed_limit_subscribe_t &s) {
@@ -432,7 +660,8 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             res->resp = changefeed_point_stamp_response_t::valid_response_t();
             auto *vres = &*res->resp;
             if (boost::optional<uint64_t> stamp
-                    = cserver.first->get_stamp(s.addr, cserver.second)) {
+                    = cserver.first->get_point_stamp(
+                        s.addr, s.key, s.sub_id, cserver.second)) {
                 vres->stamp = std::make_pair(cserver.first->get_uuid(), *stamp);
             } else {
                 // The client was removed, so no future messages are coming.
@@ -498,7 +727,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
                     superblock,
                     geo_read.table_name,
                     geo_read.sindex.id,
-                &sindex_info, &sindex_uuid);
+                &sindex_info, &sindex_uuid, release_superblock_t::RELEASE);
         } catch (const ql::exc_t &e) {
             res->result = e;
             return;
@@ -556,7 +785,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
                     superblock,
                     geo_read.table_name,
                     geo_read.sindex_id,
-                &sindex_info, &sindex_uuid);
+                &sindex_info, &sindex_uuid, release_superblock_t::RELEASE);
         } catch (const ql::exc_t &e) {
             res->results_or_error = e;
             return;
@@ -645,6 +874,36 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
     void operator()(const distribution_read_t &dg) {
         response->response = distribution_read_response_t();
         distribution_read_response_t *res = boost::get<distribution_read_response_t>(&response->response);
+        if (static_cast<bool>(dg.sindex_id)) {
+            /* The index's keys aren't partitioned like the primary keys, so they
+            aren't filtered by `dg.region`. If the index doesn't exist or isn't ready
+            on this store, it contributes nothing to the distribution. */
+            scoped_ptr_t<sindex_superblock_t> sindex_sb;
+            std::vector<char> sindex_mapping_data;
+            uuid_u sindex_uuid;
+            bool found;
+            try {
+                found = store->acquire_sindex_superblock_for_read(
+                    sindex_name_t(*dg.sindex_id),
+                    "",
+                    superblock,
+                    &sindex_sb,
+                    &sindex_mapping_data,
+                    &sindex_uuid,
+                    release_superblock_t::RELEASE);
+            } catch (const sindex_not_ready_exc_t &) {
+                found = false;
+            }
+            if (found) {
+                rdb_distribution_get(dg.max_depth, store_key_t::min(),
+                                     sindex_sb.get(), res);
+                if (dg.result_limit > 0 && res->key_counts.size() > dg.result_limit) {
+                    scale_down_distribution(dg.result_limit, &res->key_counts);
+                }
+            }
+            res->region = dg.region;
+            return;
+        }
         rdb_distribution_get(dg.max_depth, dg.region.inner.left,
                              superblock, res);
         for (std::map<store_key_t, int64_t>::iterator it = res->key_counts.begin(); it != res->key_counts.end(); ) {
@@ -802,7 +1061,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
             br.serializable_env,
             trace);
         rdb_modification_report_cb_t sindex_cb(
-            store, &sindex_block,
+            store, &sindex_block, timestamp,
             auto_drainer_t::lock_t(&store->drainer));
 
         counted_t<const ql::func_t> write_hook;
@@ -830,7 +1089,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
 
     void operator()(const batched_insert_t &bi) {
         rdb_modification_report_cb_t sindex_cb(
-            store, &sindex_block,
+            store, &sindex_block, timestamp,
             auto_drainer_t::lock_t(&store->drainer));
         ql::env_t ql_env(
             ctx,
@@ -845,16 +1104,33 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
             keys.emplace_back(it->get_field(datum_string_t(bi.pkey)).print_primary());
         }
-        response->response =
-            rdb_batched_replace(
-                btree_info_t(btree, timestamp, datum_string_t(bi.pkey)),
-                superblock,
-                keys,
-                &replacer,
-                &sindex_cb,
-                bi.limits,
-                sampler,
-                trace);
+        // Even without the `presorted` optarg, a batch whose smallest key lies
+        // beyond the right-hand end of the B-tree is probably an append, and
+        // `rdb_bulk_insert()` checks that it really is one.
+        if (bi.presorted == presorted_t::YES
+            || btree->might_be_append(*std::min_element(keys.begin(), keys.end()))) {
+            response->response =
+                rdb_bulk_insert(
+                    btree_info_t(btree, timestamp, datum_string_t(bi.pkey)),
+                    superblock,
+                    keys,
+                    &replacer,
+                    &sindex_cb,
+                    bi.limits,
+                    sampler,
+                    trace);
+        } else {
+            response->response =
+                rdb_batched_replace(
+                    btree_info_t(btree, timestamp, datum_string_t(bi.pkey)),
+                    superblock,
+                    keys,
+                    &replacer,
+                    &sindex_cb,
+                    bi.limits,
+                    sampler,
+                    trace);
+        }
     }
 
     void operator()(const point_write_t &w) {
@@ -935,7 +1211,7 @@ private:
         // This copying of the mod_report is inefficient, but it seems this
         // function is only used for unit tests at the moment anyway.
         mod_reports.push_back(mod_report);
-        store->update_sindexes(txn, &sindex_block, mod_reports,
+        store->update_sindexes(txn, &sindex_block, mod_reports, timestamp,
                                true /* release_sindex_block */);
     }
 
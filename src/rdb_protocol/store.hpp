@@ -216,11 +216,13 @@ public:
             disk_backed_queue_wrapper_t<rdb_modification_report_t> *disk_backed_queue);
 
     // Updates the live sindexes, and pushes modification reports onto the sindex
-    // queues of non-live indexes.
+    // queues of non-live indexes. `timestamp` is the timestamp of the write that made
+    // the modifications, or `distant_past` if they don't come from a single write.
     void update_sindexes(
             txn_t *txn,
             buf_lock_t *sindex_block,
             const std::vector<rdb_modification_report_t> &mod_reports,
+            repli_timestamp_t timestamp,
             bool release_sindex_block);
 
     void sindex_queue_push(
@@ -248,10 +250,11 @@ public:
     MUST_USE bool acquire_sindex_superblock_for_read(
             const sindex_name_t &name,
             const std::string &table_name,
-            real_superblock_t *superblock,  // releases this.
+            real_superblock_t *superblock,  // releases this, unless told to KEEP it.
             scoped_ptr_t<sindex_superblock_t> *sindex_sb_out,
             std::vector<char> *opaque_definition_out,
-            uuid_u *sindex_uuid_out)
+            uuid_u *sindex_uuid_out,
+            release_superblock_t release_superblock)
         THROWS_ONLY(sindex_not_ready_exc_t);
 
     MUST_USE bool acquire_sindex_superblock_for_write(
@@ -358,12 +361,21 @@ private:
 public:
     namespace_id_t const &get_table_id() const;
 
-    // The `double` is the progress of the secondary index construction.
-    typedef std::map<uuid_u, std::pair<microtime_t, double const *> >
+    // The progress of a secondary index construction. `total` is the progress of the
+    // whole construction and `ranges` has the progress of each of the sub-ranges of the
+    // primary key range that are constructed concurrently. All values are between 0.0
+    // and 1.0.
+    struct sindex_construction_progress_t {
+        double total;
+        std::vector<double> ranges;
+    };
+    typedef std::map<uuid_u,
+                     std::pair<microtime_t, sindex_construction_progress_t const *> >
         sindex_context_map_t;
     sindex_context_map_t *get_sindex_context_map();
 
     double get_sindex_progress(uuid_u const &id);
+    std::vector<double> get_sindex_ranges_progress(uuid_u const &id);
     microtime_t get_sindex_start_time(uuid_u const &id);
 
     fifo_enforcer_source_t main_token_source, sindex_token_source;
@@ -398,6 +410,16 @@ public:
     // `store.cc` can synchronize with the `rdb_modification_report_cb_t` in
     // `btree.cc`.
     rwlock_t cfeed_stamp_lock;
+    // The number of changes in each batch that the changefeed servers send to
+    // their clients.
+    perfmon_sampler_t changefeed_batch_size;
+    perfmon_membership_t changefeed_batch_size_membership;
+    // How often `limit` changefeeds have to go to disk to refill their top `n`,
+    // and how many rows they could refill from memory instead.
+    perfmon_rate_monitor_t changefeed_limit_reads;
+    perfmon_membership_t changefeed_limit_reads_membership;
+    perfmon_rate_monitor_t changefeed_limit_spare_hits;
+    perfmon_membership_t changefeed_limit_spare_hits_membership;
 
 private:
     rdb_context_t *ctx;
@@ -1,7 +1,9 @@
 #include "rdb_protocol/store.hpp"
 
 #include "btree/backfill.hpp"
+#include "btree/bulk_load.hpp"
 #include "btree/reql_specific.hpp"
+#include "containers/archive/buffer_stream.hpp"
 #include "rdb_protocol/btree.hpp"
 
 /* `MAX_CONCURRENT_BACKFILL_ITEMS` is the maximum number of coroutines we'll spawn in
@@ -211,6 +213,60 @@ void apply_item_pair(
     }
 }
 
+/* `bulk_apply_item_pairs()` is a faster alternative to calling `apply_item_pair()` for
+each of the pairs starting at `*next_pair`, for the common case where they all lie past
+the end of the B-tree, e.g. when backfilling into an empty replica. It appends pairs to
+the B-tree through a `btree_bulk_loader_t` until it reaches one that is outside of
+`range`, that is a deletion, or that can't be appended, and advances `*next_pair` past
+the pairs it applied.
+
+Setting up the loader write-locks the right-hand edge of the B-tree, so we only do that
+if the first pair looks like an append according to `btree_slice_t::might_be_append()`.
+Otherwise backfills into different parts of the key range would all serialize on it. */
+void bulk_apply_item_pairs(
+        btree_slice_t *slice,
+        real_superblock_t *superblock,
+        const key_range_t &range,
+        std::vector<backfill_item_t::pair_t> *pairs,
+        size_t *next_pair,
+        std::vector<rdb_modification_report_t> *mod_reports_out) {
+    if (*next_pair == pairs->size()) {
+        return;
+    }
+    const backfill_item_t::pair_t &first_pair = (*pairs)[*next_pair];
+    if (!range.contains_key(first_pair.key) || !static_cast<bool>(first_pair.value) ||
+            !slice->might_be_append(first_pair.key)) {
+        return;
+    }
+    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+    btree_bulk_loader_t loader(&sizer, superblock);
+    for (; *next_pair < pairs->size(); ++*next_pair) {
+        backfill_item_t::pair_t *pair = &(*pairs)[*next_pair];
+        if (!range.contains_key(pair->key) || !static_cast<bool>(pair->value) ||
+                !loader.key_is_appendable(pair->key.btree_key())) {
+            break;
+        }
+        buffer_read_stream_t read_stream(pair->value->data(), pair->value->size());
+        ql::datum_t datum;
+        archive_result_t res = datum_deserialize(&read_stream, &datum);
+        guarantee(res == archive_result_t::SUCCESS);
+        write_message_t wm;
+        wm.append(pair->value->data(), pair->value->size());
+
+        slice->stats.pm_keys_set.record();
+        slice->stats.pm_total_keys_set += 1;
+        mod_reports_out->resize(mod_reports_out->size() + 1);
+        mod_reports_out->back().primary_key = pair->key;
+        rdb_bulk_append(&loader, pair->key, datum, wm, pair->recency,
+            &mod_reports_out->back().info);
+    }
+    store_key_t last_key;
+    if (loader.get_last_key(&last_key)) {
+        slice->note_rightmost_key(last_key);
+    }
+    loader.finish();
+}
+
 /* `apply_single_key_item()` applies a `backfill_item_t` whose range is a single key wide
 and which has a `backfill_item_t::pair_t` for that key. This eliminates the need to erase
 the previous contents of the range.
@@ -352,7 +408,10 @@ void apply_multi_key_item(
             guarantee(range_deleted.right == range_to_delete.right
                 || res == continue_bool_t::CONTINUE);
 
-            /* Apply any pairs from the item that fall within the deleted region */
+            /* Apply any pairs from the item that fall within the deleted region. As
+            many as possible are appended in bulk; the rest are applied one by one. */
+            bulk_apply_item_pairs(tokens.info->slice, superblock.get(), range_deleted,
+                &item.pairs, &next_pair, &mod_reports);
             while (next_pair < item.pairs.size() &&
                     range_deleted.contains_key(item.pairs[next_pair].key)) {
                 promise_t<superblock_t *> pass_back_superblock;
@@ -464,7 +523,8 @@ continue_bool_t store_t::receive_backfill(
                 std::vector<rdb_modification_report_t> &&mod_reports) {
             /* Apply the modifications */
             if (!mod_reports.empty()) {
-                update_sindexes(txn.get(), &sindex_block, mod_reports, true);
+                update_sindexes(txn.get(), &sindex_block, mod_reports,
+                                repli_timestamp_t::distant_past, true);
             } else {
                 sindex_block.reset_buf_lock();
             }
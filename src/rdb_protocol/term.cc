@@ -88,6 +88,8 @@ counted_t<const term_t> compile_on_current_stack(
     case Term::AVG:                return make_avg_term(env, t);
     case Term::MIN:                return make_min_term(env, t);
     case Term::MAX:                return make_max_term(env, t);
+    case Term::COUNT_DISTINCT:     return make_count_distinct_term(env, t);
+    case Term::PERCENTILE:         return make_percentile_term(env, t);
     case Term::UNION:              return make_union_term(env, t);
     case Term::NTH:                return make_nth_term(env, t);
     case Term::BRACKET:            return make_bracket_term(env, t);
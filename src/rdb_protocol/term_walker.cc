@@ -290,6 +290,8 @@ bool term_type_is_valid(Term::TermType type) {
     case Term::AVG:
     case Term::MIN:
     case Term::MAX:
+    case Term::COUNT_DISTINCT:
+    case Term::PERCENTILE:
     case Term::UNION:
     case Term::NTH:
     case Term::BRACKET:
@@ -481,6 +483,8 @@ bool term_is_write_or_meta(Term::TermType type) {
     case Term::AVG:
     case Term::MIN:
     case Term::MAX:
+    case Term::COUNT_DISTINCT:
+    case Term::PERCENTILE:
     case Term::UNION:
     case Term::NTH:
     case Term::BRACKET:
@@ -610,6 +614,8 @@ bool term_forbids_writes(Term::TermType type) {
     case Term::AVG:
     case Term::MIN:
     case Term::MAX:
+    case Term::COUNT_DISTINCT:
+    case Term::PERCENTILE:
         return true;
 
     case Term::DATUM:
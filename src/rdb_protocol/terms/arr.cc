@@ -1,10 +1,13 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/arr.hpp"
 
+#include <unordered_set>
+
 #include "math.hpp"
 #include "parsing/utf8.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/op.hpp"
 #include "stl_utils.hpp"
 
@@ -332,10 +335,41 @@ private:
     virtual const char *name() const { return "slice"; }
 };
 
+/* An unindexed `order_by(...).limit(n)` only needs the first `n` rows of the sorted
+sequence. If `n` is a literal, we pass it to the `order_by` in the hidden `_LIMIT_`
+optarg, so that it can select those rows with a bounded heap instead of sorting the
+whole sequence. */
+raw_term_t pass_limit_to_orderby(const raw_term_t &term) {
+    if (term.num_args() != 2) {
+        return term;
+    }
+    raw_term_t seq = term.arg(0);
+    raw_term_t n = term.arg(1);
+    if (seq.type() != Term::ORDER_BY
+        || seq.num_args() < 1
+        || seq.optarg("index")
+        || seq.optarg("_LIMIT_")
+        || n.type() != Term::DATUM) {
+        return term;
+    }
+
+    minidriver_t r_orderby(seq.bt());
+    minidriver_t::reql_t orderby =
+        r_orderby.expr(seq.arg(0)).call(Term::ORDER_BY);
+    orderby.copy_args_from_term(seq, 1);
+    orderby.copy_optargs_from_term(seq);
+    orderby.add_arg(r_orderby.optarg("_LIMIT_", n));
+
+    minidriver_t r(term.bt());
+    minidriver_t::reql_t limit = r.expr(orderby).call(Term::LIMIT, n);
+    limit.copy_optargs_from_term(term);
+    return limit.root_term();
+}
+
 class limit_term_t : public op_term_t {
 public:
     limit_term_t(compile_env_t *env, const raw_term_t &term)
-        : op_term_t(env, term, argspec_t(2)) { }
+        : op_term_t(env, pass_limit_to_orderby(term), argspec_t(2)) { }
 private:
     virtual scoped_ptr_t<val_t> eval_impl(
         scope_env_t *env, args_t *args, eval_flags_t) const {
@@ -372,7 +406,8 @@ private:
         // We only use el_set for equality purposes, so the reql_version doesn't
         // really matter (with respect to datum ordering behavior).  But we play it
         // safe.
-        std::set<datum_t, optional_datum_less_t> el_set;
+        std::unordered_set<datum_t, optional_datum_hash_t, optional_datum_equal_t>
+            el_set;
         datum_array_builder_t out(env->env->limits());
         for (size_t i = 0; i < arr.arr_size(); ++i) {
             if (el_set.insert(arr.get(i)).second) {
@@ -400,7 +435,8 @@ private:
         datum_t arr2 = args->arg(env, 1)->as_datum();
         // The reql_version doesn't actually matter here -- we only use the datum
         // comparisons for equality purposes.
-        std::set<datum_t, optional_datum_less_t> el_set;
+        std::unordered_set<datum_t, optional_datum_hash_t, optional_datum_equal_t>
+            el_set;
         datum_array_builder_t out(env->env->limits());
         for (size_t i = 0; i < arr1.arr_size(); ++i) {
             if (el_set.insert(arr1.get(i)).second) {
@@ -430,7 +466,8 @@ private:
         datum_t arr2 = args->arg(env, 1)->as_datum();
         // The reql_version here doesn't really matter.  We only use el_set
         // comparison for equality purposes.
-        std::set<datum_t, optional_datum_less_t> el_set;
+        std::unordered_set<datum_t, optional_datum_hash_t, optional_datum_equal_t>
+            el_set;
         datum_array_builder_t out(env->env->limits());
         for (size_t i = 0; i < arr1.arr_size(); ++i) {
             el_set.insert(arr1.get(i));
@@ -459,7 +496,8 @@ private:
         datum_t arr2 = args->arg(env, 1)->as_datum();
         // The reql_version here doesn't really matter.  We only use el_set
         // comparison for equality purposes.
-        std::set<datum_t, optional_datum_less_t> el_set;
+        std::unordered_set<datum_t, optional_datum_hash_t, optional_datum_equal_t>
+            el_set;
         datum_array_builder_t out(env->env->limits());
         for (size_t i = 0; i < arr2.arr_size(); ++i) {
             el_set.insert(arr2.get(i));
@@ -3,7 +3,9 @@
 
 #include <string>
 
+#include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/term_walker.hpp"
@@ -47,75 +49,101 @@ private:
     counted_t<const term_t> real;
 };
 
-class inner_join_term_t : public rewrite_term_t {
+/* `inner_join` and `outer_join` used to be rewritten into nested `concat_map`s, which
+call the predicate and evaluate the right-hand sequence once per left row. They're
+implemented directly now. If the right-hand sequence fits under the array size limit
+it's evaluated once and kept in memory, so equi-joins can also be answered with a hash
+index of it (see `hash_join_datum_stream_t`). For a bigger one, the rows read up to the
+limit are kept and only the rest is streamed again for every left row. Infinite
+right-hand sequences are streamed whole for every left row, like the old rewrite did. */
+class join_term_t : public op_term_t {
 public:
-    inner_join_term_t(compile_env_t *env, const raw_term_t &term)
-        : rewrite_term_t(env, term, argspec_t(3), rewrite) { }
-
-    static minidriver_t::reql_t rewrite(const raw_term_t &in) {
-        minidriver_t r(in.bt());
-
-        raw_term_t left = in.arg(0);
-        raw_term_t right = in.arg(1);
-        raw_term_t func = in.arg(2);
-        auto n = minidriver_t::dummy_var_t::INNERJOIN_N;
-        auto m = minidriver_t::dummy_var_t::INNERJOIN_M;
-
-        minidriver_t::reql_t term =
-            r.expr(left).concat_map(
-                r.fun(n,
-                    r.expr(right).concat_map(
-                        r.fun(m,
-                            r.branch(
-                                r.expr(func)(r.var(n), r.var(m)),
-                                r.array(r.object(r.optarg("left", n),
-                                                 r.optarg("right", m))),
-                                r.array())))));
-
-        term.copy_optargs_from_term(in);
-        return term;
+    join_term_t(compile_env_t *env, const raw_term_t &term, bool _outer)
+        : op_term_t(env, term, argspec_t(3)), outer(_outer) {
+        get_original_args()[1]->accumulate_captures(&right_captures);
     }
 
-    virtual const char *name() const { return "inner_join"; }
-};
-
-class outer_join_term_t : public rewrite_term_t {
-public:
-    outer_join_term_t(compile_env_t *env, const raw_term_t &term)
-        : rewrite_term_t(env, term, argspec_t(3), rewrite) { }
-
-    static minidriver_t::reql_t rewrite(const raw_term_t &in) {
-        minidriver_t r(in.bt());
-
-        raw_term_t left = in.arg(0);
-        raw_term_t right = in.arg(1);
-        raw_term_t func = in.arg(2);
-        auto n = minidriver_t::dummy_var_t::OUTERJOIN_N;
-        auto m = minidriver_t::dummy_var_t::OUTERJOIN_M;
-        auto lst = minidriver_t::dummy_var_t::OUTERJOIN_LST;
+private:
+    virtual scoped_ptr_t<val_t> eval_impl(
+        scope_env_t *env, args_t *args, eval_flags_t) const {
+        counted_t<datum_stream_t> left = args->arg(env, 0)->as_seq(env->env);
+        counted_t<datum_stream_t> right = args->arg(env, 1)->as_seq(env->env);
+        counted_t<const func_t> predicate = args->arg(env, 2)->as_func();
+
+        std::vector<datum_t> right_rows;
+        if (!right->is_infinite()) {
+            // Read one row past the array size limit, so that we know whether the
+            // whole right-hand sequence fits in memory.
+            const size_t limit = env->env->limits().array_size_limit();
+            batchspec_t batchspec = batchspec_t::user(batch_type_t::NORMAL, env->env);
+            while (right_rows.size() <= limit) {
+                datum_t row = right->next(env->env, batchspec);
+                if (!row.has()) {
+                    return new_val(env->env, make_in_memory_join(
+                        left, std::move(right_rows), predicate));
+                }
+                right_rows.push_back(std::move(row));
+            }
+        }
+
+        // It doesn't fit, or is infinite. Keep the rows we've read and only stream the rest, starting
+        // with what's left of `right` for the first left row.
+        counted_t<hash_join_datum_stream_t> stream =
+            make_counted<hash_join_datum_stream_t>(
+                left, std::move(right_rows), right_func(env), predicate, outer,
+                backtrace());
+        stream->set_right_remainder(std::move(right));
+        return new_val(env->env, stream);
+    }
 
-        minidriver_t::reql_t inner_concat_map =
-            r.expr(right).concat_map(
-                r.fun(m,
-                    r.branch(
-                        r.expr(func)(r.var(n), r.var(m)),
-                        r.array(r.object(r.optarg("left", n),
-                                         r.optarg("right", m))),
-                        r.array())));
+    // Evaluates the right-hand sequence again from the term that `op_term_t` already
+    // compiled for it.
+    counted_t<const func_t> right_func(scope_env_t *env) const {
+        return make_counted<reql_func_t>(env->scope.filtered_by_captures(right_captures),
+                                         std::vector<sym_t>(),
+                                         get_original_args()[1]);
+    }
 
-        minidriver_t::reql_t term =
-            r.expr(left).concat_map(
-                r.fun(n,
-                    inner_concat_map.coerce_to("ARRAY").do_(lst,
-                        r.branch(r.var(lst).count() > 0,
-                                 r.var(lst),
-                                 r.array(r.object(r.optarg("left", n)))))));
+    counted_t<hash_join_datum_stream_t> make_in_memory_join(
+            counted_t<datum_stream_t> left,
+            std::vector<datum_t> &&right_rows,
+            counted_t<const func_t> predicate) const {
+        hash_join_datum_stream_t::right_index_t right_index;
+        datum_string_t left_field, right_field;
+        bool indexed = predicate->get_field_equality(&left_field, &right_field)
+            && build_right_index(right_rows, right_field, &right_index);
+        counted_t<hash_join_datum_stream_t> stream =
+            make_counted<hash_join_datum_stream_t>(
+                left, std::move(right_rows), predicate, outer, backtrace());
+        if (indexed) {
+            stream->set_right_index(left_field, std::move(right_index));
+        }
+        return stream;
+    }
 
-        term.copy_optargs_from_term(in);
-        return term;
+    /* Indexes `right_rows` by the value of `right_field`. Returns false if a right row
+    doesn't have `right_field`. The join then calls the predicate for every pair of
+    rows, which also reports the error that the predicate would raise for that row. */
+    static bool build_right_index(const std::vector<datum_t> &right_rows,
+                                  const datum_string_t &right_field,
+                                  hash_join_datum_stream_t::right_index_t *out) {
+        for (size_t i = 0; i < right_rows.size(); ++i) {
+            if (right_rows[i].get_type() != datum_t::R_OBJECT) {
+                return false;
+            }
+            datum_t key = right_rows[i].get_field(right_field, NOTHROW);
+            if (!key.has()) {
+                return false;
+            }
+            (*out)[key].push_back(i);
+        }
+        return true;
     }
 
-    virtual const char *name() const { return "outer_join"; }
+    virtual const char *name() const { return outer ? "outer_join" : "inner_join"; }
+
+    bool outer;
+    var_captures_t right_captures;
 };
 
 class delete_term_t : public rewrite_term_t {
@@ -236,11 +264,11 @@ counted_t<term_t> make_skip_term(
 }
 counted_t<term_t> make_inner_join_term(
         compile_env_t *env, const raw_term_t &term) {
-    return make_counted<inner_join_term_t>(env, term);
+    return make_counted<join_term_t>(env, term, false);
 }
 counted_t<term_t> make_outer_join_term(
         compile_env_t *env, const raw_term_t &term) {
-    return make_counted<outer_join_term_t>(env, term);
+    return make_counted<join_term_t>(env, term, true);
 }
 counted_t<term_t> make_update_term(
         compile_env_t *env, const raw_term_t &term) {
@@ -5,12 +5,15 @@
 #include <utility>
 #include <vector>
 
+#include "clustering/administration/admin_op_exc.hpp"
 #include "parsing/utf8.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/math_utils.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/order_util.hpp"
+#include "rdb_protocol/profile.hpp"
+#include "rdb_protocol/pseudo_geometry.hpp"
 
 namespace ql {
 
@@ -76,6 +79,37 @@ public:
 private:
     virtual const char *name() const { return "avg"; }
 };
+class count_distinct_term_t
+    : public unindexable_map_acc_term_t<count_distinct_wire_func_t> {
+public:
+    template<class... Args> count_distinct_term_t(Args... args)
+        : unindexable_map_acc_term_t<count_distinct_wire_func_t>(args...) { }
+private:
+    virtual const char *name() const { return "count_distinct"; }
+};
+
+class percentile_term_t : public grouped_seq_op_term_t {
+public:
+    percentile_term_t(compile_env_t *env, const raw_term_t &term)
+        : grouped_seq_op_term_t(env, term, argspec_t(2, 3)) { }
+private:
+    virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args,
+                                          eval_flags_t) const {
+        scoped_ptr_t<val_t> v = args->arg(env, 0);
+        scoped_ptr_t<val_t> p = args->arg(env, 1);
+        double percentile = p->as_num();
+        rcheck_target(p, percentile >= 0 && percentile <= 100, base_exc_t::LOGIC,
+                      strprintf("Percentile must be between 0 and 100 (got %s).",
+                                p->print().c_str()));
+        counted_t<const func_t> func;
+        if (args->num_args() == 3) {
+            func = args->arg(env, 2)->as_func(GET_FIELD_SHORTCUT);
+        }
+        return v->as_seq(env->env)->run_terminal(
+            env->env, percentile_wire_func_t(percentile, backtrace(), func));
+    }
+    virtual const char *name() const { return "percentile"; }
+};
 
 template<class T>
 class indexable_map_acc_term_t : public map_acc_term_t<T> {
@@ -407,13 +441,124 @@ private:
     virtual const char *name() const { return "group"; }
 };
 
+// `filter` with `auto_index` scans the table instead of reading from an index when the
+// index's key distribution says that more than this fraction of it matches.
+const double AUTO_INDEX_MAX_FRACTION = 0.5;
+
 class filter_term_t : public grouped_seq_op_term_t {
 public:
     filter_term_t(compile_env_t *env, const raw_term_t &term)
-        : grouped_seq_op_term_t(env, term, argspec_t(2), optargspec_t({"default"})),
+        : grouped_seq_op_term_t(env, term, argspec_t(2),
+                                optargspec_t({"auto_index", "default"})),
           default_filter_term(lazy_literal_optarg(env, "default")) { }
 
 private:
+    // If `f` compares a field to a constant and `table` has an index on exactly that
+    // field, returns the part of `table` that the comparison selects through that
+    // index. Otherwise returns an empty pointer and the filter scans the whole table.
+    // The index only narrows down the rows; the caller still applies the filter to
+    // them.
+    counted_t<table_slice_t> index_slice_for_filter(
+            scope_env_t *env,
+            const counted_t<table_t> &table,
+            const counted_t<const func_t> &f) const {
+        field_comparison_t comparison;
+        if (!f->get_field_comparison(&comparison)) {
+            return counted_t<table_slice_t>();
+        }
+        const datum_t &value = comparison.value;
+        // Indexes don't contain `null`s, objects or other values that can't be keys,
+        // so the rewrite is only safe if every value the comparison selects can be
+        // one. For `eq` that's just the constant. Ranges are only safe above a string,
+        // since strings sort after every other type that can be in a row. A range
+        // below any constant would include the `null`s, for example.
+        if (value.get_type() == datum_t::MINVAL
+            || value.get_type() == datum_t::MAXVAL
+            || value.is_ptype(pseudo::geometry_string)) {
+            return counted_t<table_slice_t>();
+        }
+        try {
+            value.print_secondary(reql_version_t::LATEST, store_key_t(), boost::none);
+        } catch (const base_exc_t &) {
+            return counted_t<table_slice_t>();
+        }
+        datum_range_t range;
+        switch (static_cast<int>(comparison.op)) {
+        case Term::EQ:
+            range = datum_range_t(value);
+            break;
+        case Term::GT: // fallthru
+        case Term::GE:
+            if (value.get_type() != datum_t::R_STR) {
+                return counted_t<table_slice_t>();
+            }
+            range = datum_range_t(
+                value,
+                comparison.op == Term::GT ? key_range_t::open : key_range_t::closed,
+                datum_t::maxval(), key_range_t::closed);
+            break;
+        default:
+            return counted_t<table_slice_t>();
+        }
+
+        std::string index;
+        if (comparison.field == datum_string_t(table->get_pkey())) {
+            index = table->get_pkey();
+        } else {
+            std::map<std::string, std::pair<sindex_config_t, sindex_status_t> >
+                configs_and_statuses;
+            admin_err_t error;
+            if (!env->env->reql_cluster_interface()->sindex_list(
+                    table->db, name_string_t::guarantee_valid(table->name.c_str()),
+                    env->env->interruptor, &error, &configs_and_statuses)) {
+                // Tables that can't list their indexes get scanned as usual.
+                return counted_t<table_slice_t>();
+            }
+            for (const auto &pair : configs_and_statuses) {
+                const sindex_config_t &config = pair.second.first;
+                datum_string_t field;
+                if (pair.second.second.ready
+                    && config.multi == sindex_multi_bool_t::SINGLE
+                    && config.geo == sindex_geo_bool_t::REGULAR
+                    && config.aggregate == sindex_aggregate_bool_t::REGULAR
+                    && !static_cast<bool>(config.filter)
+                    && config.change_log_size == 0
+                    && config.func.compile_wire_func()->get_field_selector(&field)
+                    && field == comparison.field) {
+                    index = pair.first;
+                    break;
+                }
+            }
+            if (index.empty()) {
+                return counted_t<table_slice_t>();
+            }
+        }
+
+        // When the comparison selects most of the index, the index saves little
+        // reading. Its entries are bigger than the rows, and each entry of a reference
+        // index costs a lookup in the primary B-tree, so the table scan wins.
+        key_range_t key_range = index == table->get_pkey()
+            ? range.to_primary_keyrange()
+            : range.to_sindex_keyrange(reql_version_t::LATEST);
+        double fraction;
+        if (table->tbl->estimate_index_fraction(
+                env->env, index, key_range, &fraction)
+            && fraction > AUTO_INDEX_MAX_FRACTION) {
+            PROFILE_STARTER_IF_ENABLED(
+                env->env->profile() == profile_bool_t::PROFILE,
+                strprintf("Scanning the table for `filter`, since about %.0f%% of "
+                          "index `%s` matches.", fraction * 100, index.c_str()),
+                env->env->trace);
+            return counted_t<table_slice_t>();
+        }
+
+        PROFILE_STARTER_IF_ENABLED(
+            env->env->profile() == profile_bool_t::PROFILE,
+            strprintf("Reading the rows for `filter` from index `%s`.", index.c_str()),
+            env->env->trace);
+        return make_counted<table_slice_t>(table)->with_bounds(index, range);
+    }
+
     virtual scoped_ptr_t<val_t> eval_impl(
         scope_env_t *env, args_t *args, eval_flags_t) const {
         scoped_ptr_t<val_t> v0 = args->arg(env, 0);
@@ -424,6 +569,21 @@ private:
             defval = wire_func_t(default_filter_term->eval_to_func(env->scope));
         }
 
+        // With a `default`, rows that lack the field may match, and those aren't in
+        // any index.
+        scoped_ptr_t<val_t> auto_index = args->optarg(env, "auto_index");
+        if (auto_index.has() && auto_index->as_bool() && !defval
+            && v0->get_type().get_raw_type() == val_t::type_t::TABLE) {
+            counted_t<table_t> table = v0->as_table();
+            counted_t<table_slice_t> slice = index_slice_for_filter(env, table, f);
+            if (slice.has()) {
+                counted_t<selection_t> ts = make_counted<selection_t>(
+                    table, slice->as_seq(env->env, backtrace()));
+                ts->seq->add_transformation(filter_wire_func_t(f, defval), backtrace());
+                return new_val(ts);
+            }
+        }
+
         if (v0->get_type().is_convertible(val_t::type_t::SELECTION)) {
             counted_t<selection_t> ts = v0->as_selection(env->env);
             ts->seq->add_transformation(filter_wire_func_t(f, defval), backtrace());
@@ -931,6 +1091,16 @@ counted_t<term_t> make_avg_term(
     return make_counted<avg_term_t>(env, term);
 }
 
+counted_t<term_t> make_count_distinct_term(
+        compile_env_t *env, const raw_term_t &term) {
+    return make_counted<count_distinct_term_t>(env, term);
+}
+
+counted_t<term_t> make_percentile_term(
+        compile_env_t *env, const raw_term_t &term) {
+    return make_counted<percentile_term_t>(env, term);
+}
+
 counted_t<term_t> make_sum_term(
         compile_env_t *env, const raw_term_t &term) {
     return make_counted<sum_term_t>(env, term);
@@ -26,7 +26,9 @@ datum_string_t sindex_config_to_string(const sindex_config_t &config) {
     version.original_reql_version = config.func_version;
     version.latest_compatible_reql_version = config.func_version;
     version.latest_checked_reql_version = reql_version_t::LATEST;
-    sindex_disk_info_t disk_info(config.func, version, config.multi, config.geo);
+    sindex_disk_info_t disk_info(config.func, version, config.multi, config.geo,
+                                 config.aggregate, config.reference, config.filter,
+                                 config.change_log_size);
 
     write_message_t wm;
     serialize_sindex_info(&wm, disk_info);
@@ -87,7 +89,11 @@ sindex_config_t sindex_config_from_string(
         sindex_info.mapping,
         sindex_info.mapping_version_info.original_reql_version,
         sindex_info.multi,
-        sindex_info.geo);
+        sindex_info.geo,
+        sindex_info.aggregate,
+        sindex_info.reference,
+        sindex_info.filter,
+        sindex_info.change_log_size);
 }
 
 // Helper for `sindex_status_to_datum()`
@@ -117,6 +123,42 @@ std::string format_index_create_query(
         }
         ret += "geo: true";
     }
+    if (config.aggregate == sindex_aggregate_bool_t::AGGREGATE) {
+        if (first_optarg) {
+            ret += ", {";
+            first_optarg = false;
+        } else {
+            ret += ", ";
+        }
+        ret += "aggregate: true";
+    }
+    if (config.reference == sindex_reference_bool_t::REFERENCE) {
+        if (first_optarg) {
+            ret += ", {";
+            first_optarg = false;
+        } else {
+            ret += ", ";
+        }
+        ret += "reference: true";
+    }
+    if (static_cast<bool>(config.filter)) {
+        if (first_optarg) {
+            ret += ", {";
+            first_optarg = false;
+        } else {
+            ret += ", ";
+        }
+        ret += "filter: " + config.filter->compile_wire_func()->print_js_function();
+    }
+    if (config.change_log_size != 0) {
+        if (first_optarg) {
+            ret += ", {";
+            first_optarg = false;
+        } else {
+            ret += ", ";
+        }
+        ret += strprintf("change_log: %" PRIu64, config.change_log_size);
+    }
     if (!first_optarg) {
         ret += "}";
     }
@@ -144,6 +186,14 @@ ql::datum_t sindex_status_to_datum(
         ql::datum_t::boolean(config.multi == sindex_multi_bool_t::MULTI));
     stat.overwrite("geo",
         ql::datum_t::boolean(config.geo == sindex_geo_bool_t::GEO));
+    stat.overwrite("aggregate",
+        ql::datum_t::boolean(config.aggregate == sindex_aggregate_bool_t::AGGREGATE));
+    stat.overwrite("reference",
+        ql::datum_t::boolean(config.reference == sindex_reference_bool_t::REFERENCE));
+    stat.overwrite("partial",
+        ql::datum_t::boolean(static_cast<bool>(config.filter)));
+    stat.overwrite("change_log",
+        ql::datum_t(static_cast<double>(config.change_log_size)));
     stat.overwrite("function",
         ql::datum_t::binary(sindex_config_to_string(config)));
     stat.overwrite("query",
@@ -154,7 +204,9 @@ ql::datum_t sindex_status_to_datum(
 class sindex_create_term_t : public op_term_t {
 public:
     sindex_create_term_t(compile_env_t *env, const raw_term_t &term)
-        : op_term_t(env, term, argspec_t(2, 3), optargspec_t({"multi", "geo"})) { }
+        : op_term_t(env, term, argspec_t(2, 3),
+                    optargspec_t({"multi", "geo", "aggregate", "reference",
+                                  "filter", "change_log"})) { }
 
     virtual scoped_ptr_t<val_t> eval_impl(
         scope_env_t *env, args_t *args, eval_flags_t) const {
@@ -170,6 +222,10 @@ public:
         sindex_config_t config;
         config.multi = sindex_multi_bool_t::SINGLE;
         config.geo = sindex_geo_bool_t::REGULAR;
+        config.aggregate = sindex_aggregate_bool_t::REGULAR;
+        config.reference = sindex_reference_bool_t::COPY;
+        config.filter = boost::none;
+        config.change_log_size = 0;
         if (args->num_args() == 3) {
             scoped_ptr_t<val_t> v = args->arg(env, 2);
             bool got_func = false;
@@ -218,6 +274,59 @@ public:
                 ? sindex_geo_bool_t::GEO
                 : sindex_geo_bool_t::REGULAR;
         }
+        /* Or an aggregate index? */
+        if (scoped_ptr_t<val_t> aggregate_val = args->optarg(env, "aggregate")) {
+            config.aggregate = aggregate_val->as_bool()
+                ? sindex_aggregate_bool_t::AGGREGATE
+                : sindex_aggregate_bool_t::REGULAR;
+        }
+        rcheck(config.aggregate == sindex_aggregate_bool_t::REGULAR
+               || (config.multi == sindex_multi_bool_t::SINGLE
+                   && config.geo == sindex_geo_bool_t::REGULAR),
+               base_exc_t::LOGIC,
+               "An aggregate index can't also be a multi index or a geospatial index.");
+        /* Or one that only stores references to the rows? */
+        if (scoped_ptr_t<val_t> reference_val = args->optarg(env, "reference")) {
+            config.reference = reference_val->as_bool()
+                ? sindex_reference_bool_t::REFERENCE
+                : sindex_reference_bool_t::COPY;
+        }
+        rcheck(config.reference == sindex_reference_bool_t::COPY
+               || (config.geo == sindex_geo_bool_t::REGULAR
+                   && config.aggregate == sindex_aggregate_bool_t::REGULAR),
+               base_exc_t::LOGIC,
+               "A reference index can't also be a geospatial index or an aggregate "
+               "index.");
+        /* Should the index only contain some of the rows? Reads of the index then
+        only return those rows. That's why reads of a range of a partial index must
+        repeat the filter, see `repeats_sindex_filter()`. */
+        if (scoped_ptr_t<val_t> filter_val = args->optarg(env, "filter")) {
+            counted_t<const func_t> filter = filter_val->as_func();
+            boost::optional<size_t> arity = filter->arity();
+            rcheck_target(filter_val.get(),
+                          !static_cast<bool>(arity) || arity.get() == 1,
+                          base_exc_t::LOGIC,
+                          "The filter of an index must expect 1 argument.");
+            config.filter = ql::map_wire_func_t(filter);
+            config.filter->compile_wire_func()->assert_deterministic(
+                "Index filters must be deterministic.");
+        }
+        /* Or a log of the recent changes? */
+        if (scoped_ptr_t<val_t> change_log_val = args->optarg(env, "change_log")) {
+            config.change_log_size = change_log_val->as_int<uint64_t>();
+            rcheck_target(change_log_val.get(), config.change_log_size > 0,
+                          base_exc_t::LOGIC,
+                          "The size of a change log must be positive.");
+        }
+        rcheck(config.change_log_size == 0
+               || (config.multi == sindex_multi_bool_t::SINGLE
+                   && config.geo == sindex_geo_bool_t::REGULAR
+                   && config.aggregate == sindex_aggregate_bool_t::REGULAR
+                   && config.reference == sindex_reference_bool_t::COPY
+                   && !static_cast<bool>(config.filter)),
+               base_exc_t::LOGIC,
+               "A change log index can't also be a multi, geospatial, aggregate, "
+               "reference or partial index.");
 
         try {
             admin_err_t error;
@@ -1,11 +1,11 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <algorithm>
 #include <string>
+#include <unordered_set>
 #include <utility>
-
-#include "errors.hpp"
-#include <boost/bind.hpp>
+#include <vector>
 
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/error.hpp"
@@ -47,12 +47,80 @@ private:
     virtual const char *name() const { return "desc"; }
 };
 
+/* Returns the `limit` smallest rows of `seq` according to `lt_cmp`, in order, using a
+bounded heap instead of sorting the whole sequence. Ties are resolved in favor of the
+row that comes first in `seq`, so this returns the same rows as a stable sort followed
+by a `limit`. */
+std::vector<datum_t> top_k(env_t *env,
+                           datum_stream_t *seq,
+                           const lt_cmp_t &lt_cmp,
+                           size_t limit) {
+    profile::sampler_t sampler("Selecting the first rows in-memory.", env->trace);
+    // Orders rows by `lt_cmp`, and equal rows by their position in `seq`.
+    typedef std::pair<datum_t, size_t> row_t;
+    auto row_lt = [&](const row_t &l, const row_t &r) {
+        if (lt_cmp(env, &sampler, l.first, r.first)) {
+            return true;
+        }
+        return !lt_cmp(env, &sampler, r.first, l.first) && l.second < r.second;
+    };
+
+    // A max-heap, so that the row that would be dropped next is at the front.
+    std::vector<row_t> heap;
+    size_t position = 0;
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    for (;;) {
+        std::vector<datum_t> data = seq->next_batch(env, batchspec);
+        if (data.size() == 0) {
+            break;
+        }
+        for (auto &&d : data) {
+            row_t row(std::move(d), position++);
+            if (heap.size() < limit) {
+                heap.push_back(std::move(row));
+                std::push_heap(heap.begin(), heap.end(), row_lt);
+            } else if (limit != 0 && row_lt(row, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), row_lt);
+                heap.back() = std::move(row);
+                std::push_heap(heap.begin(), heap.end(), row_lt);
+            }
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end(), row_lt);
+
+    std::vector<datum_t> res;
+    res.reserve(heap.size());
+    for (auto &&row : heap) {
+        res.push_back(std::move(row.first));
+    }
+    return res;
+}
+
 class orderby_term_t : public op_term_t {
 public:
     orderby_term_t(compile_env_t *env, const raw_term_t &term)
         : op_term_t(env, term, argspec_t(1, -1),
-          optargspec_t({"index"})) { }
+          optargspec_t({"index", "_LIMIT_"})) { }
 private:
+    /* `limit_term_t` passes its argument in the hidden `_LIMIT_` optarg if it's applied
+    directly to an `order_by`. Returns `false` if there's no such hint, or if it isn't
+    a valid limit, in which case `limit_term_t` will report the error later. */
+    bool get_limit_hint(scope_env_t *env, args_t *args, size_t *limit_out) const {
+        if (!get_src().optarg("_LIMIT_")) {
+            return false;
+        }
+        datum_t limit = args->optarg(env, "_LIMIT_")->as_datum();
+        if (limit.get_type() != datum_t::R_NUM) {
+            return false;
+        }
+        int64_t num;
+        if (!number_as_integer(limit.as_num(), &num) || num < 0 || num > INT32_MAX) {
+            return false;
+        }
+        *limit_out = static_cast<size_t>(num);
+        return true;
+    }
+
     virtual scoped_ptr_t<val_t>
     eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
         std::vector<std::pair<order_direction_t, counted_t<const func_t> > > comparisons
@@ -106,6 +174,24 @@ private:
             }
             rcheck(!comparisons.empty(), base_exc_t::LOGIC,
                    "Must specify something to order by.");
+            /* If only the first few rows are needed, there's no need to hold on to
+            (or sort) the rest of them. */
+            size_t limit;
+            if (get_limit_hint(env, args, &limit)
+                && limit <= env->env->limits().array_size_limit()) {
+                seq = make_counted<array_datum_stream_t>(
+                    datum_t(top_k(env->env, seq.get(), lt_cmp, limit),
+                            env->env->limits()),
+                    backtrace());
+                return tbl_slice.has()
+                    ? new_val(make_counted<selection_t>(tbl_slice->get_tbl(), seq))
+                    : new_val(env->env, seq);
+            }
+            /* Sequences that don't fit into an array are sorted on disk if the server
+            has a data directory to put the sorted runs into. */
+            rdb_context_t *ctx = env->env->get_rdb_ctx();
+            const bool can_sort_on_disk = ctx != nullptr && ctx->io_backender != nullptr;
+            counted_t<external_sort_datum_stream_t> external_sort;
             std::vector<datum_t> to_sort;
             batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
             for (;;) {
@@ -115,14 +201,30 @@ private:
                     break;
                 }
                 std::move(data.begin(), data.end(), std::back_inserter(to_sort));
-                rcheck_array_size(to_sort, env->env->limits());
+                if (can_sort_on_disk
+                    && to_sort.size() > env->env->limits().array_size_limit()) {
+                    if (!external_sort.has()) {
+                        external_sort = make_counted<external_sort_datum_stream_t>(
+                            ctx->io_backender, ctx->base_path, lt_cmp, backtrace());
+                    }
+                    external_sort->add_run(env->env, std::move(to_sort));
+                    to_sort.clear();
+                } else {
+                    rcheck_array_size(to_sort, env->env->limits());
+                }
+            }
+            if (external_sort.has()) {
+                if (!to_sort.empty()) {
+                    external_sort->add_run(env->env, std::move(to_sort));
+                }
+                seq = external_sort;
+            } else {
+                profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
+                stable_sort_rows(env->env, &sampler, lt_cmp, &to_sort);
+                seq = make_counted<array_datum_stream_t>(
+                    datum_t(std::move(to_sort), env->env->limits()),
+                    backtrace());
             }
-            profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
-            auto fn = boost::bind(lt_cmp, env->env, &sampler, _1, _2);
-            std::stable_sort(to_sort.begin(), to_sort.end(), fn);
-            seq = make_counted<array_datum_stream_t>(
-                datum_t(std::move(to_sort), env->env->limits()),
-                backtrace());
         }
         return tbl_slice.has()
             ? new_val(make_counted<selection_t>(tbl_slice->get_tbl(), seq))
@@ -167,9 +269,10 @@ private:
         rcheck(!idx, base_exc_t::LOGIC,
                "Can only perform an indexed distinct on a TABLE.");
         counted_t<datum_stream_t> s = v->as_seq(env->env);
-        // The reql_version matters here, because we copy `results` into `toret`
-        // in ascending order.
-        std::set<datum_t, optional_datum_less_t> results;
+        // Duplicates are removed with a hash table, which only compares elements for
+        // equality, and the distinct elements are then sorted once at the end.
+        std::unordered_set<datum_t, optional_datum_hash_t, optional_datum_equal_t>
+            results;
         batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
         {
             profile::sampler_t sampler("Evaluating elements in distinct.",
@@ -181,8 +284,9 @@ private:
                 sampler.new_sample();
             }
         }
-        std::vector<datum_t> toret;
-        std::move(results.begin(), results.end(), std::back_inserter(toret));
+        std::vector<datum_t> toret(results.begin(), results.end());
+        results.clear();
+        std::sort(toret.begin(), toret.end(), optional_datum_less_t());
         return new_val(datum_t(std::move(toret), env->env->limits()));
     }
 
@@ -269,6 +269,10 @@ counted_t<term_t> make_min_term(
     compile_env_t *env, const raw_term_t &term);
 counted_t<term_t> make_max_term(
     compile_env_t *env, const raw_term_t &term);
+counted_t<term_t> make_count_distinct_term(
+    compile_env_t *env, const raw_term_t &term);
+counted_t<term_t> make_percentile_term(
+    compile_env_t *env, const raw_term_t &term);
 counted_t<term_t> make_union_term(
     compile_env_t *env, const raw_term_t &term);
 counted_t<term_t> make_zip_term(
@@ -87,7 +87,8 @@ public:
     insert_term_t(compile_env_t *env, const raw_term_t &term)
         : op_term_t(env, term, argspec_t(2),
                     optargspec_t({"conflict", "durability", "return_vals",
-                                  "return_changes", "ignore_write_hook"})) { }
+                                  "return_changes", "ignore_write_hook",
+                                  "presorted"})) { }
 
 private:
     static void maybe_generate_key(counted_t<table_t> tbl,
@@ -154,6 +155,12 @@ private:
                     t->get_id());
             }
         }
+        scoped_ptr_t<val_t> presorted_arg = args->optarg(env, "presorted");
+        const presorted_t presorted =
+            presorted_arg.has() && presorted_arg->as_bool() ?
+            presorted_t::YES :
+            presorted_t::NO;
+
         if (conflict_behavior == conflict_behavior_t::FUNCTION) {
             conflict_func = conflict_optarg->as_func();
 
@@ -199,7 +206,8 @@ private:
                     conflict_func,
                     durability_requirement,
                     return_changes,
-                    ignore_write_hook);
+                    ignore_write_hook,
+                    presorted);
                 stats = stats.merge(
                     replace_stats, stats_merge, env->env->limits(), &conditions);
                 done = true;
@@ -239,7 +247,8 @@ private:
                     conflict_func,
                     durability_requirement,
                     return_changes,
-                    ignore_write_hook);
+                    ignore_write_hook,
+                    presorted);
                 stats = stats.merge(
                     replace_stats, stats_merge, env->env->limits(), &conditions);
             }
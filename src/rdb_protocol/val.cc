@@ -284,7 +284,8 @@ datum_t table_t::batched_replace(
             boost::none,
             durability_requirement,
             return_changes,
-            ignore_write_hook);
+            ignore_write_hook,
+            presorted_t::NO);
         std::set<std::string> conditions;
         datum_t merged
             = std::move(stats).to_datum().merge(insert_stats, stats_merge,
@@ -334,7 +335,8 @@ datum_t table_t::batched_insert(
     boost::optional<counted_t<const ql::func_t> > conflict_func,
     durability_requirement_t durability_requirement,
     return_changes_t return_changes,
-    ignore_write_hook_t ignore_write_hook) {
+    ignore_write_hook_t ignore_write_hook,
+    presorted_t presorted) {
 
     datum_object_builder_t stats;
     std::vector<datum_t> valid_inserts;
@@ -381,7 +383,8 @@ datum_t table_t::batched_insert(
                 conflict_func,
                 return_changes,
                 durability_requirement,
-                ignore_write_hook);
+                ignore_write_hook,
+                presorted);
 
         if (return_changes != return_changes_t::NO) {
             // Generate map to order changes
@@ -82,7 +82,8 @@ public:
         boost::optional<counted_t<const ql::func_t> > conflict_func,
         durability_requirement_t durability_requirement,
         return_changes_t return_changes,
-        ignore_write_hook_t ignore_write_hook);
+        ignore_write_hook_t ignore_write_hook,
+        presorted_t presorted);
 
     MUST_USE bool sync(env_t *env);
 
@@ -318,4 +318,21 @@ RDB_IMPL_SERIALIZABLE_2_SINCE_v1_13(filter_wire_func_t, filter_func, default_fil
 
 RDB_MAKE_SERIALIZABLE_1_FOR_CLUSTER(distinct_wire_func_t, use_index);
 
+template <>
+void serialize<cluster_version_t::CLUSTER>(
+        write_message_t *wm, const percentile_wire_func_t &pwf) {
+    serialize<cluster_version_t::CLUSTER>(
+        wm, static_cast<const maybe_wire_func_t &>(pwf));
+    serialize<cluster_version_t::CLUSTER>(wm, pwf.percentile);
+}
+
+template <>
+archive_result_t deserialize<cluster_version_t::CLUSTER>(
+        read_stream_t *s, percentile_wire_func_t *pwf) {
+    archive_result_t res = deserialize<cluster_version_t::CLUSTER>(
+        s, static_cast<maybe_wire_func_t *>(pwf));
+    if (bad(res)) { return res; }
+    return deserialize<cluster_version_t::CLUSTER>(s, &pwf->percentile);
+}
+
 }  // namespace ql
@@ -178,6 +178,21 @@ public:
     template <class... Args>
     explicit max_wire_func_t(Args... args) : skip_wire_func_t(args...) { }
 };
+class count_distinct_wire_func_t : public skip_wire_func_t {
+public:
+    template <class... Args>
+    explicit count_distinct_wire_func_t(Args... args) : skip_wire_func_t(args...) { }
+};
+class percentile_wire_func_t : public skip_wire_func_t {
+public:
+    percentile_wire_func_t() : percentile(0) { }
+    template <class... Args>
+    explicit percentile_wire_func_t(double _percentile, Args... args)
+        : skip_wire_func_t(args...), percentile(_percentile) { }
+    // Between 0 and 100.
+    double percentile;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(percentile_wire_func_t);
 
 }  // namespace ql
 
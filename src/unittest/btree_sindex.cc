@@ -292,7 +292,8 @@ TPTEST(BTreeSindex, BtreeStoreAPI) {
                         main_sb.get(),
                         &sindex_super_block,
                         &opaque_definition,
-                        &sindex_uuid);
+                        &sindex_uuid,
+                        release_superblock_t::RELEASE);
                 ASSERT_TRUE(sindex_exists);
             }
 
@@ -2,6 +2,7 @@
 
 #include "arch/io/disk.hpp"
 #include "arch/types.hpp"
+#include "btree/bulk_load.hpp"
 #include "btree/reql_specific.hpp"
 #include "buffer_cache/cache_balancer.hpp"
 #include "rdb_protocol/btree.hpp"
@@ -173,6 +174,45 @@ public:
         set(key, value, repli_timestamp_t::distant_past);
     }
 
+    /* Appends `pairs`, which must be sorted and greater than every key in the B-tree,
+    through a `btree_bulk_loader_t`. */
+    void bulk_append(const std::vector<std::pair<store_key_t, std::string> > &pairs) {
+        run_txn_fn(true, [&](scoped_ptr_t<real_superblock_t> &&superblock){
+            noop_value_deleter_t deleter;
+            btree_bulk_loader_t loader(sizer.get(), superblock.get());
+            for (const auto &pair : pairs) {
+                ASSERT_TRUE(loader.key_is_appendable(pair.first.btree_key()));
+                short_value_buffer_t buf(pair.second);
+                loader.append(pair.first.btree_key(), buf.data(),
+                              repli_timestamp_t::distant_past, &deleter);
+            }
+            loader.finish();
+            EXPECT_EQ(static_cast<int64_t>(pairs.size()), loader.num_appended());
+            store_key_t last_key;
+            if (!pairs.empty()) {
+                ASSERT_TRUE(loader.get_last_key(&last_key));
+                EXPECT_EQ(pairs.back().first, last_key);
+            }
+        });
+
+        for (const auto &pair : pairs) {
+            kv[pair.first] = pair.second;
+        }
+    }
+
+    /* Opens a `btree_bulk_loader_t` without appending anything, and reports whether
+    `next_key` could be appended and what the loader thinks the last key is. */
+    void probe_bulk_loader(const store_key_t &next_key,
+                           bool *appendable_out,
+                           store_key_t *last_key_out) {
+        run_txn_fn(true, [&](scoped_ptr_t<real_superblock_t> &&superblock){
+            btree_bulk_loader_t loader(sizer.get(), superblock.get());
+            *appendable_out = loader.key_is_appendable(next_key.btree_key());
+            ASSERT_TRUE(loader.get_last_key(last_key_out));
+            loader.finish();
+        });
+    }
+
     void remove(const store_key_t &key, repli_timestamp_t timestamp) {
         EXPECT_TRUE(should_have(key));
 
@@ -270,6 +310,11 @@ public:
         run_txn_fn(false, [&](scoped_ptr_t<real_superblock_t> &&superblock){
             cond_t interruptor;
 
+            // `count()` relies on the population in the stat block being exact.
+            int64_t population;
+            ASSERT_TRUE(get_btree_population(superblock.get(), &population));
+            EXPECT_EQ(static_cast<int64_t>(kv.size()), population);
+
             map_filler_callback_t filler_cb(&bt_map);
 
             btree_depth_first_traversal(
@@ -484,6 +529,87 @@ TPTEST(BTree, RemoveInOrder) {
     ctx.verify();
 }
 
+std::vector<std::pair<store_key_t, std::string> > sorted_pairs_after(
+        rng_t *rng, int first_index, int count) {
+    std::vector<std::pair<store_key_t, std::string> > pairs;
+    for (int i = first_index; i < first_index + count; i++) {
+        /* The `~` sorts after every key generated by `random_letter_string()`. */
+        std::string key = strprintf("~%06d", i) + random_letter_string(rng, 0, 200);
+        pairs.push_back(std::make_pair(store_key_t(key),
+                                       random_letter_string(rng, 0, 250)));
+    }
+    return pairs;
+}
+
+TPTEST(BTree, BulkLoadEmpty) {
+    BTreeTestContext ctx;
+    rng_t rng;
+
+    ctx.bulk_append(sorted_pairs_after(&rng, 0, 3000));
+    ctx.verify();
+
+    /* The bulk-loaded tree must also work with regular operations */
+    for (int i = 0; i < 500; i++) {
+        if (rng.randint(2) == 0) {
+            ctx.set(store_key_t(random_letter_string(&rng, 1, 250)),
+                    random_letter_string(&rng, 0, 250));
+        } else {
+            ctx.remove(ctx.pick_random_key(&rng));
+        }
+    }
+    ctx.verify();
+}
+
+TPTEST(BTree, BulkLoadAppend) {
+    BTreeTestContext ctx;
+    rng_t rng;
+
+    for (int i = 0; i < 1000; i++) {
+        ctx.set(store_key_t(random_letter_string(&rng, 1, 250)),
+                random_letter_string(&rng, 0, 250));
+    }
+
+    /* Each batch reopens the rightmost path that the previous one left behind */
+    for (int batch = 0; batch < 10; batch++) {
+        ctx.bulk_append(sorted_pairs_after(&rng, batch * 300, 1 + rng.randint(300)));
+        ctx.verify();
+    }
+
+    while (!ctx.is_empty()) {
+        ctx.remove(ctx.lowest_key());
+
+        if (rng.randint(50) == 0) {
+            ctx.verify();
+        }
+    }
+
+    ctx.verify();
+}
+
+TPTEST(BTree, BulkLoadLastKeyWithFullSpine) {
+    BTreeTestContext ctx;
+    rng_t rng;
+
+    /* Regular inserts in ascending order now and then leave a full internal node on the
+    rightmost path, which the loader can't reopen. It must still find the last key, so
+    that the append hint doesn't go stale. */
+    std::vector<std::pair<store_key_t, std::string> > pairs =
+        sorted_pairs_after(&rng, 0, 2000);
+    int refused = 0;
+    for (size_t i = 0; i + 1 < pairs.size(); i++) {
+        ctx.set(pairs[i].first, pairs[i].second);
+        bool appendable;
+        store_key_t last_key;
+        ctx.probe_bulk_loader(pairs[i + 1].first, &appendable, &last_key);
+        EXPECT_EQ(pairs[i].first, last_key);
+        if (!appendable) {
+            refused++;
+        }
+    }
+    EXPECT_GT(refused, 0);
+    ctx.verify();
+}
+
 TPTEST(BTree, RemoveRandomOrder) {
     BTreeTestContext ctx;
     rng_t rng;
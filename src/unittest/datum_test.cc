@@ -24,6 +24,7 @@ void test_datum_serialization(const ql::datum_t datum) {
                                                              &deserialized_datum);
         ASSERT_EQ(archive_result_t::SUCCESS, res);
         ASSERT_EQ(datum, deserialized_datum);
+        ASSERT_EQ(datum.hash(), deserialized_datum.hash());
     }
 
     // Re-serialize the just deserialized datum a second time. This might use
@@ -43,6 +44,7 @@ void test_datum_serialization(const ql::datum_t datum) {
                                                              &redeserialized_datum);
         ASSERT_EQ(archive_result_t::SUCCESS, res);
         ASSERT_EQ(deserialized_datum, redeserialized_datum);
+        ASSERT_EQ(deserialized_datum.hash(), redeserialized_datum.hash());
     }
 }
 
@@ -205,4 +207,64 @@ TEST(DatumTest, OffsetScaling) {
     }
 }
 
+TEST(DatumTest, Hash) {
+    // The hash must not change between versions or servers.
+    ASSERT_EQ(0xf681d092ba671a7fULL, ql::datum_t("abc").hash());
+
+    // Data that compare as equal must have the same hash.
+    ASSERT_EQ(ql::datum_t(0.0).hash(), ql::datum_t(-0.0).hash());
+    ql::datum_object_builder_t a, b;
+    UNUSED bool dup = a.add("x", ql::datum_t(1.0));
+    dup = a.add("y", ql::datum_t("z"));
+    dup = b.add("y", ql::datum_t("z"));
+    dup = b.add("x", ql::datum_t(1.0));
+    ASSERT_EQ(std::move(a).to_datum().hash(), std::move(b).to_datum().hash());
+
+    ASSERT_NE(ql::datum_t("abc").hash(),
+              ql::datum_t::binary(datum_string_t("abc")).hash());
+    ASSERT_NE(ql::datum_t::null().hash(), ql::datum_t::boolean(false).hash());
+    ASSERT_NE(ql::datum_t(1.0).hash(), ql::datum_t(2.0).hash());
+}
+
+std::string sort_key(const ql::datum_t &d) {
+    std::string key;
+    EXPECT_TRUE(d.append_sort_key(&key));
+    return key;
+}
+
+TEST(DatumTest, SortKey) {
+    // Sort keys must compare the same way as the data they were computed from.
+    std::vector<ql::datum_t> data = {
+        ql::datum_t::null(),
+        ql::datum_t::boolean(false),
+        ql::datum_t::boolean(true),
+        ql::datum_t(-1e10),
+        ql::datum_t(-1.5),
+        ql::datum_t(0.0),
+        ql::datum_t(2.0),
+        ql::datum_t(""),
+        ql::datum_t(datum_string_t(std::string("a\0b", 3))),
+        ql::datum_t("a\x01"),
+        ql::datum_t("ab"),
+        ql::datum_t(std::vector<ql::datum_t>{ql::datum_t(1.0)},
+                    ql::configured_limits_t()),
+        ql::datum_t(std::vector<ql::datum_t>{ql::datum_t(1.0), ql::datum_t(2.0)},
+                    ql::configured_limits_t()),
+        ql::datum_t(std::vector<ql::datum_t>{ql::datum_t(2.0)},
+                    ql::configured_limits_t())};
+    for (size_t i = 0; i < data.size(); ++i) {
+        for (size_t j = 0; j < data.size(); ++j) {
+            int expected = data[i].cmp(data[j]);
+            int actual = sort_key(data[i]).compare(sort_key(data[j]));
+            ASSERT_EQ(expected < 0, actual < 0) << i << " " << j;
+            ASSERT_EQ(expected == 0, actual == 0) << i << " " << j;
+        }
+    }
+    ASSERT_EQ(sort_key(ql::datum_t(0.0)), sort_key(ql::datum_t(-0.0)));
+
+    std::string key;
+    ql::datum_object_builder_t object;
+    ASSERT_FALSE(std::move(object).to_datum().append_sort_key(&key));
+}
+
 }  // namespace unittest
@@ -0,0 +1,134 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/sym.hpp"
+#include "rdb_protocol/wire_func.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+ql::datum_t make_row(const char *field, ql::datum_t value) {
+    ql::datum_object_builder_t builder;
+    UNUSED bool dup = builder.add(field, value);
+    return std::move(builder).to_datum();
+}
+
+bool get_comparison(const ql::raw_term_t &body, ql::field_comparison_t *out) {
+    ql::sym_t arg(1);
+    ql::wire_func_t wire_func(body, make_vector(arg));
+    return wire_func.compile_wire_func()->get_field_comparison(out);
+}
+
+TPTEST(FieldComparison, Recognize) {
+    ql::sym_t arg(1);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    ql::field_comparison_t comparison;
+
+    ASSERT_TRUE(get_comparison(
+        (r.var(arg)["status"] == r.expr(ql::datum_t("active"))).root_term(),
+        &comparison));
+    EXPECT_EQ(Term::EQ, comparison.op);
+    EXPECT_EQ(datum_string_t("status"), comparison.field);
+    EXPECT_EQ(ql::datum_t("active"), comparison.value);
+
+    /* A constant on the left-hand side flips the comparison */
+    ASSERT_TRUE(get_comparison(
+        (r.expr(ql::datum_t(5.0)) < r.var(arg)["ts"]).root_term(), &comparison));
+    EXPECT_EQ(Term::GT, comparison.op);
+    EXPECT_EQ(datum_string_t("ts"), comparison.field);
+
+    /* Comparing two fields, or anything that isn't a comparison, isn't recognized */
+    EXPECT_FALSE(get_comparison(
+        (r.var(arg)["a"] == r.var(arg)["b"]).root_term(), &comparison));
+    EXPECT_FALSE(get_comparison(r.var(arg)["a"].root_term(), &comparison));
+}
+
+TPTEST(FieldComparison, Selector) {
+    ql::sym_t arg(1);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    datum_string_t field;
+
+    ql::wire_func_t selector(r.var(arg)["ts"].root_term(), make_vector(arg));
+    ASSERT_TRUE(selector.compile_wire_func()->get_field_selector(&field));
+    EXPECT_EQ(datum_string_t("ts"), field);
+
+    ql::wire_func_t nested(r.var(arg)["a"]["b"].root_term(), make_vector(arg));
+    EXPECT_FALSE(nested.compile_wire_func()->get_field_selector(&field));
+}
+
+TPTEST(FieldComparison, Equality) {
+    ql::sym_t left(1), right(2);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    datum_string_t left_field, right_field;
+
+    ql::wire_func_t join(
+        (r.var(right)["user_id"] == r.var(left)["id"]).root_term(),
+        make_vector(left, right));
+    ASSERT_TRUE(join.compile_wire_func()->get_field_equality(&left_field, &right_field));
+    EXPECT_EQ(datum_string_t("id"), left_field);
+    EXPECT_EQ(datum_string_t("user_id"), right_field);
+
+    /* Both sides have to come from different arguments */
+    ql::wire_func_t same(
+        (r.var(left)["a"] == r.var(left)["b"]).root_term(), make_vector(left, right));
+    EXPECT_FALSE(same.compile_wire_func()->get_field_equality(&left_field, &right_field));
+    ql::wire_func_t less(
+        (r.var(left)["a"] < r.var(right)["b"]).root_term(), make_vector(left, right));
+    EXPECT_FALSE(less.compile_wire_func()->get_field_equality(&left_field, &right_field));
+}
+
+TPTEST(FieldComparison, Test) {
+    ql::field_comparison_t comparison;
+    comparison.field = datum_string_t("ts");
+    comparison.op = Term::GE;
+    comparison.value = ql::datum_t(10.0);
+
+    bool result = false;
+    ASSERT_TRUE(comparison.test(make_row("ts", ql::datum_t(10.0)), &result));
+    EXPECT_TRUE(result);
+    ASSERT_TRUE(comparison.test(make_row("ts", ql::datum_t(9.0)), &result));
+    EXPECT_FALSE(result);
+
+    /* Rows without the field are left to the function */
+    EXPECT_FALSE(comparison.test(make_row("other", ql::datum_t(10.0)), &result));
+    EXPECT_FALSE(comparison.test(ql::datum_t(10.0), &result));
+}
+
+TPTEST(FieldComparison, Paths) {
+    ql::sym_t arg(1);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    ql::field_paths_t paths;
+
+    ql::wire_func_t compound(
+        r.array(r.var(arg)["a"], r.var(arg)["b"]["c"]).root_term(), make_vector(arg));
+    ASSERT_TRUE(compound.compile_wire_func()->get_field_paths(&paths));
+    ASSERT_TRUE(paths.is_array);
+    ASSERT_EQ(2u, paths.paths.size());
+    EXPECT_EQ(1u, paths.paths[0].size());
+    EXPECT_EQ(datum_string_t("c"), paths.paths[1][1]);
+
+    ql::datum_t result;
+    ql::datum_t row = make_row("b", make_row("c", ql::datum_t(2.0)));
+    /* `a` is missing, so the function has to produce the error */
+    EXPECT_FALSE(paths.extract(row, &result));
+    ql::datum_object_builder_t builder;
+    UNUSED bool dup = builder.add("a", ql::datum_t(1.0));
+    dup = builder.add("b", make_row("c", ql::datum_t(2.0)));
+    ASSERT_TRUE(paths.extract(std::move(builder).to_datum(), &result));
+    EXPECT_EQ(ql::datum_t(1.0), result.get(0));
+    EXPECT_EQ(ql::datum_t(2.0), result.get(1));
+
+    ql::wire_func_t nested(r.var(arg)["a"]["b"].root_term(), make_vector(arg));
+    ASSERT_TRUE(nested.compile_wire_func()->get_field_paths(&paths));
+    EXPECT_FALSE(paths.is_array);
+    ASSERT_TRUE(paths.extract(make_row("a", make_row("b", ql::datum_t(3.0))), &result));
+    EXPECT_EQ(ql::datum_t(3.0), result);
+
+    /* Anything else than selecting fields isn't recognized */
+    ql::wire_func_t other((r.var(arg)["a"] + r.expr(ql::datum_t(1.0))).root_term(),
+                          make_vector(arg));
+    EXPECT_FALSE(other.compile_wire_func()->get_field_paths(&paths));
+}
+
+}  // namespace unittest
@@ -4,6 +4,8 @@
 #include "arch/io/disk.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "arch/timing.hpp"
+#include "btree/depth_first_traversal.hpp"
+#include "btree/leaf_node.hpp"
 #include "btree/operations.hpp"
 #include "btree/reql_specific.hpp"
 #include "buffer_cache/cache_balancer.hpp"
@@ -12,6 +14,7 @@
 #include "containers/uuid.hpp"
 #include "rapidjson/document.h"
 #include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/distribution_progress.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/erase_range.hpp"
 #include "rdb_protocol/minidriver.hpp"
@@ -68,6 +71,7 @@ void insert_rows(int start, int finish, store_t *store) {
                 store,
                 sindexes,
                 &mod_report,
+                repli_timestamp_t::distant_past,
                 txn.get(),
                 &deletion_context,
                 nullptr,
@@ -96,7 +100,11 @@ sindex_name_t create_sindex(store_t *store) {
         ql::map_wire_func_t(mapping, make_vector(one)),
         reql_version_t::LATEST,
         sindex_multi_bool_t::SINGLE,
-        sindex_geo_bool_t::REGULAR);
+        sindex_geo_bool_t::REGULAR,
+        sindex_aggregate_bool_t::REGULAR,
+        sindex_reference_bool_t::COPY,
+        boost::none,
+        0);
 
     cond_t non_interruptor;
     store->sindex_create(name, config, &non_interruptor);
@@ -110,10 +118,11 @@ void spawn_writes(store_t *store, cond_t *background_inserts_done) {
                 store, background_inserts_done));
 }
 
-ql::grouped_t<ql::stream_t> read_row_via_sindex(
+ql::grouped_t<ql::stream_t> read_range_via_sindex(
         store_t *store,
         const sindex_name_t &sindex_name,
-        int sindex_value) {
+        const ql::datum_range_t &datum_range,
+        const ql::batchspec_t &batchspec) {
     cond_t dummy_interruptor;
     read_token_t token;
     store->new_read_token(&token);
@@ -135,7 +144,8 @@ ql::grouped_t<ql::stream_t> read_row_via_sindex(
             super_block.get(),
             &sindex_sb,
             &opaque_definition,
-            &sindex_uuid);
+            &sindex_uuid,
+            release_superblock_t::RELEASE);
     guarantee(sindex_exists);
 
     sindex_disk_info_t sindex_info;
@@ -146,7 +156,6 @@ ql::grouped_t<ql::stream_t> read_row_via_sindex(
     }
 
     rget_read_response_t res;
-    ql::datum_range_t datum_range(ql::datum_t(static_cast<double>(sindex_value)));
     /* The only thing this does is have a NULL `profile::trace_t *` in it which
      * prevents to profiling code from crashing. */
     ql::env_t dummy_env(&dummy_interruptor,
@@ -160,13 +169,15 @@ ql::grouped_t<ql::stream_t> read_row_via_sindex(
         datum_range.to_sindex_keyrange(reql_version_t::LATEST),
         sindex_sb.get(),
         &dummy_env, // env_t
-        ql::batchspec_t::default_for(ql::batch_type_t::NORMAL),
+        batchspec,
         std::vector<ql::transform_variant_t>(),
         boost::optional<ql::terminal_variant_t>(),
         key_range_t::universe(),
         sorting_t::ASCENDING,
         require_sindexes_t::NO,
         sindex_info,
+        nullptr,
+        nullptr,
         &res,
         release_superblock_t::RELEASE);
 
@@ -176,6 +187,17 @@ ql::grouped_t<ql::stream_t> read_row_via_sindex(
     return *groups;
 }
 
+ql::grouped_t<ql::stream_t> read_row_via_sindex(
+        store_t *store,
+        const sindex_name_t &sindex_name,
+        int sindex_value) {
+    return read_range_via_sindex(
+        store,
+        sindex_name,
+        ql::datum_range_t(ql::datum_t(static_cast<double>(sindex_value))),
+        ql::batchspec_t::default_for(ql::batch_type_t::NORMAL));
+}
+
 void _check_keys_are_present(store_t *store,
         sindex_name_t sindex_name) {
     ql::configured_limits_t limits;
@@ -284,6 +306,99 @@ TPTEST(RDBBtree, SindexPostConstruct) {
     check_keys_are_present(&store, sindex_name);
 }
 
+/* Returns all of the rows in the secondary index, in index order, once the index is
+ready. */
+std::vector<ql::datum_t> read_all_via_sindex(store_t *store,
+                                             const sindex_name_t &sindex_name) {
+    for (int i = 0; i < MAX_RETRIES_FOR_SINDEX_POSTCONSTRUCT; ++i) {
+        try {
+            ql::grouped_t<ql::stream_t> groups = read_range_via_sindex(
+                store,
+                sindex_name,
+                ql::datum_range_t::universe(),
+                ql::batchspec_t::all());
+            std::vector<ql::datum_t> rows;
+            for (auto &&group : groups) {
+                for (auto &&substream : group.second.substreams) {
+                    for (auto &&item : substream.second.stream) {
+                        rows.push_back(item.data);
+                    }
+                }
+            }
+            return rows;
+        } catch (const sindex_not_ready_exc_t&) { }
+        nap(500);
+    }
+    ADD_FAILURE() << "Sindex still not available after many tries.";
+    return std::vector<ql::datum_t>();
+}
+
+TPTEST(RDBBtree, SindexPostConstructSubranges) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    log_serializer_t::create(
+        &file_opener,
+        log_serializer_t::static_config_t());
+
+    log_serializer_t serializer(
+        log_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            region_t::universe(),
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            nullptr,
+            &io_backender,
+            base_path_t("."),
+            generate_uuid(),
+            update_sindexes_t::UPDATE);
+
+    insert_rows(0, (TOTAL_KEYS_TO_INSERT * 9) / 10, &store);
+
+    // Otherwise the parallel construction would only have a single sub-range.
+    {
+        cond_t dummy_interruptor;
+        distribution_progress_estimator_t progress_estimator(
+            &store, &dummy_interruptor);
+        ASSERT_LT(1u, progress_estimator.split_range(
+            key_range_t::universe(), SINDEX_POST_CONSTRUCTION_MAX_PARALLELISM).size());
+    }
+
+    size_t old_parallelism = rdb_protocol::sindex_post_construction_max_parallelism;
+    rdb_protocol::sindex_post_construction_max_parallelism = 1;
+    sindex_name_t serial_sindex_name = create_sindex(&store);
+    read_all_via_sindex(&store, serial_sindex_name);
+
+    // Writes that come in while the sub-ranges are being constructed have to end up in
+    // the index as well.
+    rdb_protocol::sindex_post_construction_max_parallelism =
+        SINDEX_POST_CONSTRUCTION_MAX_PARALLELISM;
+    sindex_name_t parallel_sindex_name = create_sindex(&store);
+    cond_t background_inserts_done;
+    spawn_writes(&store, &background_inserts_done);
+    background_inserts_done.wait();
+    std::vector<ql::datum_t> parallel_rows =
+        read_all_via_sindex(&store, parallel_sindex_name);
+    rdb_protocol::sindex_post_construction_max_parallelism = old_parallelism;
+
+    std::vector<ql::datum_t> serial_rows =
+        read_all_via_sindex(&store, serial_sindex_name);
+    ASSERT_EQ(static_cast<size_t>(TOTAL_KEYS_TO_INSERT), serial_rows.size());
+    EXPECT_EQ(serial_rows, parallel_rows);
+
+    check_keys_are_present(&store, parallel_sindex_name);
+}
+
 TPTEST(RDBBtree, SindexEraseRange) {
     recreate_temporary_directory(base_path_t("."));
     temp_file_t temp_file;
@@ -363,7 +478,8 @@ TPTEST(RDBBtree, SindexEraseRange) {
                 &mod_reports,
                 &deleted_range);
 
-            store.update_sindexes(txn.get(), &sindex_block, mod_reports, true);
+            store.update_sindexes(txn.get(), &sindex_block, mod_reports,
+                                  repli_timestamp_t::distant_past, true);
         }
         txn->commit();
     }
@@ -371,6 +487,181 @@ TPTEST(RDBBtree, SindexEraseRange) {
     check_keys_are_NOT_present(&store, sindex_name);
 }
 
+/* Collects the keys of a btree, and counts its leaves and how many of them are empty or
+underfull. */
+class leaf_stats_callback_t : public depth_first_traversal_callback_t {
+public:
+    explicit leaf_stats_callback_t(value_sizer_t *_sizer)
+        : sizer(_sizer), leaves(0), empty_leaves(0), underfull_leaves(0) { }
+
+    continue_bool_t handle_pre_leaf(
+            const counted_t<counted_buf_lock_and_read_t> &buf,
+            const btree_key_t *,
+            const btree_key_t *,
+            signal_t *,
+            bool *skip_out) {
+        *skip_out = false;
+        const leaf_node_t *node =
+            static_cast<const leaf_node_t *>(buf->read->get_data_read());
+        ++leaves;
+        if (leaf::is_empty(node)) {
+            ++empty_leaves;
+        }
+        if (leaf::is_underfull(sizer, node)) {
+            ++underfull_leaves;
+        }
+        return continue_bool_t::CONTINUE;
+    }
+
+    continue_bool_t handle_pair(scoped_key_value_t &&keyvalue, signal_t *) {
+        keys.push_back(store_key_t(keyvalue.key()));
+        return continue_bool_t::CONTINUE;
+    }
+
+    value_sizer_t *sizer;
+    std::vector<store_key_t> keys;
+    int leaves;
+    int empty_leaves;
+    int underfull_leaves;
+};
+
+leaf_stats_callback_t get_leaf_stats(store_t *store,
+                                     value_sizer_t *sizer,
+                                     int64_t *population_out) {
+    cond_t dummy_interruptor;
+    read_token_t token;
+    store->new_read_token(&token);
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    store->acquire_superblock_for_read(
+        &token, &txn, &superblock, &dummy_interruptor, false);
+    leaf_stats_callback_t stats(sizer);
+    btree_depth_first_traversal(
+        superblock.get(), key_range_t::universe(), &stats, access_t::read,
+        direction_t::FORWARD, release_superblock_t::KEEP, &dummy_interruptor);
+    guarantee(get_btree_population(superblock.get(), population_out));
+    return stats;
+}
+
+TPTEST(RDBBtree, EraseRangeAcrossLeaves) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    log_serializer_t::create(
+        &file_opener,
+        log_serializer_t::static_config_t());
+
+    log_serializer_t serializer(
+        log_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            region_t::universe(),
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            nullptr,
+            &io_backender,
+            base_path_t("."),
+            generate_uuid(),
+            update_sindexes_t::UPDATE);
+
+    cond_t dummy_interruptor;
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    rdb_value_sizer_t sizer(store.cache->max_block_size());
+    int64_t population;
+    leaf_stats_callback_t before = get_leaf_stats(&store, &sizer, &population);
+    ASSERT_EQ(TOTAL_KEYS_TO_INSERT, population);
+    ASSERT_EQ(static_cast<size_t>(TOTAL_KEYS_TO_INSERT), before.keys.size());
+    // Otherwise the range below wouldn't span several leaves.
+    ASSERT_LE(10, before.leaves);
+
+    /* Erase the middle 80% of the keys. */
+    const int erase_start = TOTAL_KEYS_TO_INSERT / 10;
+    const int erase_end = (TOTAL_KEYS_TO_INSERT * 9) / 10;
+    const key_range_t erase_range(
+        key_range_t::closed,
+        store_key_t(ql::datum_t(static_cast<double>(erase_start)).print_primary()),
+        key_range_t::open,
+        store_key_t(ql::datum_t(static_cast<double>(erase_end)).print_primary()));
+    std::vector<rdb_modification_report_t> mod_reports;
+    {
+        write_token_t token;
+        store.new_write_token(&token);
+
+        scoped_ptr_t<txn_t> txn;
+        {
+            scoped_ptr_t<real_superblock_t> super_block;
+            store.acquire_superblock_for_write(
+                1,
+                write_durability_t::SOFT,
+                &token,
+                &txn,
+                &super_block,
+                &dummy_interruptor);
+
+            const hash_region_t<key_range_t> test_range = hash_region_t<key_range_t>::universe();
+            rdb_protocol::range_key_tester_t tester(&test_range);
+            rdb_live_deletion_context_t deletion_context;
+            key_range_t deleted_range;
+            continue_bool_t res = rdb_erase_small_range(
+                store.btree.get(),
+                &tester,
+                erase_range,
+                super_block.get(),
+                &deletion_context,
+                &dummy_interruptor,
+                0,
+                &mod_reports,
+                &deleted_range);
+            EXPECT_EQ(continue_bool_t::CONTINUE, res);
+            EXPECT_EQ(erase_range, deleted_range);
+        }
+        txn->commit();
+    }
+
+    // There's one modification report per erased key, in key order.
+    ASSERT_EQ(static_cast<size_t>(erase_end - erase_start), mod_reports.size());
+    for (size_t i = 0; i < mod_reports.size(); ++i) {
+        EXPECT_EQ(before.keys[erase_start + i], mod_reports[i].primary_key);
+        EXPECT_TRUE(mod_reports[i].info.deleted.first.has());
+    }
+
+    leaf_stats_callback_t after = get_leaf_stats(&store, &sizer, &population);
+
+    // Only the keys outside of the range are left.
+    std::vector<store_key_t> expected_keys(before.keys.begin(),
+                                           before.keys.begin() + erase_start);
+    expected_keys.insert(expected_keys.end(),
+                         before.keys.begin() + erase_end, before.keys.end());
+    EXPECT_EQ(expected_keys, after.keys);
+
+    // The stat block was updated once per leaf, but it still counts every key.
+    EXPECT_EQ(static_cast<int64_t>(expected_keys.size()), population);
+
+    // The leaves that lost their keys were merged away or leveled with their
+    // siblings, rather than left behind empty.
+    EXPECT_EQ(0, after.empty_leaves);
+    EXPECT_LT(after.leaves * 2, before.leaves);
+
+    // The leaves that held nothing but erased keys were dropped from their parents, so
+    // their key ranges went to their neighbors. Writing the rows back fills them again.
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+    leaf_stats_callback_t refilled = get_leaf_stats(&store, &sizer, &population);
+    EXPECT_EQ(before.keys, refilled.keys);
+    EXPECT_EQ(TOTAL_KEYS_TO_INSERT, population);
+    EXPECT_EQ(0, refilled.empty_leaves);
+}
+
 TPTEST(RDBBtree, SindexInterruptionViaDrop) {
     recreate_temporary_directory(base_path_t("."));
     temp_file_t temp_file;
@@ -451,4 +742,369 @@ TPTEST(RDBBtree, SindexInterruptionViaStoreDelete) {
     store.reset();
 }
 
+/* Applies `writes` to `store` in order. Each write sets the row with the given id to
+`{"id": id, "g": group}`, or deletes it if the group is negative. */
+void write_grouped_rows(const std::vector<std::pair<int, int> > &writes,
+                        store_t *store) {
+    ql::configured_limits_t limits;
+    for (const auto &write : writes) {
+        cond_t dummy_interruptor;
+        scoped_ptr_t<txn_t> txn;
+        {
+            scoped_ptr_t<real_superblock_t> superblock;
+            write_token_t token;
+            store->new_write_token(&token);
+            store->acquire_superblock_for_write(
+                1, write_durability_t::SOFT,
+                &token, &txn, &superblock, &dummy_interruptor);
+            buf_lock_t sindex_block(
+                superblock->expose_buf(),
+                superblock->get_sindex_block_id(),
+                access_t::write);
+
+            store_key_t pk(
+                ql::datum_t(static_cast<double>(write.first)).print_primary());
+            rdb_modification_report_t mod_report(pk);
+            rdb_live_deletion_context_t deletion_context;
+            if (write.second >= 0) {
+                std::string data = strprintf(
+                    "{\"id\" : %d, \"g\" : %d}", write.first, write.second);
+                rapidjson::Document doc;
+                doc.Parse(data.c_str());
+                point_write_response_t response;
+                rdb_set(
+                    pk,
+                    ql::to_datum(doc, limits, reql_version_t::LATEST),
+                    true, store->btree.get(), repli_timestamp_t::distant_past,
+                    superblock.get(), &deletion_context, &response, &mod_report.info,
+                    static_cast<profile::trace_t *>(NULL));
+            } else {
+                point_delete_response_t response;
+                rdb_delete(
+                    pk, store->btree.get(), repli_timestamp_t::distant_past,
+                    superblock.get(), &deletion_context, delete_mode_t::REGULAR_QUERY,
+                    &response, &mod_report.info, static_cast<profile::trace_t *>(NULL));
+            }
+
+            store_t::sindex_access_vector_t sindexes;
+            store->acquire_all_sindex_superblocks_for_write(&sindex_block, &sindexes);
+            rdb_update_sindexes(
+                store,
+                sindexes,
+                &mod_report,
+                repli_timestamp_t::distant_past,
+                txn.get(),
+                &deletion_context,
+                nullptr,
+                nullptr,
+                nullptr);
+
+            new_mutex_in_line_t acq = store->get_in_line_for_sindex_queue(&sindex_block);
+            store->sindex_queue_push(mod_report, &acq);
+        }
+        txn->commit();
+    }
+}
+
+void write_grouped_rows_and_pulse_when_done(
+        const std::vector<std::pair<int, int> > &writes,
+        store_t *store, cond_t *pulse_when_done) {
+    write_grouped_rows(writes, store);
+    pulse_when_done->pulse();
+}
+
+/* Reads the counts of all groups from an aggregate index. Throws
+`sindex_not_ready_exc_t` while the index is being constructed. */
+ql::grouped_t<uint64_t> read_aggregate_counts(store_t *store,
+                                              const sindex_name_t &sindex_name) {
+    cond_t dummy_interruptor;
+    read_token_t token;
+    store->new_read_token(&token);
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    store->acquire_superblock_for_read(
+        &token, &txn, &superblock, &dummy_interruptor, true);
+
+    scoped_ptr_t<sindex_superblock_t> sindex_sb;
+    uuid_u sindex_uuid;
+    std::vector<char> opaque_definition;
+    bool sindex_exists = store->acquire_sindex_superblock_for_read(
+        sindex_name,
+        "",
+        superblock.get(),
+        &sindex_sb,
+        &opaque_definition,
+        &sindex_uuid,
+        release_superblock_t::RELEASE);
+    guarantee(sindex_exists);
+
+    rget_read_response_t res;
+    rdb_read_aggregate_sindex(
+        sindex_sb.get(),
+        ql::datumspec_t(ql::datum_range_t::universe()),
+        key_range_t::universe(),
+        &res,
+        release_superblock_t::RELEASE);
+    ql::grouped_t<uint64_t> *counts = boost::get<ql::grouped_t<uint64_t> >(&res.result);
+    guarantee(counts != nullptr);
+    return *counts;
+}
+
+TPTEST(RDBBtree, AggregateSindexPostConstruct) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    log_serializer_t::create(
+        &file_opener,
+        log_serializer_t::static_config_t());
+
+    log_serializer_t serializer(
+        log_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            region_t::universe(),
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            nullptr,
+            &io_backender,
+            base_path_t("."),
+            generate_uuid(),
+            update_sindexes_t::UPDATE);
+
+    // The final group of every row, or -1 if it doesn't exist.
+    std::vector<int> groups(TOTAL_KEYS_TO_INSERT, -1);
+    std::vector<std::pair<int, int> > initial_writes;
+    for (int i = 0; i < (TOTAL_KEYS_TO_INSERT * 9) / 10; ++i) {
+        initial_writes.push_back(std::make_pair(i, i % 3));
+        groups[i] = i % 3;
+    }
+    write_grouped_rows(initial_writes, &store);
+
+    std::string name = uuid_to_str(generate_uuid());
+    ql::sym_t one(1);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    sindex_config_t config(
+        ql::map_wire_func_t(r.var(one)["g"].root_term(), make_vector(one)),
+        reql_version_t::LATEST,
+        sindex_multi_bool_t::SINGLE,
+        sindex_geo_bool_t::REGULAR,
+        sindex_aggregate_bool_t::AGGREGATE,
+        sindex_reference_bool_t::COPY,
+        boost::none,
+        0);
+    cond_t non_interruptor;
+    store.sindex_create(name, config, &non_interruptor);
+
+    // While the index is being constructed, rows move between groups, get deleted
+    // and get inserted, all over the key range. Some rows are written more than
+    // once.
+    std::vector<std::pair<int, int> > concurrent_writes;
+    for (int i = 0; i < TOTAL_KEYS_TO_INSERT; ++i) {
+        int group;
+        if (i % 4 == 0) {
+            group = 3;
+        } else if (i % 4 == 1) {
+            group = -1;
+        } else if (i >= (TOTAL_KEYS_TO_INSERT * 9) / 10) {
+            group = i % 3;
+        } else {
+            continue;
+        }
+        concurrent_writes.push_back(std::make_pair(i, group));
+        groups[i] = group;
+    }
+    for (int i = 0; i < TOTAL_KEYS_TO_INSERT; i += 8) {
+        concurrent_writes.push_back(std::make_pair(i, 4));
+        groups[i] = 4;
+    }
+    cond_t concurrent_writes_done;
+    coro_t::spawn_sometime(std::bind(&write_grouped_rows_and_pulse_when_done,
+                                     concurrent_writes, &store,
+                                     &concurrent_writes_done));
+    concurrent_writes_done.wait();
+
+    ql::grouped_t<uint64_t> expected;
+    for (int group : groups) {
+        if (group >= 0) {
+            expected[ql::datum_t(static_cast<double>(group))] += 1;
+        }
+    }
+
+    for (int i = 0; i < MAX_RETRIES_FOR_SINDEX_POSTCONSTRUCT; ++i) {
+        try {
+            ql::grouped_t<uint64_t> counts =
+                read_aggregate_counts(&store, sindex_name_t(name));
+            ASSERT_EQ(expected.size(), counts.size());
+            for (const auto &pair : expected) {
+                EXPECT_EQ(pair.second, counts[pair.first]);
+            }
+            return;
+        } catch (const sindex_not_ready_exc_t &) { }
+        nap(500);
+    }
+    ADD_FAILURE() << "Sindex still not available after many tries.";
+}
+
+/* Reads the whole primary B-tree of `store` through `rdb_rget_slice()`, mapping every
+row to `[row.id]` (or to an error for the ids in `error_ids`) before `terminal`. */
+ql::result_t read_all_with_terminal(store_t *store,
+                                    const ql::terminal_variant_t &terminal,
+                                    sorting_t sorting,
+                                    const std::vector<double> &error_ids) {
+    cond_t dummy_interruptor;
+    read_token_t token;
+    store->new_read_token(&token);
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    store->acquire_superblock_for_read(
+        &token, &txn, &superblock, &dummy_interruptor, false);
+
+    const ql::sym_t x(1);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    ql::minidriver_t::reql_t body = r.array(r.var(x)["id"]);
+    for (double id : error_ids) {
+        body = r.branch(r.var(x)["id"] == id,
+                        r.error(strprintf("error at %g", id)),
+                        body);
+    }
+    std::vector<ql::transform_variant_t> transforms;
+    transforms.push_back(ql::map_wire_func_t(body.root_term(), make_vector(x)));
+
+    ql::env_t env(&dummy_interruptor,
+                  ql::return_empty_normal_batches_t::NO,
+                  reql_version_t::LATEST);
+    rget_read_response_t res;
+    rdb_rget_slice(
+        store->btree.get(),
+        region_t::universe(),
+        key_range_t::universe(),
+        boost::none,
+        superblock.get(),
+        &env,
+        ql::batchspec_t::all(),
+        transforms,
+        terminal,
+        sorting,
+        &res,
+        release_superblock_t::RELEASE);
+    return res.result;
+}
+
+/* Returns the single, ungrouped value of a terminal's result. */
+ql::datum_t ungrouped_value(ql::result_t result) {
+    ql::grouped_t<ql::datum_t> *groups =
+        boost::get<ql::grouped_t<ql::datum_t> >(&result);
+    guarantee(groups != nullptr);
+    guarantee(groups->size() == 1);
+    return groups->begin()->second;
+}
+
+TPTEST(RDBBtree, RangeReadSubranges) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    log_serializer_t::create(
+        &file_opener,
+        log_serializer_t::static_config_t());
+
+    log_serializer_t serializer(
+        log_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            region_t::universe(),
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            nullptr,
+            &io_backender,
+            base_path_t("."),
+            generate_uuid(),
+            update_sindexes_t::UPDATE);
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    // A thousand rows are far below the default threshold.
+    int64_t old_min_rows = rget_subrange_min_rows;
+    rget_subrange_min_rows = 1;
+
+    {
+        cond_t dummy_interruptor;
+        read_token_t token;
+        store.new_read_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store.acquire_superblock_for_read(
+            &token, &txn, &superblock, &dummy_interruptor, false);
+        std::vector<key_range_t> subranges =
+            split_rget_range(superblock.get(), key_range_t::universe(), 3);
+        // The sub-ranges are consecutive and cover the range, and there are no more
+        // of them than allowed.
+        ASSERT_LE(2u, subranges.size());
+        ASSERT_GE(3u, subranges.size());
+        EXPECT_EQ(store_key_t::min(), subranges.front().left);
+        EXPECT_TRUE(subranges.back().right.unbounded);
+        for (size_t i = 0; i + 1 < subranges.size(); ++i) {
+            EXPECT_FALSE(subranges[i].right.unbounded);
+            EXPECT_EQ(subranges[i].right.key(), subranges[i + 1].left);
+            EXPECT_TRUE(subranges[i].left < subranges[i].right.key());
+        }
+    }
+
+    // The sub-range results are merged in key order, so concatenating the rows gives
+    // them in the order of the read.
+    std::vector<ql::datum_t> ascending;
+    for (int i = 0; i < TOTAL_KEYS_TO_INSERT; ++i) {
+        ascending.push_back(ql::datum_t(static_cast<double>(i)));
+    }
+    std::vector<ql::datum_t> descending(ascending.rbegin(), ascending.rend());
+    const ql::sym_t a(1), b(2);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    ql::terminal_variant_t concat = ql::reduce_wire_func_t(
+        (r.var(a) + r.var(b)).root_term(), make_vector(a, b));
+    ql::configured_limits_t limits;
+    EXPECT_EQ(ql::datum_t(std::move(ascending), limits),
+              ungrouped_value(read_all_with_terminal(
+                  &store, concat, sorting_t::ASCENDING, {})));
+    EXPECT_EQ(ql::datum_t(std::move(descending), limits),
+              ungrouped_value(read_all_with_terminal(
+                  &store, concat, sorting_t::DESCENDING, {})));
+
+    EXPECT_EQ(ql::datum_t(static_cast<double>(TOTAL_KEYS_TO_INSERT)),
+              ungrouped_value(read_all_with_terminal(
+                  &store, ql::count_wire_func_t(), sorting_t::UNORDERED, {})));
+
+    // A sub-range that fails truncates the result to the error that comes first in
+    // the order of the read, like a single traversal would.
+    std::vector<double> error_ids{100, TOTAL_KEYS_TO_INSERT - 100};
+    ql::result_t ascending_error = read_all_with_terminal(
+        &store, concat, sorting_t::ASCENDING, error_ids);
+    ASSERT_TRUE(boost::get<ql::exc_t>(&ascending_error) != nullptr);
+    EXPECT_EQ(std::string("error at 100"),
+              boost::get<ql::exc_t>(ascending_error).what());
+    ql::result_t descending_error = read_all_with_terminal(
+        &store, concat, sorting_t::DESCENDING, error_ids);
+    ASSERT_TRUE(boost::get<ql::exc_t>(&descending_error) != nullptr);
+    EXPECT_EQ(strprintf("error at %d", TOTAL_KEYS_TO_INSERT - 100),
+              boost::get<ql::exc_t>(descending_error).what());
+
+    rget_subrange_min_rows = old_min_rows;
+}
+
 } //namespace unittest
@@ -0,0 +1,330 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "arch/timing.hpp"
+#include "buffer_cache/cache_balancer.hpp"
+#include "clustering/administration/metadata.hpp"
+#include "extproc/extproc_pool.hpp"
+#include "rdb_protocol/changefeed.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/store.hpp"
+#include "rdb_protocol/sym.hpp"
+#include "serializer/log/log_serializer.hpp"
+#include "stl_utils.hpp"
+#include "unittest/clustering_utils.hpp"
+#include "unittest/dummy_metadata_controller.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+using ql::changefeed::msg_t;
+using ql::changefeed::stamped_msg_t;
+
+/* A `server_t` on top of an empty store, which provides the stamp lock and the
+perfmons the server uses. */
+class changefeed_server_test_t {
+public:
+    changefeed_server_test_t()
+        : io_backender(file_direct_io_mode_t::buffered_desired),
+          balancer(GIGABYTE) {
+        recreate_temporary_directory(base_path_t("."));
+        temp_file.init(new temp_file_t);
+        file_opener.init(new filepath_file_opener_t(temp_file->name(), &io_backender));
+        log_serializer_t::create(
+            file_opener.get(),
+            log_serializer_t::static_config_t());
+        serializer.init(new log_serializer_t(
+            log_serializer_t::dynamic_config_t(),
+            file_opener.get(),
+            &get_global_perfmon_collection()));
+        store.init(new store_t(
+            region_t::universe(),
+            serializer.get(),
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            nullptr,
+            &io_backender,
+            base_path_t("."),
+            generate_uuid(),
+            update_sindexes_t::UPDATE));
+        server.init(new ql::changefeed::server_t(
+            cluster.get_mailbox_manager(), store.get()));
+    }
+
+    /* Stamps and sends a change the way a write to the store does. */
+    void send_change(const store_key_t &pkey,
+                     ql::datum_t old_val,
+                     ql::datum_t new_val) {
+        rwlock_in_line_t stamp_spot(&store->cfeed_stamp_lock, access_t::write);
+        server->send_all(
+            msg_t(msg_t::change_t{index_vals_t(),
+                                  index_vals_t(),
+                                  pkey,
+                                  std::move(old_val),
+                                  std::move(new_val)}),
+            pkey,
+            &stamp_spot,
+            server->get_keepalive());
+    }
+
+    simple_mailbox_cluster_t cluster;
+    io_backender_t io_backender;
+    dummy_cache_balancer_t balancer;
+    scoped_ptr_t<temp_file_t> temp_file;
+    scoped_ptr_t<filepath_file_opener_t> file_opener;
+    scoped_ptr_t<log_serializer_t> serializer;
+    scoped_ptr_t<store_t> store;
+    scoped_ptr_t<ql::changefeed::server_t> server;
+};
+
+/* Stands in for a `real_feed_t`, keeping every batch it receives. */
+class changefeed_test_client_t {
+public:
+    explicit changefeed_test_client_t(mailbox_manager_t *manager)
+        : mailbox(manager, [this](signal_t *, const stamped_msg_t &msg) {
+              batches.push_back(msg);
+          }) { }
+
+    /* Batches can arrive out of order, the real client sorts them by stamp. */
+    std::vector<stamped_msg_t> get_sorted_batches() const {
+        std::vector<stamped_msg_t> sorted = batches;
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const stamped_msg_t &a, const stamped_msg_t &b) {
+                      return a.stamp < b.stamp;
+                  });
+        return sorted;
+    }
+
+    /* The changes received so far, in stamp order. */
+    std::vector<msg_t::change_t> get_changes() const {
+        std::vector<msg_t::change_t> changes;
+        for (const auto &batch : get_sorted_batches()) {
+            for (const auto &submsg : batch.submsgs) {
+                if (const msg_t::change_t *change =
+                        boost::get<msg_t::change_t>(&submsg.op)) {
+                    changes.push_back(*change);
+                }
+            }
+        }
+        return changes;
+    }
+
+    void wait_for_changes(size_t count) const {
+        for (int i = 0; i < 1000 && get_changes().size() < count; ++i) {
+            nap(10);
+        }
+        ASSERT_EQ(count, get_changes().size());
+    }
+
+    std::vector<stamped_msg_t> batches;
+    mailbox_t<void(stamped_msg_t)> mailbox;
+};
+
+store_key_t changefeed_test_key(int i) {
+    return store_key_t(ql::datum_t(static_cast<double>(i)).print_primary());
+}
+
+/* Checks that the batches have consecutive stamps starting at 0, and that none of
+them is bigger than `server_t::MAX_BATCH_SIZE`. */
+void check_stamps(const changefeed_test_client_t &client, size_t count) {
+    uint64_t next_stamp = 0;
+    for (const auto &batch : client.get_sorted_batches()) {
+        EXPECT_EQ(next_stamp, batch.stamp);
+        EXPECT_GE(128u, batch.submsgs.size());
+        next_stamp += batch.submsgs.size();
+    }
+    EXPECT_EQ(count, next_stamp);
+}
+
+/* Also checks that the changes have the new values 0 to `count - 1` in stamp
+order. */
+void check_batches(const changefeed_test_client_t &client, size_t count) {
+    check_stamps(client, count);
+    std::vector<msg_t::change_t> changes = client.get_changes();
+    ASSERT_EQ(count, changes.size());
+    for (size_t i = 0; i < count; ++i) {
+        EXPECT_EQ(ql::datum_t(static_cast<double>(i)), changes[i].new_val);
+    }
+}
+
+TPTEST(RDBChangefeed, BatchFlushesWhenFull) {
+    changefeed_server_test_t test;
+    changefeed_test_client_t client(test.cluster.get_mailbox_manager());
+    auto keepalive = test.server->get_keepalive();
+    test.server->add_client(
+        client.mailbox.get_address(), region_t::universe(), nullptr,
+        ql::global_optargs_t(), auth::user_context_t(), {}, keepalive);
+    boost::optional<uint64_t> stamp =
+        test.server->get_stamp(client.mailbox.get_address(), keepalive);
+    ASSERT_TRUE(static_cast<bool>(stamp));
+    ASSERT_EQ(0u, *stamp);
+
+    // None of these yield, so the batch only gets sent early when it's full.
+    const size_t count = 300;
+    for (size_t i = 0; i < count; ++i) {
+        test.send_change(changefeed_test_key(i),
+                         ql::datum_t(),
+                         ql::datum_t(static_cast<double>(i)));
+    }
+    client.wait_for_changes(count);
+
+    std::vector<stamped_msg_t> sorted = client.get_sorted_batches();
+    ASSERT_LE(3u, sorted.size());
+    EXPECT_EQ(128u, sorted[0].submsgs.size());
+    check_batches(client, count);
+}
+
+TPTEST(RDBChangefeed, BatchFlushesOnYield) {
+    changefeed_server_test_t test;
+    changefeed_test_client_t client(test.cluster.get_mailbox_manager());
+    auto keepalive = test.server->get_keepalive();
+    test.server->add_client(
+        client.mailbox.get_address(), region_t::universe(), nullptr,
+        ql::global_optargs_t(), auth::user_context_t(), {}, keepalive);
+    boost::optional<uint64_t> stamp =
+        test.server->get_stamp(client.mailbox.get_address(), keepalive);
+    ASSERT_TRUE(static_cast<bool>(stamp));
+    ASSERT_EQ(0u, *stamp);
+
+    for (size_t i = 0; i < 10; ++i) {
+        test.send_change(changefeed_test_key(i),
+                         ql::datum_t(),
+                         ql::datum_t(static_cast<double>(i)));
+    }
+    // The partial batch goes out once the sender gives other coroutines a chance
+    // to run, and the next change starts a new batch.
+    client.wait_for_changes(10);
+    ASSERT_EQ(1u, client.batches.size());
+    for (size_t i = 10; i < 20; ++i) {
+        test.send_change(changefeed_test_key(i),
+                         ql::datum_t(),
+                         ql::datum_t(static_cast<double>(i)));
+    }
+    client.wait_for_changes(20);
+    ASSERT_EQ(2u, client.batches.size());
+    EXPECT_EQ(10u, client.batches[1].stamp);
+    check_batches(client, 20);
+}
+
+TPTEST(RDBChangefeed, SharedMessageStampedPerClient) {
+    changefeed_server_test_t test;
+    auto keepalive = test.server->get_keepalive();
+    changefeed_test_client_t early(test.cluster.get_mailbox_manager());
+    test.server->add_client(
+        early.mailbox.get_address(), region_t::universe(), nullptr,
+        ql::global_optargs_t(), auth::user_context_t(), {}, keepalive);
+    ASSERT_TRUE(static_cast<bool>(
+        test.server->get_stamp(early.mailbox.get_address(), keepalive)));
+    for (size_t i = 0; i < 3; ++i) {
+        test.send_change(changefeed_test_key(i),
+                         ql::datum_t(),
+                         ql::datum_t(static_cast<double>(i)));
+    }
+    early.wait_for_changes(3);
+
+    // The other clients start counting their stamps at 0 even though `early` is
+    // ahead, so every client gets the same serialized change under its own stamp.
+    std::vector<scoped_ptr_t<changefeed_test_client_t> > late(2);
+    for (auto &&client : late) {
+        client.init(new changefeed_test_client_t(test.cluster.get_mailbox_manager()));
+        test.server->add_client(
+            client->mailbox.get_address(), region_t::universe(), nullptr,
+            ql::global_optargs_t(), auth::user_context_t(), {}, keepalive);
+        boost::optional<uint64_t> stamp =
+            test.server->get_stamp(client->mailbox.get_address(), keepalive);
+        ASSERT_TRUE(static_cast<bool>(stamp));
+        ASSERT_EQ(0u, *stamp);
+    }
+    for (size_t i = 3; i < 8; ++i) {
+        test.send_change(changefeed_test_key(i),
+                         ql::datum_t(),
+                         ql::datum_t(static_cast<double>(i)));
+    }
+
+    early.wait_for_changes(8);
+    check_batches(early, 8);
+    std::vector<msg_t::change_t> early_changes = early.get_changes();
+    for (const auto &client : late) {
+        client->wait_for_changes(5);
+        check_stamps(*client, 5);
+        std::vector<msg_t::change_t> changes = client->get_changes();
+        ASSERT_EQ(5u, changes.size());
+        for (size_t i = 0; i < changes.size(); ++i) {
+            const msg_t::change_t &expected = early_changes[i + 3];
+            EXPECT_EQ(expected.pkey, changes[i].pkey);
+            EXPECT_FALSE(changes[i].old_val.has());
+            EXPECT_EQ(expected.new_val, changes[i].new_val);
+        }
+        for (const auto &batch : client->batches) {
+            EXPECT_EQ(test.server->get_uuid(), batch.server_uuid);
+        }
+    }
+}
+
+ql::datum_t changefeed_test_row(int id, int v) {
+    ql::datum_object_builder_t builder;
+    builder.overwrite("id", ql::datum_t(static_cast<double>(id)));
+    builder.overwrite("v", ql::datum_t(static_cast<double>(v)));
+    return std::move(builder).to_datum();
+}
+
+TPTEST(RDBChangefeed, FilteredFeedRowsMoveInAndOut) {
+    changefeed_server_test_t test;
+    extproc_pool_t extproc_pool(2);
+    dummy_semilattice_controller_t<auth_semilattice_metadata_t> auth_manager;
+    rdb_context_t ctx(&extproc_pool, nullptr, auth_manager.get_view());
+    auto keepalive = test.server->get_keepalive();
+
+    // `filtered` only wants the rows with `v > 5`, `unfiltered` gets everything.
+    ql::sym_t x(1);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    std::vector<ql::transform_variant_t> transforms;
+    transforms.push_back(ql::filter_wire_func_t(
+        ql::wire_func_t((r.var(x)["v"] > 5).root_term(), make_vector(x)),
+        boost::none));
+    changefeed_test_client_t filtered(test.cluster.get_mailbox_manager());
+    test.server->add_client(
+        filtered.mailbox.get_address(), region_t::universe(), &ctx,
+        ql::global_optargs_t(), auth::user_context_t(), transforms, keepalive);
+    changefeed_test_client_t unfiltered(test.cluster.get_mailbox_manager());
+    test.server->add_client(
+        unfiltered.mailbox.get_address(), region_t::universe(), nullptr,
+        ql::global_optargs_t(), auth::user_context_t(), {}, keepalive);
+    ASSERT_TRUE(static_cast<bool>(
+        test.server->get_stamp(filtered.mailbox.get_address(), keepalive)));
+    ASSERT_TRUE(static_cast<bool>(
+        test.server->get_stamp(unfiltered.mailbox.get_address(), keepalive)));
+
+    store_key_t pkey = changefeed_test_key(1);
+    // Inserted outside the selection.
+    test.send_change(pkey, ql::datum_t(), changefeed_test_row(1, 1));
+    // Moves into it.
+    test.send_change(pkey, changefeed_test_row(1, 1), changefeed_test_row(1, 10));
+    // Changes within it.
+    test.send_change(pkey, changefeed_test_row(1, 10), changefeed_test_row(1, 20));
+    // Moves out of it.
+    test.send_change(pkey, changefeed_test_row(1, 20), changefeed_test_row(1, 2));
+    // Deleted outside of it.
+    test.send_change(pkey, changefeed_test_row(1, 2), ql::datum_t());
+
+    unfiltered.wait_for_changes(5);
+    check_stamps(unfiltered, 5);
+    filtered.wait_for_changes(3);
+    // The changes that don't make it through the filter don't use up stamps.
+    check_stamps(filtered, 3);
+    std::vector<msg_t::change_t> changes = filtered.get_changes();
+    ASSERT_EQ(3u, changes.size());
+    EXPECT_FALSE(changes[0].old_val.has());
+    EXPECT_EQ(changefeed_test_row(1, 10), changes[0].new_val);
+    EXPECT_EQ(changefeed_test_row(1, 10), changes[1].old_val);
+    EXPECT_EQ(changefeed_test_row(1, 20), changes[1].new_val);
+    EXPECT_EQ(changefeed_test_row(1, 20), changes[2].old_val);
+    EXPECT_FALSE(changes[2].new_val.has());
+}
+
+}  // namespace unittest
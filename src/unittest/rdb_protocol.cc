@@ -1,12 +1,14 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "unittest/rdb_protocol.hpp"
 
+#include <algorithm>
 #include <vector>
 
 #include "errors.hpp"
 #include <boost/function.hpp>
 
 #include "arch/io/disk.hpp"
+#include "btree/reql_specific.hpp"
 #include "buffer_cache/cache_balancer.hpp"
 #include "clustering/administration/artificial_reql_cluster_interface.hpp"
 #include "clustering/administration/metadata.hpp"
@@ -14,6 +16,7 @@
 #include "extproc/extproc_pool.hpp"
 #include "extproc/extproc_spawner.hpp"
 #include "rdb_protocol/changefeed.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/store.hpp"
@@ -216,7 +219,11 @@ std::string create_sindex(const std::vector<scoped_ptr_t<store_t> > *stores) {
         ql::map_wire_func_t(mapping, make_vector(arg)),
         reql_version_t::LATEST,
         sindex_multi_bool_t::SINGLE,
-        sindex_geo_bool_t::REGULAR);
+        sindex_geo_bool_t::REGULAR,
+        sindex_aggregate_bool_t::REGULAR,
+        sindex_reference_bool_t::COPY,
+        boost::none,
+        0);
 
     cond_t non_interruptor;
     for (const auto &store : *stores) {
@@ -881,6 +888,236 @@ TEST(RDBProtocol, OvershardedMissingAttr) {
     run_in_thread_pool_with_namespace_interface(&run_sindex_missing_attr_test, true);
 }
 
+/* Inserts `docs` as a single batch, in that order, and returns the stats. If
+`event_log_out` isn't null, the write is profiled and the events are stored there. */
+ql::datum_t insert_docs(namespace_interface_t *nsi,
+                        order_source_t *osource,
+                        std::vector<ql::datum_t> &&docs,
+                        conflict_behavior_t conflict_behavior,
+                        return_changes_t return_changes,
+                        profile::event_log_t *event_log_out = nullptr) {
+    write_t write(
+        batched_insert_t(
+            std::move(docs),
+            "id",
+            boost::none,
+            conflict_behavior,
+            boost::none,
+            ql::configured_limits_t(),
+            serializable_env_t{
+                ql::global_optargs_t(),
+                auth::user_context_t(auth::permissions_t(true, true, false, false)),
+                ql::datum_t()},
+            return_changes,
+            presorted_t::NO),
+        DURABILITY_REQUIREMENT_DEFAULT,
+        event_log_out != nullptr ? profile_bool_t::PROFILE : profile_bool_t::DONT_PROFILE,
+        ql::configured_limits_t());
+    write_response_t response;
+    cond_t interruptor;
+    nsi->write(
+        auth::user_context_t(auth::permissions_t(true, true, false, false)),
+        write,
+        &response,
+        osource->check_in("unittest::insert_docs(rdb_protocol.cc)"),
+        &interruptor);
+    if (event_log_out != nullptr) {
+        *event_log_out = response.event_log;
+    }
+    ql::datum_t *stats = boost::get<ql::datum_t>(&response.response);
+    guarantee(stats != nullptr);
+    return *stats;
+}
+
+/* Inserts a row `{id: i}` for each `i` in `ids` as a single batch, in that order, and
+returns the stats. */
+ql::datum_t insert_batch(namespace_interface_t *nsi,
+                         order_source_t *osource,
+                         const std::vector<double> &ids,
+                         return_changes_t return_changes) {
+    std::vector<ql::datum_t> inserts;
+    for (double id : ids) {
+        ql::datum_object_builder_t doc;
+        doc.overwrite("id", ql::datum_t(id));
+        inserts.push_back(std::move(doc).to_datum());
+    }
+    return insert_docs(
+        nsi, osource, std::move(inserts), conflict_behavior_t::ERROR, return_changes);
+}
+
+store_key_t primary_key_for(double id) {
+    return store_key_t(ql::datum_t(id).print_primary());
+}
+
+/* `AppendDetection` checks that batches of inserts past the end of the B-tree are
+sent to the bulk loader without `presorted`, and other batches aren't. The store makes
+that decision with `might_be_append()`. Numeric keys all land in the first shard. */
+void run_append_detection_test(
+        namespace_interface_t *nsi,
+        order_source_t *osource,
+        const std::vector<scoped_ptr_t<store_t> > *stores) {
+    btree_slice_t *btree = (*stores)[0]->btree.get();
+    EXPECT_TRUE(btree->might_be_append(primary_key_for(0)));
+
+    std::vector<double> ids;
+    for (int i = 0; i < 100; ++i) {
+        ids.push_back(i);
+    }
+    insert_batch(nsi, osource, ids, return_changes_t::NO);
+    // Only the bulk loader sets the hint from scratch.
+    EXPECT_TRUE(btree->might_be_append(primary_key_for(100)));
+    EXPECT_FALSE(btree->might_be_append(primary_key_for(50.5)));
+
+    // This batch takes the regular path and doesn't move the hint.
+    insert_batch(nsi, osource, {50.5, 20.5}, return_changes_t::NO);
+    EXPECT_TRUE(btree->might_be_append(primary_key_for(100)));
+
+    // Regular inserts past the end move the hint along.
+    insert_batch(nsi, osource, {1000, 200}, return_changes_t::NO);
+    EXPECT_FALSE(btree->might_be_append(primary_key_for(500)));
+    EXPECT_TRUE(btree->might_be_append(primary_key_for(1001)));
+}
+
+TEST(RDBProtocol, AppendDetection) {
+    run_in_thread_pool_with_namespace_interface(&run_append_detection_test, false);
+}
+
+ql::datum_t make_doc(double id, double v) {
+    ql::datum_object_builder_t doc;
+    doc.overwrite("id", ql::datum_t(id));
+    doc.overwrite("v", ql::datum_t(v));
+    return std::move(doc).to_datum();
+}
+
+bool has_profile_event(const profile::event_log_t &event_log,
+                       const std::string &description) {
+    for (const profile::event_t &event : event_log) {
+        const profile::start_t *start = boost::get<profile::start_t>(&event);
+        if (start != nullptr && start->description_ == description) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Returns the `new_val.v` of each entry of the `changes` in `stats`. */
+std::vector<double> changed_values(const ql::datum_t &stats) {
+    std::vector<double> values;
+    ql::datum_t changes = stats.get_field("changes");
+    for (size_t i = 0; i < changes.arr_size(); ++i) {
+        values.push_back(changes.get(i).get_field("new_val").get_field("v").as_num());
+    }
+    return values;
+}
+
+/* `BatchedInsertOrder` checks that batches are written in key order, but that their
+results still come back in the order of the batch. */
+void run_batched_insert_order_test(
+        namespace_interface_t *nsi,
+        order_source_t *osource,
+        UNUSED const std::vector<scoped_ptr_t<store_t> > *stores) {
+    std::vector<double> ids;
+    for (int i = 0; i < 100; ++i) {
+        ids.push_back(i);
+    }
+    insert_batch(nsi, osource, ids, return_changes_t::NO);
+
+    {
+        // An append that isn't sorted still goes to the bulk loader.
+        std::vector<ql::datum_t> docs;
+        docs.push_back(make_doc(130, 0));
+        docs.push_back(make_doc(110, 1));
+        docs.push_back(make_doc(120, 2));
+        profile::event_log_t event_log;
+        ql::datum_t stats = insert_docs(nsi, osource, std::move(docs),
+            conflict_behavior_t::ERROR, return_changes_t::YES, &event_log);
+        EXPECT_TRUE(has_profile_event(event_log, "Perform bulk insert."));
+        EXPECT_EQ(3, stats.get_field("inserted").as_int());
+        EXPECT_EQ(std::vector<double>({0, 1, 2}), changed_values(stats));
+    }
+
+    {
+        // Replaces of the same key happen in the order of the batch.
+        std::vector<ql::datum_t> docs;
+        docs.push_back(make_doc(50, 0));
+        docs.push_back(make_doc(10, 1));
+        docs.push_back(make_doc(50, 2));
+        profile::event_log_t event_log;
+        ql::datum_t stats = insert_docs(nsi, osource, std::move(docs),
+            conflict_behavior_t::UPDATE, return_changes_t::YES, &event_log);
+        EXPECT_TRUE(has_profile_event(event_log, "Perform parallel replaces."));
+        EXPECT_EQ(3, stats.get_field("replaced").as_int());
+        EXPECT_EQ(std::vector<double>({0, 1, 2}), changed_values(stats));
+        ql::datum_t changes = stats.get_field("changes");
+        ASSERT_EQ(3u, changes.arr_size());
+        EXPECT_EQ(0, changes.get(2).get_field("old_val").get_field("v").as_num());
+    }
+
+    {
+        // `first_error` belongs to the first failing row of the batch.
+        std::vector<ql::datum_t> docs;
+        docs.push_back(make_doc(70, 0));
+        docs.push_back(make_doc(60, 0));
+        ql::datum_t stats = insert_docs(nsi, osource, std::move(docs),
+            conflict_behavior_t::ERROR, return_changes_t::NO);
+        EXPECT_EQ(2, stats.get_field("errors").as_int());
+        std::string first_error = stats.get_field("first_error").as_str().to_std();
+        EXPECT_NE(std::string::npos, first_error.find("70"));
+        EXPECT_EQ(std::string::npos, first_error.find("60"));
+    }
+}
+
+TEST(RDBProtocol, BatchedInsertOrder) {
+    run_in_thread_pool_with_namespace_interface(&run_batched_insert_order_test, false);
+}
+
+/* `BatchedInsertSharedLeaves` fills the gaps between existing rows with batches that
+don't look like appends, so that many rows of a batch go into the same leaf, and then
+grows the rows until the leaves have to split. */
+void run_batched_insert_shared_leaves_test(
+        namespace_interface_t *nsi,
+        order_source_t *osource,
+        UNUSED const std::vector<scoped_ptr_t<store_t> > *stores) {
+    const int count = 1000;
+    std::vector<double> even_ids;
+    std::vector<double> odd_ids;
+    for (int i = 0; i < count; ++i) {
+        even_ids.push_back(2 * i);
+        odd_ids.push_back(2 * i + 1);
+    }
+    insert_batch(nsi, osource, even_ids, return_changes_t::NO);
+    std::random_shuffle(odd_ids.begin(), odd_ids.end());
+    ql::datum_t stats = insert_batch(nsi, osource, odd_ids, return_changes_t::NO);
+    EXPECT_EQ(count, stats.get_field("inserted").as_int());
+
+    // Every row is there now, so inserting any of them again fails.
+    std::vector<double> all_ids = even_ids;
+    all_ids.insert(all_ids.end(), odd_ids.begin(), odd_ids.end());
+    std::random_shuffle(all_ids.begin(), all_ids.end());
+    stats = insert_batch(nsi, osource, all_ids, return_changes_t::NO);
+    EXPECT_EQ(2 * count, stats.get_field("errors").as_int());
+
+    std::vector<ql::datum_t> docs;
+    for (double id : all_ids) {
+        ql::datum_object_builder_t doc;
+        doc.overwrite("id", ql::datum_t(id));
+        doc.overwrite("padding", ql::datum_t(datum_string_t(std::string(100, 'x'))));
+        docs.push_back(std::move(doc).to_datum());
+    }
+    stats = insert_docs(nsi, osource, std::move(docs),
+        conflict_behavior_t::UPDATE, return_changes_t::NO);
+    EXPECT_EQ(2 * count, stats.get_field("replaced").as_int());
+    EXPECT_EQ(0, stats.get_field("errors").as_int());
+
+    stats = insert_batch(nsi, osource, all_ids, return_changes_t::NO);
+    EXPECT_EQ(2 * count, stats.get_field("errors").as_int());
+}
+
+TEST(RDBProtocol, BatchedInsertSharedLeaves) {
+    run_in_thread_pool_with_namespace_interface(
+        &run_batched_insert_shared_leaves_test, false);
+}
+
 TPTEST(RDBProtocol, ArtificialChangefeeds) {
     using ql::changefeed::artificial_t;
     using ql::changefeed::keyspec_t;
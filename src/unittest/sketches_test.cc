@@ -0,0 +1,44 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include <math.h>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/sketches.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(SketchesTest, HyperLogLog) {
+    ql::hyperloglog_t small;
+    for (int i = 0; i < 300; ++i) {
+        small.add(ql::datum_t(static_cast<double>(i % 100)));
+        small.add(ql::datum_t(strprintf("%d", i % 100).c_str()));
+    }
+    // Small sets are counted exactly.
+    ASSERT_EQ(200u, small.estimate());
+
+    ql::hyperloglog_t left, right;
+    for (int i = 0; i < 60000; ++i) {
+        left.add(ql::datum_t(static_cast<double>(i)));
+        right.add(ql::datum_t(static_cast<double>(i + 40000)));
+    }
+    left.merge(right);
+    left.merge(small);
+    // The standard error is about 1.6%, this is more than four times that.
+    ASSERT_LT(fabs(static_cast<double>(left.estimate()) - 100100) / 100100, 0.07);
+}
+
+TEST(SketchesTest, TDigest) {
+    ql::tdigest_t first, second;
+    for (int i = 0; i < 50000; ++i) {
+        first.add(2 * i);
+        second.add(2 * i + 1);
+    }
+    first.merge(second);
+    ASSERT_EQ(0.0, first.quantile(0));
+    ASSERT_EQ(99999.0, first.quantile(1));
+    ASSERT_LT(fabs(first.quantile(0.5) - 50000), 500);
+    ASSERT_LT(fabs(first.quantile(0.99) - 99000), 100);
+    ASSERT_LT(fabs(first.quantile(0.001) - 100), 20);
+}
+
+}  // namespace unittest